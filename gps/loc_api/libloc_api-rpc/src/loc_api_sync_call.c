@@ -30,6 +30,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <time.h>
 #include <string.h>
 #include <pthread.h>
 
@@ -49,6 +50,77 @@ loc_sync_call_data_array_s_type loc_sync_data;
 
 /*===========================================================================
 
+FUNCTION    loc_expire_time_msec
+
+DESCRIPTION
+   Computes the monotonic time timeout_msec from now, for timed waits on
+   condition variables set up by loc_cond_init_monotonic
+
+RETURN VALUE
+   none
+
+===========================================================================*/
+static void loc_expire_time_msec(struct timespec *expire_time, uint32 timeout_msec)
+{
+   clock_gettime(CLOCK_MONOTONIC, expire_time);
+   expire_time->tv_sec += timeout_msec / 1000;
+   expire_time->tv_nsec += (timeout_msec % 1000) * 1000000;
+   if (expire_time->tv_nsec >= 1000000000)
+   {
+      expire_time->tv_sec++;
+      expire_time->tv_nsec -= 1000000000;
+   }
+}
+
+/*===========================================================================
+
+FUNCTION    loc_cond_timedwait_monotonic
+
+DESCRIPTION
+   Waits on a condition variable set up by loc_cond_init_monotonic until
+   the monotonic time expire_time
+
+RETURN VALUE
+   0, or ETIMEDOUT once expire_time has passed
+
+===========================================================================*/
+static int loc_cond_timedwait_monotonic(pthread_cond_t *cond, pthread_mutex_t *mutex,
+      const struct timespec *expire_time)
+{
+#ifdef HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC
+   return pthread_cond_timedwait_monotonic_np(cond, mutex, expire_time);
+#else
+   return pthread_cond_timedwait(cond, mutex, expire_time);
+#endif
+}
+
+/*===========================================================================
+
+FUNCTION    loc_cond_init_monotonic
+
+DESCRIPTION
+   Initializes a condition variable for timed waits on the monotonic clock,
+   so wall-clock changes do not shorten or stretch the wait
+
+RETURN VALUE
+   none
+
+===========================================================================*/
+static void loc_cond_init_monotonic(pthread_cond_t *cond)
+{
+#ifdef HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC
+   pthread_cond_init(cond, NULL);
+#else
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(cond, &attr);
+   pthread_condattr_destroy(&attr);
+#endif
+}
+
+/*===========================================================================
+
 FUNCTION    loc_api_sync_call_init
 
 DESCRIPTION
@@ -69,7 +141,7 @@ void loc_api_sync_call_init()
    pthread_mutex_init(&loc_sync_data.lock, NULL);
    pthread_mutex_lock(&loc_sync_data.lock);
 
-   pthread_cond_init(&loc_sync_data.loc_cb_arrived_cond, NULL);
+   loc_cond_init_monotonic(&loc_sync_data.loc_cb_arrived_cond);
 
    loc_sync_data.size = LOC_SYNC_CALL_BUFFER_SIZE;
    loc_sync_data.in_use = FALSE;
@@ -82,7 +154,7 @@ void loc_api_sync_call_init()
       loc_sync_call_data_s_type *slot = &loc_sync_data.slots[i];
 
       pthread_mutex_init(&slot->lock, NULL);
-      pthread_cond_init(&slot->loc_cb_arrived_cond, NULL);
+      loc_cond_init_monotonic(&slot->loc_cb_arrived_cond);
 
       slot->loc_handle = -1;
       slot->loc_cb_is_selected = FALSE;       /* is cb selected? */
@@ -361,10 +433,10 @@ static void loc_save_user_payload(
 
 /*===========================================================================
 
-FUNCTION    loc_api_wait_callback
+FUNCTION    loc_api_wait_callback_until
 
 DESCRIPTION
-   Waits for a selected callback. The wait expires in timeout_seconds seconds.
+   Waits for a selected callback until the monotonic time expire_time.
 
    If the function is called before an existing wait has finished, it will
    immediately return EBUSY.
@@ -382,9 +454,9 @@ SIDE EFFECTS
    N/A
 
 ===========================================================================*/
-int loc_api_wait_callback(
+static int loc_api_wait_callback_until(
       int select_id,        /* ID from loc_select_callback() */
-      int timeout_seconds,  /* Timeout in this number of seconds  */
+      const struct timespec *expire_time, /* Monotonic time the wait expires */
       rpc_loc_event_payload_u_type     *callback_payload,    /* Pointer to callback payload buffer, can be NULL */
       rpc_loc_ioctl_callback_s_type    *ioctl_payload        /* Pointer to IOCTL payload, can be NULL */
 )
@@ -400,9 +472,6 @@ int loc_api_wait_callback(
    int ret_val = RPC_LOC_API_SUCCESS;  /* the return value of this function: 0 = no error */
    int rc;                             /* return code from pthread calls */
 
-   struct timeval present_time;
-   struct timespec expire_time;
-
    pthread_mutex_lock(&slot->lock);
 
    if (slot->loc_cb_has_arrived)
@@ -423,18 +492,11 @@ int loc_api_wait_callback(
       return ret_val;  /* exit */
    }
 
-   /* Calculate absolute expire time */
-   gettimeofday(&present_time, NULL);
-   expire_time.tv_sec  = present_time.tv_sec;
-   expire_time.tv_nsec = present_time.tv_usec * 1000;
-   expire_time.tv_sec += timeout_seconds;
-
    /* Take new wait request */
    slot->loc_cb_is_waiting = TRUE;
 
    /* Waiting */
-   rc = pthread_cond_timedwait(&slot->loc_cb_arrived_cond,
-         &slot->lock, &expire_time);
+   rc = loc_cond_timedwait_monotonic(&slot->loc_cb_arrived_cond, &slot->lock, expire_time);
 
    if (rc == ETIMEDOUT)
    {
@@ -457,10 +519,44 @@ int loc_api_wait_callback(
 
 /*===========================================================================
 
+FUNCTION    loc_api_wait_callback
+
+DESCRIPTION
+   Waits for a selected callback. The wait expires in timeout_seconds seconds.
+
+   If the function is called before an existing wait has finished, it will
+   immediately return EBUSY.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   See loc_api_wait_callback_until
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_api_wait_callback(
+      int select_id,        /* ID from loc_select_callback() */
+      int timeout_seconds,  /* Timeout in this number of seconds  */
+      rpc_loc_event_payload_u_type     *callback_payload,    /* Pointer to callback payload buffer, can be NULL */
+      rpc_loc_ioctl_callback_s_type    *ioctl_payload        /* Pointer to IOCTL payload, can be NULL */
+)
+{
+   struct timespec expire_time;
+
+   loc_expire_time_msec(&expire_time, (uint32) timeout_seconds * 1000);
+   return loc_api_wait_callback_until(select_id, &expire_time, callback_payload, ioctl_payload);
+}
+
+/*===========================================================================
+
 FUNCTION    loc_api_sync_ioctl
 
 DESCRIPTION
-   Synchronous IOCTL call (reentrant version)
+   Synchronous IOCTL call (reentrant version). Waiting for a busy engine
+   and for the callback together take at most timeout_msec.
 
 DEPENDENCIES
    N/A
@@ -484,6 +580,9 @@ int loc_api_sync_ioctl
    int                              rc = RPC_LOC_API_ENGINE_BUSY;
    int                              select_id;
    rpc_loc_ioctl_callback_s_type    callback_data;
+   struct timespec                  expire_time;
+
+   loc_expire_time_msec(&expire_time, timeout_msec);
 
    // Select the callback we are waiting for
    select_id = loc_api_select_callback(handle, 0, ioctl_type);
@@ -494,9 +593,12 @@ int loc_api_sync_ioctl
       rc = loc_ioctl(handle, ioctl_type, ioctl_data_ptr);
       while (rc == RPC_LOC_API_ENGINE_BUSY)
       {
-         /* TODO: Use timeout? */
          ALOGD("loc_api_sync_ioctl: select_id = %d, engine busy, waiting...\n", select_id);
-         pthread_cond_wait(&loc_sync_data.loc_cb_arrived_cond, &loc_sync_data.lock);
+         if (loc_cond_timedwait_monotonic(&loc_sync_data.loc_cb_arrived_cond,
+                  &loc_sync_data.lock, &expire_time) == ETIMEDOUT)
+         {
+            break;
+         }
          rc = loc_ioctl(handle, ioctl_type, ioctl_data_ptr);
       }
       pthread_mutex_unlock(&loc_sync_data.lock);
@@ -509,7 +611,7 @@ int loc_api_sync_ioctl
       }
       else {
          // Wait for the callback of loc_ioctl
-         if ((rc = loc_api_wait_callback(select_id, timeout_msec / 1000, NULL, &callback_data)) != 0)
+         if ((rc = loc_api_wait_callback_until(select_id, &expire_time, NULL, &callback_data)) != 0)
          {
             // Callback waiting failed
             ALOGE("loc_api_sync_ioctl: loc_api_wait_callback failed, returned %d (select id %d)\n", rc, select_id);
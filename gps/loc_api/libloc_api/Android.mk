@@ -31,6 +31,17 @@ LOCAL_SRC_FILES += \
     loc_eng_ni.cpp \
     loc_eng_log.cpp \
     loc_eng_cfg.cpp \
+    loc_eng_timer.cpp \
+    loc_eng_trace.cpp \
+    loc_eng_batch.cpp \
+    loc_eng_resolver.cpp \
+    loc_eng_kalman.cpp \
+    loc_eng_interp.cpp \
+    loc_eng_sv.cpp \
+    loc_eng_nmea.cpp \
+    loc_eng_geofence.cpp \
+    loc_eng_sched.cpp \
+    loc_eng_cmd.cpp \
     gps.c
 
 LOCAL_CFLAGS += \
@@ -47,3 +58,73 @@ LOCAL_C_INCLUDES:= \
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Host decoder for the loc_eng binary trace ring
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := loc_trace_decode
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+    loc_trace_decode.c
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Host benchmark of the geofence extension
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := loc_geofence_bench
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+    loc_geofence_bench.cpp \
+    loc_eng_geofence.cpp
+
+LOCAL_CFLAGS += \
+    -fno-short-enums \
+    -DAMSS_VERSION=$(BOARD_VENDOR_QCOM_GPS_LOC_API_AMSS_VERSION) \
+    -include $(LOCAL_PATH)/../libloc_api-rpc/inc-$(BOARD_VENDOR_QCOM_GPS_LOC_API_AMSS_VERSION)/loc_api_common.h
+
+LOCAL_C_INCLUDES:= \
+    $(LOCAL_PATH) \
+    $(LOCAL_PATH)/../libloc_api-rpc/inc \
+    $(LOCAL_PATH)/../libloc_api-rpc/inc-$(BOARD_VENDOR_QCOM_GPS_LOC_API_AMSS_VERSION) \
+    $(LOCAL_PATH)/../../librpc
+
+LOCAL_STATIC_LIBRARIES := \
+    liblog
+
+LOCAL_LDLIBS += -lpthread -lm
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Host replay of recorded tracks through the Kalman smoothing stage
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := loc_kf_replay
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+    loc_kf_replay.cpp \
+    loc_eng_kalman.cpp
+
+LOCAL_CFLAGS += \
+    -fno-short-enums \
+    -DAMSS_VERSION=$(BOARD_VENDOR_QCOM_GPS_LOC_API_AMSS_VERSION) \
+    -include $(LOCAL_PATH)/../libloc_api-rpc/inc-$(BOARD_VENDOR_QCOM_GPS_LOC_API_AMSS_VERSION)/loc_api_common.h
+
+LOCAL_C_INCLUDES:= \
+    $(LOCAL_PATH) \
+    $(LOCAL_PATH)/../libloc_api-rpc/inc \
+    $(LOCAL_PATH)/../libloc_api-rpc/inc-$(BOARD_VENDOR_QCOM_GPS_LOC_API_AMSS_VERSION) \
+    $(LOCAL_PATH)/../../librpc
+
+LOCAL_STATIC_LIBRARIES := \
+    liblog
+
+LOCAL_LDLIBS += -lm
+
+include $(BUILD_HOST_EXECUTABLE)
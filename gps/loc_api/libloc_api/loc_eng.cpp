@@ -31,6 +31,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <math.h>
@@ -57,6 +58,11 @@
 
 #define DEBUG_NI_REQUEST_EMU 0
 
+// Satellite reports: SNR bucket (dB) whose change is always reported, and
+// the longest time an unchanged satellite list is held back
+#define LOC_ENG_SV_SNR_BUCKET     10
+#define LOC_ENG_SV_REFRESH_MSEC   10000
+
 #define LOC_DATA_DEFAULT FALSE          // Default data connection status (1=ON, 0=OFF)
 #define SUCCESS TRUE
 #define FAILURE FALSE
@@ -68,6 +74,7 @@ static int  loc_eng_stop();
 static int  loc_eng_set_position_mode(GpsPositionMode mode, GpsPositionRecurrence recurrence,
             uint32_t min_interval, uint32_t preferred_accuracy, uint32_t preferred_time);
 static void loc_eng_cleanup();
+static boolean loc_eng_apply_fix_criteria();
 static int  loc_eng_inject_time(GpsUtcTime time, int64_t timeReference, int uncertainty);
 static int loc_eng_inject_location(double latitude, double longitude, float accuracy);
 static void loc_eng_delete_aiding_data(GpsAidingData f);
@@ -80,6 +87,8 @@ static int loc_eng_data_conn_closed();
 static int loc_eng_data_conn_failed();
 static int loc_eng_set_server(AGpsType type, const char *hostname, int port);
 static int loc_eng_set_server_proxy(AGpsType type, const char *hostname, int port);
+static int loc_eng_set_c2k_server(struct in_addr addr, int port);
+static void loc_eng_set_server_resolved(const char *hostname, struct in_addr addr, void *user_data);
 
 // Internal functions
 static int loc_eng_deinit();
@@ -88,6 +97,8 @@ static int32 loc_event_cb(rpc_loc_client_handle_type client_handle,
                           rpc_loc_event_mask_type loc_event,
                           const rpc_loc_event_payload_u_type* loc_event_payload);
 static void loc_eng_report_position(const rpc_loc_parsed_position_s_type *location_report_ptr);
+static void loc_eng_report_batched_position(const rpc_loc_parsed_position_s_type *location_report_ptr);
+static boolean loc_eng_sv_changed(const GpsSvInfo *sv, const GpsSvInfo *last);
 static void loc_eng_report_sv(const rpc_loc_gnss_info_s_type *gnss_report_ptr);
 static void loc_inform_gps_status(GpsStatusValue status);
 static void loc_eng_report_status(const rpc_loc_status_event_s_type *status_report_ptr);
@@ -95,9 +106,12 @@ static void loc_eng_report_nmea(const rpc_loc_nmea_report_s_type *nmea_report_pt
 static void loc_eng_process_conn_request(const rpc_loc_server_request_s_type *server_request_ptr);
 
 static void loc_eng_deferred_action_thread(void* arg);
+static void loc_eng_deferred_stop_timeout(void* arg);
 static void loc_eng_process_atl_action(AGpsStatusValue status);
 
 static void loc_eng_delete_aiding_data_action(void);
+static void loc_eng_delete_aiding_data_done(rpc_loc_ioctl_e_type ioctl_type, int status,
+            const rpc_loc_ioctl_callback_s_type *cb_data_ptr, void *user_data);
 static void loc_eng_ioctl_data_close_status(int is_succ);
 
 // Defines the GpsInterface in gps.h
@@ -229,6 +243,7 @@ static int loc_eng_init(GpsCallbacks* callbacks)
 
    // Process gps.conf
    loc_read_gps_conf();
+   loc_eng_trace_init(gps_conf.TRACE_FILE);
 
    // Save callbacks
    memset(&loc_eng_data, 0, sizeof (loc_eng_data_s_type));
@@ -243,8 +258,7 @@ static int loc_eng_init(GpsCallbacks* callbacks)
    loc_eng_data.engine_status = GPS_STATUS_NONE;
    loc_eng_data.fix_session_status = GPS_STATUS_NONE;
 
-   loc_eng_data.loc_event = 0;
-   loc_eng_data.deferred_action_flags = 0;
+   loc_eng_cmd_init();
    // Mute session
    loc_eng_data.mute_session_state = LOC_MUTE_SESS_NONE;
 
@@ -255,8 +269,14 @@ static int loc_eng_init(GpsCallbacks* callbacks)
 
    pthread_mutex_init(&loc_eng_data.mute_session_lock, NULL);
    pthread_mutex_init(&loc_eng_data.deferred_action_mutex, NULL);
-   pthread_cond_init(&loc_eng_data.deferred_action_cond, NULL);
+   // timed waits of the deferred action thread use the monotonic clock
+   loc_eng_cond_init_monotonic(&loc_eng_data.deferred_action_cond);
    pthread_mutex_init (&(loc_eng_data.deferred_stop_mutex), NULL);
+   loc_eng_timer_init();
+   loc_eng_ioctl_async_init();
+   loc_eng_batch_init();
+   loc_eng_interp_init();
+   loc_eng_nmea_init();
 
    // Open client
    rpc_loc_event_mask_type event = RPC_LOC_EVENT_PARSED_POSITION_REPORT |
@@ -275,6 +295,7 @@ static int loc_eng_init(GpsCallbacks* callbacks)
    {
       loc_eng_data.deferred_action_thread = NULL;
       loc_eng_data.deferred_action_thread = callbacks->create_thread_cb("loc_api",loc_eng_deferred_action_thread, NULL);
+      loc_eng_sched_init(callbacks->create_thread_cb);
 #ifdef FEATURE_GNSS_BIT_API
       gpsone_loc_api_server_launch(NULL, NULL);
 #endif /* FEATURE_GNSS_BIT_API */
@@ -358,12 +379,7 @@ static void loc_eng_cleanup()
    if (loc_eng_data.deferred_action_thread)
    {
       /* Terminate deferred action working thread */
-      pthread_mutex_lock (&loc_eng_data.deferred_action_mutex);
-      /* hold a wake lock while events are pending for deferred_action_thread */
-      loc_eng_data.acquire_wakelock_cb();
-      loc_eng_data.deferred_action_flags |= DEFERRED_ACTION_QUIT;
-      pthread_cond_signal  (&loc_eng_data.deferred_action_cond);
-      pthread_mutex_unlock (&loc_eng_data.deferred_action_mutex);
+      loc_eng_cmd_post_quit();
 
       void* ignoredValue;
       pthread_join(loc_eng_data.deferred_action_thread, &ignoredValue);
@@ -401,6 +417,13 @@ static int loc_eng_start()
    int ret_val;
    LOC_LOGD("loc_eng_start called");
 
+   loc_eng_apply_fix_criteria();
+   // A new session starts a new track, reset where the filter is used
+   // and reports the full satellite list first
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   loc_eng_data.position_filter_reset = TRUE;
+   loc_eng_data.sv_status_reset = TRUE;
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
    ret_val = loc_start_fix(loc_eng_data.client_handle);
 
    if (ret_val != RPC_LOC_API_SUCCESS)
@@ -409,11 +432,40 @@ static int loc_eng_start()
    }
    else {
       loc_eng_data.navigating = TRUE;
+      loc_eng_sched_start(&loc_eng_data.fix_criteria);
    }
 
    return 0;
 }
 
+/*===========================================================================
+FUNCTION    loc_eng_stop_session_data
+
+DESCRIPTION
+   Ends what the session has left in the HAL: the deferred action thread
+   stops interpolating and flushes the tail of a batch rather than keeping
+   it until the next session.
+
+DEPENDENCIES
+   Called from loc_eng_stop, however the fix session is stopped
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_stop_session_data()
+{
+   loc_eng_cmd_post(LOC_ENG_CMD_INTERP_STOP);
+
+   if (loc_eng_batch_enabled())
+   {
+      loc_eng_batch_request_flush();
+   }
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_stop
 
@@ -436,14 +488,33 @@ static int loc_eng_stop()
 
    int ret_val;
    LOC_LOGD("loc_eng_stop called");
+
+   // Between duty cycled fixes there is no fix session on the modem, and the
+   // framework has not been told that the engine is off
+   if (loc_eng_sched_stop())
+   {
+      loc_eng_data.navigating = FALSE;
+      loc_inform_gps_status(GPS_STATUS_SESSION_END);
+      loc_inform_gps_status(GPS_STATUS_ENGINE_OFF);
+      loc_eng_stop_session_data();
+      return 0;
+   }
+
    pthread_mutex_lock(&(loc_eng_data.deferred_stop_mutex));
     // work around problem with loc_eng_stop when AGPS requests are pending
     // we defer stopping the engine until the AGPS request is done
     if (loc_eng_data.agps_request_pending)
     {
         loc_eng_data.stop_request_pending = true;
+        // do not wait forever if the framework never reports the data call result
+        if (loc_eng_data.deferred_stop_timer == LOC_ENG_TIMER_INVALID)
+        {
+            loc_eng_data.deferred_stop_timer = loc_eng_timer_start(DEFERRED_STOP_TIMEOUT * 1000,
+                                                                   loc_eng_deferred_stop_timeout, NULL);
+        }
         LOC_LOGD("loc_eng_stop - deferring stop until AGPS data call is finished\n");
         pthread_mutex_unlock(&(loc_eng_data.deferred_stop_mutex));
+        loc_eng_stop_session_data();
         return 0;
     }
    pthread_mutex_unlock(&(loc_eng_data.deferred_stop_mutex));
@@ -467,6 +538,8 @@ static int loc_eng_stop()
       loc_eng_data.navigating = FALSE;
    }
 
+   loc_eng_stop_session_data();
+
    return 0;
 }
 
@@ -518,15 +591,14 @@ static int  loc_eng_set_position_mode(GpsPositionMode mode, GpsPositionRecurrenc
 {
    INIT_CHECK("loc_eng_set_position_mode");
 
-   rpc_loc_ioctl_data_u_type    ioctl_data;
-   rpc_loc_fix_criteria_s_type *fix_criteria_ptr;
-   rpc_loc_ioctl_e_type         ioctl_type = RPC_LOC_IOCTL_SET_FIX_CRITERIA;
-   boolean                      ret_val;
+   rpc_loc_fix_criteria_s_type  fix_criteria;
+   rpc_loc_fix_criteria_s_type *fix_criteria_ptr = &fix_criteria;
 
    LOC_LOGD ("loc_eng_set_position mode, client = %d, interval = %d, mode = %d\n",
             (int32) loc_eng_data.client_handle, min_interval, mode);
 
-   fix_criteria_ptr = &ioctl_data.rpc_loc_ioctl_data_u_type_u.fix_criteria;
+   // Cleared so that identical criteria compare equal, see loc_eng_apply_fix_criteria
+   memset(&fix_criteria, 0, sizeof fix_criteria);
 
    fix_criteria_ptr->valid_mask = RPC_LOC_FIX_CRIT_VALID_PREFERRED_OPERATION_MODE |
                                   RPC_LOC_FIX_CRIT_VALID_RECURRENCE_TYPE;
@@ -588,7 +660,61 @@ static int  loc_eng_set_position_mode(GpsPositionMode mode, GpsPositionRecurrenc
             fix_criteria_ptr->recurrence_type = RPC_LOC_PERIODIC_FIX;
             break;
     }
+
+   // The framework sets the mode before every start; only the last criteria
+   // set before loc_eng_start are sent, and only if the modem has not got them
+   memcpy(&loc_eng_data.fix_criteria, &fix_criteria, sizeof fix_criteria);
+   loc_eng_data.fix_criteria_set = TRUE;
+
+   // A running session picks up the new criteria right away
+   if (loc_eng_data.navigating)
+   {
+      loc_eng_apply_fix_criteria();
+   }
+
+   return 0;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_apply_fix_criteria
+
+DESCRIPTION
+   Sends the fix criteria last set by loc_eng_set_position_mode to the modem,
+   unless they are the same as the criteria it last acknowledged.
+
+DEPENDENCIES
+   Called from the framework thread, like loc_eng_set_position_mode and
+   loc_eng_start
+
+RETURN VALUE
+   TRUE if the modem has the requested criteria
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static boolean loc_eng_apply_fix_criteria()
+{
+   rpc_loc_ioctl_data_u_type    ioctl_data;
+   rpc_loc_ioctl_e_type         ioctl_type = RPC_LOC_IOCTL_SET_FIX_CRITERIA;
+   boolean                      ret_val;
+
+   if (!loc_eng_data.fix_criteria_set)
+   {
+      return TRUE; /* nothing requested, the modem keeps its defaults */
+   }
+
+   if (loc_eng_data.fix_criteria_applied_valid &&
+       memcmp(&loc_eng_data.fix_criteria_applied, &loc_eng_data.fix_criteria,
+              sizeof loc_eng_data.fix_criteria) == 0)
+   {
+      LOC_LOGV("loc_eng_apply_fix_criteria: unchanged, not sent\n");
+      return TRUE;
+   }
+
    ioctl_data.disc = ioctl_type;
+   memcpy(&ioctl_data.rpc_loc_ioctl_data_u_type_u.fix_criteria, &loc_eng_data.fix_criteria,
+          sizeof loc_eng_data.fix_criteria);
    ret_val = loc_eng_ioctl (loc_eng_data.client_handle,
                             ioctl_type,
                             &ioctl_data,
@@ -598,9 +724,15 @@ static int  loc_eng_set_position_mode(GpsPositionMode mode, GpsPositionRecurrenc
    if (ret_val != TRUE)
    {
       LOC_LOGE("loc_eng_set_position mode failed\n");
+      // The modem state is unknown, send the criteria again next time
+      loc_eng_data.fix_criteria_applied_valid = FALSE;
+      return FALSE;
    }
 
-   return 0;
+   memcpy(&loc_eng_data.fix_criteria_applied, &loc_eng_data.fix_criteria,
+          sizeof loc_eng_data.fix_criteria);
+   loc_eng_data.fix_criteria_applied_valid = TRUE;
+   return TRUE;
 }
 
 /*===========================================================================
@@ -736,24 +868,10 @@ static void loc_eng_delete_aiding_data(GpsAidingData f)
 {
    INIT_CHECK_VOID("loc_eng_delete_aiding_data");
 
-   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
-
     // Currently, LOC API only support deletion of all aiding data,
+    // in case gps engine is ON, the assistance data will be deleted when the engine is OFF
     if (f)
-        loc_eng_data.aiding_data_for_deletion = GPS_DELETE_ALL;
-
-   if (loc_eng_data.engine_status != GPS_STATUS_ENGINE_ON &&
-       loc_eng_data.aiding_data_for_deletion != 0)
-   {
-      /* hold a wake lock while events are pending for deferred_action_thread */
-      loc_eng_data.acquire_wakelock_cb();
-      loc_eng_data.deferred_action_flags |= DEFERRED_ACTION_DELETE_AIDING;
-      pthread_cond_signal(&loc_eng_data.deferred_action_cond);
-
-      // In case gps engine is ON, the assistance data will be deleted when the engine is OFF
-   }
-
-   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+        loc_eng_cmd_post_delete_aiding(GPS_DELETE_ALL);
 }
 
 /*===========================================================================
@@ -793,6 +911,31 @@ static const void* loc_eng_get_extension(const char* name)
       return &sLocEngNiInterface;
    }
 
+   else if (strcmp(name, LOC_BATCH_INTERFACE) == 0)
+   {
+      return &sLocEngBatchInterface;
+   }
+
+   else if (strcmp(name, LOC_SV_INTERFACE) == 0)
+   {
+      return &sLocEngSvInterface;
+   }
+
+   else if (strcmp(name, LOC_NMEA_INTERFACE) == 0)
+   {
+      return &sLocEngNmeaInterface;
+   }
+
+   else if (strcmp(name, LOC_GEOFENCE_INTERFACE) == 0)
+   {
+      return &sLocEngGeofenceInterface;
+   }
+
+   else if (strcmp(name, LOC_INTERP_INTERFACE) == 0)
+   {
+      return &sLocEngInterpInterface;
+   }
+
    return NULL;
 }
 
@@ -819,6 +962,7 @@ static void loc_inform_gps_status(GpsStatusValue status)
    GpsStatus gs = { sizeof(gs),status };
 
    LOC_LOGD("loc_inform_gps_status, status: %s", loc_get_gps_status_name(status));
+   loc_eng_trace_status(status);
 
    if (loc_eng_data.status_cb)
    {
@@ -934,10 +1078,19 @@ static int32 loc_event_cb
 )
 {
    if(loc_event == RPC_LOC_EVENT_IOCTL_REPORT)
+   {
+      // Hand over reports of asynchronous IOCTLs, synchronous ones are
+      // picked up by loc_api_callback_process_sync_call
+      loc_eng_ioctl_async_report(client_handle,
+            &loc_event_payload->rpc_loc_event_payload_u_type_u.ioctl_report);
       return RPC_LOC_API_SUCCESS;
+   }
 
    INIT_CHECK("loc_event_cb");
-   loc_eng_callback_log_header(client_handle, loc_event, loc_event_payload);
+   if (LOC_LOG_ENABLED(LOC_LOG_LEVEL_D))
+   {
+      loc_eng_callback_log_header(client_handle, loc_event, loc_event_payload);
+   }
 
    if (client_handle != loc_eng_data.client_handle)
    {
@@ -947,38 +1100,58 @@ static int32 loc_event_cb
    }
 
    loc_eng_callback_log(loc_event, loc_event_payload);
-   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
-   loc_eng_data.loc_event = loc_event;
-   memcpy(&loc_eng_data.loc_event_payload, loc_event_payload, sizeof(*loc_event_payload));
-   /* hold a wake lock while events are pending for deferred_action_thread */
-   loc_eng_data.acquire_wakelock_cb();
-   loc_eng_data.deferred_action_flags |= DEFERRED_ACTION_EVENT;
-   pthread_cond_signal  (&loc_eng_data.deferred_action_cond);
-   pthread_mutex_unlock (&loc_eng_data.deferred_action_mutex);
+
+   // While fixes are batched only the flush wakes up the deferred action
+   // thread: position reports go straight into the batch, satellite and
+   // NMEA reports wait until the thread runs. Duty cycled sessions still
+   // need each fix there to turn the engine off.
+   if (loc_eng_batch_enabled() && !loc_eng_sched_duty_cycled())
+   {
+      if (loc_event == RPC_LOC_EVENT_PARSED_POSITION_REPORT)
+      {
+         if (loc_eng_batch_add(&loc_event_payload->rpc_loc_event_payload_u_type_u.
+               parsed_location_report))
+         {
+            loc_eng_batch_request_flush();
+         }
+         return RPC_LOC_API_SUCCESS;
+      }
+      if (loc_event == RPC_LOC_EVENT_SATELLITE_REPORT ||
+          loc_event == RPC_LOC_EVENT_NMEA_1HZ_REPORT)
+      {
+         loc_eng_cmd_queue_event(loc_event, loc_event_payload);
+         return RPC_LOC_API_SUCCESS;
+      }
+   }
+
+   loc_eng_cmd_post_event(loc_event, loc_event_payload);
 
    return RPC_LOC_API_SUCCESS;//We simply want to return sucess here as we do not want to
                               // cause any issues in RPC thread context
 }
 
 /*===========================================================================
-FUNCTION    loc_eng_report_position
+FUNCTION    loc_eng_convert_position
 
 DESCRIPTION
-   Reports position information to the Java layer.
+   Converts a parsed position report into a GpsLocation and applies the
+   position filters.
 
 DEPENDENCIES
    N/A
 
 RETURN VALUE
-   N/A
+   TRUE if the location should be reported, FALSE if it is filtered out
 
 SIDE EFFECTS
    N/A
 
 ===========================================================================*/
-static void loc_eng_report_position(const rpc_loc_parsed_position_s_type *location_report_ptr)
+static boolean loc_eng_convert_position(const rpc_loc_parsed_position_s_type *location_report_ptr,
+            GpsLocation *location_ptr)
 {
    GpsLocation location;
+   boolean filter_out = TRUE;
 
    memset(&location, 0, sizeof (GpsLocation));
    location.size = sizeof(location);
@@ -1040,7 +1213,7 @@ static void loc_eng_report_position(const rpc_loc_parsed_position_s_type *locati
          }
 
          // Filtering
-         boolean filter_out = FALSE;
+         filter_out = FALSE;
 
          // Filter any 0,0 positions
          if (location.latitude == 0.0 && location.longitude == 0.0)
@@ -1059,10 +1232,23 @@ static void loc_eng_report_position(const rpc_loc_parsed_position_s_type *locati
             filter_out = TRUE;
          }
 
-         if (loc_eng_data.location_cb != NULL && !filter_out)
+         // Smoothing, also drops jumps that do not fit the reported accuracy
+         if (gps_conf.SMOOTHING && !filter_out)
          {
-            LOC_LOGV("loc_eng_report_position: fire callback\n");
-            loc_eng_data.location_cb(&location);
+            boolean reset;
+
+            pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+            reset = loc_eng_data.position_filter_reset;
+            loc_eng_data.position_filter_reset = FALSE;
+            pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+            if (reset)
+            {
+               loc_eng_kf_reset(&loc_eng_data.position_filter);
+            }
+            if (!loc_eng_kf_update(&loc_eng_data.position_filter, &location))
+            {
+               filter_out = TRUE;
+            }
          }
       }
       else
@@ -1074,13 +1260,135 @@ static void loc_eng_report_position(const rpc_loc_parsed_position_s_type *locati
    {
       LOC_LOGV("loc_eng_report_position: ignore position report when session status is not set\n");
    }
+
+   memcpy(location_ptr, &location, sizeof location);
+   return !filter_out;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_report_position
+
+DESCRIPTION
+   Reports position information to the Java layer.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_report_position(const rpc_loc_parsed_position_s_type *location_report_ptr)
+{
+   GpsLocation location;
+
+   // Duty cycled sessions batch here, the scheduler sees each final fix as
+   // it comes and the rest when the batch is flushed
+   if (loc_eng_batch_enabled())
+   {
+      if (loc_eng_batch_add(location_report_ptr))
+      {
+         loc_eng_batch_request_flush();
+      }
+      if ((location_report_ptr->valid_mask & RPC_LOC_POS_VALID_SESSION_STATUS) &&
+          location_report_ptr->session_status == RPC_LOC_SESS_STATUS_SUCCESS)
+      {
+         loc_eng_sched_fix();
+      }
+      return;
+   }
+
+   if (loc_eng_convert_position(location_report_ptr, &location) &&
+       loc_eng_data.location_cb != NULL)
+   {
+      LOC_LOGV("loc_eng_report_position: fire callback\n");
+      loc_eng_data.location_cb(&location);
+      loc_eng_interp_fix(&location, location_report_ptr);
+      loc_eng_geofence_evaluate(&location);
+      loc_eng_sched_fix();
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_report_batched_position
+
+DESCRIPTION
+   Reports a position from a flushed batch to the Java layer, and evaluates
+   the geofences against it. Interpolation is off while batching.
+
+DEPENDENCIES
+   Called from loc_eng_batch_flush on the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_report_batched_position(const rpc_loc_parsed_position_s_type *location_report_ptr)
+{
+   GpsLocation location;
+
+   if (loc_eng_data.mute_session_state != LOC_MUTE_SESS_IN_SESSION &&
+       loc_eng_convert_position(location_report_ptr, &location) &&
+       loc_eng_data.location_cb != NULL)
+   {
+      loc_eng_data.location_cb(&location);
+      loc_eng_geofence_evaluate(&location);
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sv_changed
+
+DESCRIPTION
+   Compares a satellite with the one last reported in the same slot. A
+   different PRN or SNR bucket always counts as a change; SNR, elevation
+   and azimuth drift only when they reach the SV_*_THRES values in gps.conf.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   TRUE if the satellite is worth reporting
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static boolean loc_eng_sv_changed(const GpsSvInfo *sv, const GpsSvInfo *last)
+{
+   float azimuth_diff;
+
+   if (sv->prn != last->prn ||
+       (int) (sv->snr / LOC_ENG_SV_SNR_BUCKET) != (int) (last->snr / LOC_ENG_SV_SNR_BUCKET))
+   {
+      return TRUE;
+   }
+
+   azimuth_diff = fabsf(sv->azimuth - last->azimuth);
+   if (azimuth_diff > 180)
+   {
+      azimuth_diff = 360 - azimuth_diff;
+   }
+
+   return fabsf(sv->snr - last->snr) >= gps_conf.SV_SNR_THRES ||
+          fabsf(sv->elevation - last->elevation) >= gps_conf.SV_ELEV_THRES ||
+          azimuth_diff >= gps_conf.SV_AZIM_THRES;
 }
 
 /*===========================================================================
 FUNCTION    loc_eng_report_sv
 
 DESCRIPTION
-   Reports GPS satellite information to the Java layer.
+   Reports GPS satellite information to the Java layer. The report is
+   diffed against the last one delivered as it is built, and is dropped
+   when no satellite changed enough (see loc_eng_sv_changed) and the
+   masks are the same, unless LOC_ENG_SV_REFRESH_MSEC have passed.
 
 DEPENDENCIES
    N/A
@@ -1095,6 +1403,10 @@ SIDE EFFECTS
 static void loc_eng_report_sv (const rpc_loc_gnss_info_s_type *gnss_report_ptr)
 {
    GpsSvStatus     SvStatus;
+   GpsSvStatus    *last_ptr = &loc_eng_data.sv_status;
+   GpsSvInfo      *sv_ptr;
+   boolean         changed;
+   long long       now_msec;
    int             num_svs_max, i;
     const rpc_loc_sv_info_s_type *sv_info_ptr;
 
@@ -1102,8 +1414,16 @@ static void loc_eng_report_sv (const rpc_loc_gnss_info_s_type *gnss_report_ptr)
    //        (uint32) gnss_report_ptr->valid_mask,
    //        gnss_report_ptr->sv_count);
 
+   // All constellations, for the satellite extension
+   loc_eng_sv_update(gnss_report_ptr);
+
+   // Only the header and the entries in use are filled in, no memset
    num_svs_max = 0;
-   memset (&SvStatus, 0, sizeof (GpsSvStatus));
+   SvStatus.size = sizeof(GpsSvStatus);
+   SvStatus.num_svs = 0;
+   SvStatus.ephemeris_mask = 0;
+   SvStatus.almanac_mask = 0;
+   SvStatus.used_in_fix_mask = 0;
    if (gnss_report_ptr->valid_mask & RPC_LOC_GNSS_INFO_VALID_SV_COUNT)
    {
       num_svs_max = gnss_report_ptr->sv_count;
@@ -1113,19 +1433,29 @@ static void loc_eng_report_sv (const rpc_loc_gnss_info_s_type *gnss_report_ptr)
       }
    }
 
-   if (gnss_report_ptr->valid_mask & RPC_LOC_GNSS_INFO_VALID_SV_LIST)
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   if (loc_eng_data.sv_status_reset)
    {
-      SvStatus.num_svs = 0;
+      loc_eng_data.sv_status_valid = FALSE;
+      loc_eng_data.sv_status_reset = FALSE;
+   }
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+   changed = !loc_eng_data.sv_status_valid;
 
+   if (gnss_report_ptr->valid_mask & RPC_LOC_GNSS_INFO_VALID_SV_LIST)
+   {
       for (i = 0; i < num_svs_max; i++)
       {
          sv_info_ptr = &(gnss_report_ptr->sv_list.sv_list_val[i]);
+         sv_ptr = &SvStatus.sv_list[SvStatus.num_svs];
+         sv_ptr->size = sizeof(GpsSvInfo);
+         sv_ptr->prn = 0;
+
          if (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_SYSTEM)
          {
             if (sv_info_ptr->system == RPC_LOC_SV_SYSTEM_GPS)
             {
-               SvStatus.sv_list[SvStatus.num_svs].size = sizeof(GpsSvStatus);
-               SvStatus.sv_list[SvStatus.num_svs].prn = sv_info_ptr->prn;
+               sv_ptr->prn = sv_info_ptr->prn;
 
                // We only have the data field to report gps eph and alm mask
                if ((sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_HAS_EPH) &&
@@ -1150,13 +1480,13 @@ static void loc_eng_report_sv (const rpc_loc_gnss_info_s_type *gnss_report_ptr)
             // In exteneded measurement report, we follow nmea standard, which is from 33-64.
             else if (sv_info_ptr->system == RPC_LOC_SV_SYSTEM_SBAS)
             {
-               SvStatus.sv_list[SvStatus.num_svs].prn = sv_info_ptr->prn + 33 - 120;
+               sv_ptr->prn = sv_info_ptr->prn + 33 - 120;
             }
             // Gloness: Slot id: 1-32
             // In extended measurement report, we follow nmea standard, which is 65-96
             else if (sv_info_ptr->system == RPC_LOC_SV_SYSTEM_GLONASS)
             {
-               SvStatus.sv_list[SvStatus.num_svs].prn = sv_info_ptr->prn + (65-1);
+               sv_ptr->prn = sv_info_ptr->prn + (65-1);
             }
             // Unsupported SV system
             else
@@ -1165,19 +1495,18 @@ static void loc_eng_report_sv (const rpc_loc_gnss_info_s_type *gnss_report_ptr)
             }
          }
 
-         if (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_SNR)
-         {
-            SvStatus.sv_list[SvStatus.num_svs].snr = sv_info_ptr->snr;
-         }
-
-         if (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_ELEVATION)
-         {
-            SvStatus.sv_list[SvStatus.num_svs].elevation = sv_info_ptr->elevation;
-         }
+         sv_ptr->snr = (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_SNR) ?
+            sv_info_ptr->snr : 0;
+         sv_ptr->elevation = (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_ELEVATION) ?
+            sv_info_ptr->elevation : 0;
+         sv_ptr->azimuth = (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_AZIMUTH) ?
+            sv_info_ptr->azimuth : 0;
 
-         if (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_AZIMUTH)
+         if (!changed &&
+             (SvStatus.num_svs >= last_ptr->num_svs ||
+              loc_eng_sv_changed(sv_ptr, &last_ptr->sv_list[SvStatus.num_svs])))
          {
-            SvStatus.sv_list[SvStatus.num_svs].azimuth = sv_info_ptr->azimuth;
+            changed = TRUE;
          }
 
          SvStatus.num_svs++;
@@ -1185,10 +1514,31 @@ static void loc_eng_report_sv (const rpc_loc_gnss_info_s_type *gnss_report_ptr)
    }
 
    // LOC_LOGD ("num_svs = %d, eph mask = %d, alm mask = %d\n", SvStatus.num_svs, SvStatus.ephemeris_mask, SvStatus.almanac_mask );
-   if ((SvStatus.num_svs != 0) && (loc_eng_data.sv_status_cb != NULL))
+   if ((SvStatus.num_svs == 0) || (loc_eng_data.sv_status_cb == NULL))
    {
-      loc_eng_data.sv_status_cb(&SvStatus);
+      return;
    }
+
+   now_msec = loc_eng_timer_now_msec();
+   if (!changed &&
+       SvStatus.num_svs == last_ptr->num_svs &&
+       SvStatus.used_in_fix_mask == last_ptr->used_in_fix_mask &&
+       SvStatus.ephemeris_mask == last_ptr->ephemeris_mask &&
+       SvStatus.almanac_mask == last_ptr->almanac_mask &&
+       now_msec - loc_eng_data.sv_status_msec < LOC_ENG_SV_REFRESH_MSEC)
+   {
+      return;
+   }
+
+   loc_eng_data.sv_status_cb(&SvStatus);
+
+   memcpy(last_ptr, &SvStatus, offsetof(GpsSvStatus, sv_list));
+   memcpy(last_ptr->sv_list, SvStatus.sv_list, SvStatus.num_svs * sizeof(GpsSvInfo));
+   last_ptr->ephemeris_mask = SvStatus.ephemeris_mask;
+   last_ptr->almanac_mask = SvStatus.almanac_mask;
+   last_ptr->used_in_fix_mask = SvStatus.used_in_fix_mask;
+   loc_eng_data.sv_status_valid = TRUE;
+   loc_eng_data.sv_status_msec = now_msec;
 }
 
 /*===========================================================================
@@ -1243,16 +1593,18 @@ static void loc_eng_report_status (const rpc_loc_status_event_s_type *status_rep
       // every location report, and we only want the overall session.
    }
 
-   // report changed status
+   // report changed status, except while duty cycling turns the engine on and off
 
    // FIX_SESSION_BEGIN implies ENGINE_ON
    if (loc_eng_data.fix_session_status != GPS_STATUS_SESSION_BEGIN
-         && engine_status != loc_eng_data.engine_status)
+         && engine_status != loc_eng_data.engine_status
+         && !loc_eng_sched_cycling())
       loc_inform_gps_status(loc_eng_data.engine_status);
 
    // ENGINE_OFF implies FIX_SESSION_END
    if (loc_eng_data.engine_status != GPS_STATUS_ENGINE_OFF
-         && fix_session_status != loc_eng_data.fix_session_status)
+         && fix_session_status != loc_eng_data.fix_session_status
+         && !loc_eng_sched_cycling())
       loc_inform_gps_status(loc_eng_data.fix_session_status);
 
    pthread_mutex_lock(&loc_eng_data.mute_session_lock);
@@ -1276,21 +1628,8 @@ static void loc_eng_report_status (const rpc_loc_status_event_s_type *status_rep
    }
    pthread_mutex_unlock(&loc_eng_data.mute_session_lock);
 
-
-   pthread_mutex_lock (&loc_eng_data.deferred_action_mutex);
-
-   // Wake up the thread for aiding data deletion, XTRA injection, etc.
-   if (loc_eng_data.engine_status != GPS_STATUS_ENGINE_ON &&
-       (loc_eng_data.aiding_data_for_deletion != 0 ||
-        loc_eng_data.xtra_module_data.xtra_data_for_injection != NULL))
-   {
-       /* hold a wake lock while events are pending for deferred_action_thread */
-       loc_eng_data.acquire_wakelock_cb();
-       loc_eng_data.deferred_action_flags |= DEFERRED_ACTION_DELETE_AIDING;
-       pthread_cond_signal(&loc_eng_data.deferred_action_cond);
-      // In case gps engine is ON, the assistance data will be deleted when the engine is OFF
-   }
-   pthread_mutex_unlock (&loc_eng_data.deferred_action_mutex);
+   // Aiding data deletion and XTRA injection held back while the engine was
+   // on are done by the deferred action thread after this event
 }
 
 /*===========================================================================
@@ -1311,24 +1650,16 @@ SIDE EFFECTS
 ===========================================================================*/
 static void loc_eng_report_nmea(const rpc_loc_nmea_report_s_type *nmea_report_ptr)
 {
-   if (loc_eng_data.nmea_cb != NULL)
-   {
-      struct timeval tv;
-
-      gettimeofday(&tv, (struct timezone *) NULL);
-      long long now = tv.tv_sec * 1000LL + tv.tv_usec / 1000;
-
 #if (AMSS_VERSION==3200||AMSS_VERSION==20000)
-      loc_eng_data.nmea_cb(now, nmea_report_ptr->nmea_sentences.nmea_sentences_val,
-            nmea_report_ptr->nmea_sentences.nmea_sentences_len);
+   loc_eng_nmea_report(nmea_report_ptr->nmea_sentences.nmea_sentences_val,
+         nmea_report_ptr->nmea_sentences.nmea_sentences_len);
 #else
-      loc_eng_data.nmea_cb(now, nmea_report_ptr->nmea_sentences, nmea_report_ptr->length);
-      LOC_LOGD("loc_eng_report_nmea: $%c%c%c\n",
-         nmea_report_ptr->nmea_sentences[3], nmea_report_ptr->nmea_sentences[4],
-               nmea_report_ptr->nmea_sentences[5]);
+   loc_eng_nmea_report(nmea_report_ptr->nmea_sentences, nmea_report_ptr->length);
+   LOC_LOGD("loc_eng_report_nmea: $%c%c%c\n",
+      nmea_report_ptr->nmea_sentences[3], nmea_report_ptr->nmea_sentences[4],
+            nmea_report_ptr->nmea_sentences[5]);
 
 #endif /* #if (AMSS_VERSION==3200||AMSS_VERSION==20000) */
-   }
 }
 
 /*===========================================================================
@@ -1350,26 +1681,27 @@ SIDE EFFECTS
 static void loc_eng_process_conn_request (const rpc_loc_server_request_s_type *server_request_ptr)
 {
    LOC_LOGD("loc_event_cb: get loc event location server request, event = %d\n", server_request_ptr->event);
-   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   AGpsStatusValue                  status;
+   rpc_loc_server_connection_handle conn_handle;
 
+   pthread_mutex_lock(&(loc_eng_data.deferred_stop_mutex));
    if (server_request_ptr->event == RPC_LOC_SERVER_REQUEST_OPEN)
    {
-      loc_eng_data.agps_status = GPS_REQUEST_AGPS_DATA_CONN;
-      loc_eng_data.conn_handle = server_request_ptr->payload.rpc_loc_server_request_u_type_u.open_req.conn_handle;
+      status = GPS_REQUEST_AGPS_DATA_CONN;
+      conn_handle = server_request_ptr->payload.rpc_loc_server_request_u_type_u.open_req.conn_handle;
       loc_eng_data.agps_request_pending = true;
    }
    else
    {
-      loc_eng_data.agps_status = GPS_RELEASE_AGPS_DATA_CONN;
-      loc_eng_data.conn_handle = server_request_ptr->payload.rpc_loc_server_request_u_type_u.close_req.conn_handle;
+      status = GPS_RELEASE_AGPS_DATA_CONN;
+      conn_handle = server_request_ptr->payload.rpc_loc_server_request_u_type_u.close_req.conn_handle;
       loc_eng_data.agps_request_pending = false;
    }
-   /* hold a wake lock while events are pending for deferred_action_thread */
-   loc_eng_data.acquire_wakelock_cb();
-   loc_eng_data.deferred_action_flags |= DEFERRED_ACTION_AGPS_STATUS;
-   pthread_cond_signal(&loc_eng_data.deferred_action_cond);
-   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+   pthread_mutex_unlock(&(loc_eng_data.deferred_stop_mutex));
 
+   loc_eng_trace_agps(status, (uint32) conn_handle);
+   // The handle is taken over when the request is acted on, see LOC_ENG_CMD_AGPS_STATUS
+   loc_eng_cmd_post_agps_status(status, conn_handle);
 }
 
 /*===========================================================================
@@ -1622,11 +1954,9 @@ static int loc_eng_data_conn_open(const char* apn)
    LOC_LOGD("loc_eng_data_conn_open APN name = [%s]", apn);
    pthread_mutex_lock(&(loc_eng_data.deferred_action_mutex));
    loc_eng_set_apn(apn);
-   /* hold a wake lock while events are pending for deferred_action_thread */
-   loc_eng_data.acquire_wakelock_cb();
-   loc_eng_data.deferred_action_flags |= DEFERRED_ACTION_AGPS_DATA_SUCCESS;
-   pthread_cond_signal(&(loc_eng_data.deferred_action_cond));
    pthread_mutex_unlock(&(loc_eng_data.deferred_action_mutex));
+   loc_eng_trace_agps(GPS_AGPS_DATA_CONNECTED, (uint32) loc_eng_data.conn_handle);
+   loc_eng_cmd_post(LOC_ENG_CMD_DATA_OPEN);
    return 0;
 }
 
@@ -1652,12 +1982,8 @@ static int loc_eng_data_conn_closed()
    INIT_CHECK("loc_eng_data_conn_closed");
 
    LOC_LOGD("loc_eng_data_conn_closed");
-   pthread_mutex_lock(&(loc_eng_data.deferred_action_mutex));
-   /* hold a wake lock while events are pending for deferred_action_thread */
-   loc_eng_data.acquire_wakelock_cb();
-   loc_eng_data.deferred_action_flags |= DEFERRED_ACTION_AGPS_DATA_CLOSED;
-   pthread_cond_signal(&(loc_eng_data.deferred_action_cond));
-   pthread_mutex_unlock(&(loc_eng_data.deferred_action_mutex));
+   loc_eng_trace_agps(GPS_AGPS_DATA_CONN_DONE, (uint32) loc_eng_data.conn_handle);
+   loc_eng_cmd_post(LOC_ENG_CMD_DATA_CLOSED);
    return 0;
 }
 
@@ -1683,12 +2009,8 @@ int loc_eng_data_conn_failed()
    INIT_CHECK("loc_eng_data_conn_failed");
    LOC_LOGD("loc_eng_data_conn_failed");
 
-   pthread_mutex_lock(&(loc_eng_data.deferred_action_mutex));
-   /* hold a wake lock while events are pending for deferred_action_thread */
-   loc_eng_data.acquire_wakelock_cb();
-   loc_eng_data.deferred_action_flags |= DEFERRED_ACTION_AGPS_DATA_FAILED;
-   pthread_cond_signal(&(loc_eng_data.deferred_action_cond));
-   pthread_mutex_unlock(&(loc_eng_data.deferred_action_mutex));
+   loc_eng_trace_agps(GPS_AGPS_DATA_CONN_FAILED, (uint32) loc_eng_data.conn_handle);
+   loc_eng_cmd_post(LOC_ENG_CMD_DATA_FAILED);
    return 0;
 }
 
@@ -1747,45 +2069,6 @@ static int loc_eng_set_apn (const char* apn)
    return 0;
 }
 
-/*===========================================================================
-
-FUNCTION resolve_in_addr
-
-DESCRIPTION
-   Translates a hostname to in_addr struct
-
-DEPENDENCIES
-   n/a
-
-RETURN VALUE
-   TRUE if successful
-
-SIDE EFFECTS
-   n/a
-
-===========================================================================*/
-static boolean resolve_in_addr(const char *host_addr, struct in_addr *in_addr_ptr)
-{
-   struct hostent             *hp;
-   hp = gethostbyname(host_addr);
-   if (hp != NULL) /* DNS OK */
-   {
-      memcpy(in_addr_ptr, hp->h_addr_list[0], hp->h_length);
-   }
-   else
-   {
-      /* Try IP representation */
-      if (inet_aton(host_addr, in_addr_ptr) == 0)
-      {
-         /* IP not valid */
-         LOC_LOGE("DNS query on '%s' failed\n", host_addr);
-         return FALSE;
-      }
-   }
-
-   return TRUE;
-}
-
 /*===========================================================================
 FUNCTION    loc_eng_set_server
 
@@ -1847,27 +2130,15 @@ static int loc_eng_set_server(AGpsType type, const char* hostname, int port)
       break;
 
    case AGPS_TYPE_C2K:
-      if (!resolve_in_addr(hostname, &addr))
+      // The modem takes an IPv4 address, resolved off this thread. A cached
+      // address is used right away, a new one is sent once it is resolved.
+      if (!loc_eng_resolve(hostname, &addr, loc_eng_set_server_resolved, (void *) (intptr_t) port))
       {
-         LOC_LOGE("loc_eng_set_server, hostname %s cannot be resolved.\n", hostname);
-         return -2;
+         LOC_LOGD("loc_eng_set_server, hostname %s is being resolved.\n", hostname);
+         return 0;
       }
+      return loc_eng_set_c2k_server(addr, port);
 
-      ioctl_cmd = RPC_LOC_IOCTL_SET_CDMA_PDE_SERVER_ADDR;
-      ioctl_data.disc = ioctl_cmd;
-      server_info_ptr->addr_type = RPC_LOC_SERVER_ADDR_IPV4;
-      server_info_ptr->addr_info.disc = server_info_ptr->addr_type;
-      server_info_ptr->addr_info.rpc_loc_server_addr_u_type_u.ipv4.addr = (uint32_t) htonl(addr.s_addr);
-      server_info_ptr->addr_info.rpc_loc_server_addr_u_type_u.ipv4.port = port;
-      LOC_LOGD ("loc_eng_set_server, addr = %X:%d\n",
-            (unsigned int) server_info_ptr->addr_info.rpc_loc_server_addr_u_type_u.ipv4.addr,
-            (unsigned int) port);
-
-      // Set C2K flag for Donut. In Eclair, C2K and UMTS will be identical
-      // at the HAL layer, and this will be obsolete.
-      loc_c2k_addr_is_set = 1;
-
-      break;
    default:
       LOC_LOGE("loc_eng_set_server, unknown server type = %d", (int) type);
       return 0; /* note: error not indicated, since JNI doesn't check */
@@ -1891,6 +2162,89 @@ static int loc_eng_set_server(AGpsType type, const char* hostname, int port)
    return 0;
 }
 
+/*===========================================================================
+FUNCTION    loc_eng_set_c2k_server
+
+DESCRIPTION
+   Sends the resolved C2K PDE server address to the modem.
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   0
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_set_c2k_server(struct in_addr addr, int port)
+{
+   rpc_loc_ioctl_data_u_type         ioctl_data;
+   rpc_loc_server_info_s_type       *server_info_ptr;
+   rpc_loc_ioctl_e_type              ioctl_cmd = RPC_LOC_IOCTL_SET_CDMA_PDE_SERVER_ADDR;
+   boolean                           ret_val;
+
+   server_info_ptr = &ioctl_data.rpc_loc_ioctl_data_u_type_u.server_addr;
+
+   ioctl_data.disc = ioctl_cmd;
+   server_info_ptr->addr_type = RPC_LOC_SERVER_ADDR_IPV4;
+   server_info_ptr->addr_info.disc = server_info_ptr->addr_type;
+   server_info_ptr->addr_info.rpc_loc_server_addr_u_type_u.ipv4.addr = (uint32_t) htonl(addr.s_addr);
+   server_info_ptr->addr_info.rpc_loc_server_addr_u_type_u.ipv4.port = port;
+   LOC_LOGD ("loc_eng_set_server, addr = %X:%d\n",
+         (unsigned int) server_info_ptr->addr_info.rpc_loc_server_addr_u_type_u.ipv4.addr,
+         (unsigned int) port);
+
+   // Set C2K flag for Donut. In Eclair, C2K and UMTS will be identical
+   // at the HAL layer, and this will be obsolete.
+   loc_c2k_addr_is_set = 1;
+
+   ret_val = loc_eng_ioctl (loc_eng_data.client_handle,
+                            ioctl_cmd,
+                            &ioctl_data,
+                            LOC_IOCTL_DEFAULT_TIMEOUT,
+                            NULL /* No output information is expected*/);
+
+   if (ret_val != TRUE)
+   {
+      LOC_LOGE("loc_eng_set_server failed\n");
+   }
+   else
+   {
+      LOC_LOGV("loc_eng_set_server successful\n");
+   }
+
+   return 0;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_set_server_resolved
+
+DESCRIPTION
+   Resolver callback for the C2K server, sends the new address to the modem.
+
+DEPENDENCIES
+   Called on the resolver thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_set_server_resolved(const char *hostname, struct in_addr addr, void *user_data)
+{
+   if (!loc_eng_inited)
+   {
+      return;
+   }
+
+   LOC_LOGD("loc_eng_set_server_resolved, hostname = %s\n", hostname);
+   loc_eng_set_c2k_server(addr, (int) (intptr_t) user_data);
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_set_server_proxy
 
@@ -1971,13 +2325,43 @@ static void loc_eng_delete_aiding_data_action(void)
    memset(&assist_data_ptr->reserved, 0, sizeof assist_data_ptr->reserved);
 
    ioctl_data.disc = ioctl_type;
-   ret_val = loc_eng_ioctl (loc_eng_data.client_handle,
-                            ioctl_type,
-                            &ioctl_data,
-                            LOC_IOCTL_DEFAULT_TIMEOUT,
-                            NULL);
 
-   LOC_LOGV("loc_eng_delete_aiding_data_action: %s\n", log_succ_fail_string(ret_val));
+   // Do not wait for the report here, the deferred action thread would be
+   // stalled for up to LOC_IOCTL_DEFAULT_TIMEOUT
+   ret_val = loc_eng_ioctl_async (loc_eng_data.client_handle,
+                                  ioctl_type,
+                                  &ioctl_data,
+                                  LOC_IOCTL_DEFAULT_TIMEOUT,
+                                  loc_eng_delete_aiding_data_done,
+                                  NULL) == RPC_LOC_API_SUCCESS;
+
+   if (ret_val != TRUE)
+   {
+      LOC_LOGE("loc_eng_delete_aiding_data_action: failed\n");
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_delete_aiding_data_done
+
+DESCRIPTION
+   Completion handler of the RPC_LOC_IOCTL_DELETE_ASSIST_DATA IOCTL.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_delete_aiding_data_done(rpc_loc_ioctl_e_type ioctl_type, int status,
+            const rpc_loc_ioctl_callback_s_type *cb_data_ptr, void *user_data)
+{
+   LOC_LOGV("loc_eng_delete_aiding_data_action: %s\n",
+         log_succ_fail_string(status == RPC_LOC_API_SUCCESS));
 }
 
 /*===========================================================================
@@ -2103,6 +2487,77 @@ static int loc_eng_set_gps_lock(rpc_loc_lock_e_type lock_type)
 }
 #endif
 
+/*===========================================================================
+FUNCTION loc_eng_deferred_stop_timeout
+
+DESCRIPTION
+   Timer callback, stops the engine if a stop deferred for an AGPS data call
+   is still pending after DEFERRED_STOP_TIMEOUT.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_deferred_stop_timeout(void* arg)
+{
+   pthread_mutex_lock(&(loc_eng_data.deferred_stop_mutex));
+   loc_eng_data.deferred_stop_timer = LOC_ENG_TIMER_INVALID;
+   if (loc_eng_data.stop_request_pending)
+   {
+      LOC_LOGW("loc_eng_deferred_stop_timeout: no AGPS data call result, stopping now\n");
+      loc_eng_data.agps_request_pending = false;
+      loc_eng_data.stop_request_pending = false;
+      if (loc_stop_fix(loc_eng_data.client_handle) != RPC_LOC_API_SUCCESS)
+      {
+         LOC_LOGD ("loc_stop_fix failed!\n");
+      }
+   }
+   pthread_mutex_unlock(&(loc_eng_data.deferred_stop_mutex));
+}
+
+/*===========================================================================
+FUNCTION loc_eng_deferred_stop
+
+DESCRIPTION
+   Stops the engine if loc_eng_stop was deferred while an AGPS request was
+   pending, called once the framework reported on the data connection.
+
+DEPENDENCIES
+   None
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_deferred_stop()
+{
+   pthread_mutex_lock(&(loc_eng_data.deferred_stop_mutex));
+   // work around problem with loc_eng_stop when AGPS requests are pending
+   // we defer stopping the engine until the AGPS request is done
+   loc_eng_data.agps_request_pending = false;
+   if (loc_eng_data.stop_request_pending)
+   {
+      LOC_LOGD ("handling deferred stop\n");
+      loc_eng_data.stop_request_pending = false;
+      loc_eng_timer_stop(loc_eng_data.deferred_stop_timer);
+      loc_eng_data.deferred_stop_timer = LOC_ENG_TIMER_INVALID;
+      if (loc_stop_fix(loc_eng_data.client_handle) != RPC_LOC_API_SUCCESS)
+      {
+         LOC_LOGD ("loc_stop_fix failed!\n");
+      }
+   }
+   pthread_mutex_unlock(&(loc_eng_data.deferred_stop_mutex));
+}
+
 /*===========================================================================
 FUNCTION loc_eng_deferred_action_thread
 
@@ -2122,7 +2577,6 @@ SIDE EFFECTS
 ===========================================================================*/
 static void loc_eng_deferred_action_thread(void* arg)
 {
-   AGpsStatusValue      status;
    LOC_LOGD("loc_eng_deferred_action_thread started\n");
 
 #ifdef LIBLOC_USE_GPS_PRIVACY_LOCK
@@ -2133,58 +2587,130 @@ static void loc_eng_deferred_action_thread(void* arg)
    set_sched_policy(gettid(), SP_FOREGROUND);
    while (1)
    {
-      GpsAidingData   aiding_data_for_deletion;
-      GpsStatusValue  engine_status;
-      boolean         data_connection_succeeded;
-      boolean         data_connection_closed;
-      boolean         data_connection_failed;
-      rpc_loc_event_mask_type         loc_event;
-      rpc_loc_event_payload_u_type    loc_event_payload;
+      loc_eng_cmd_s_type *cmd;
+      int                 pending;
+      uint32              latency_msec;
 
       // Wait until we are signalled to do a deferred action, or exit
       pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
 
-     // If we have an event we should process it immediately,
+     // If we have a command we should process it immediately,
      // otherwise wait until we are signalled
-     if (loc_eng_data.deferred_action_flags == 0) {
+     if (!loc_eng_cmd_ready()) {
+            struct timespec timer_expire_time;
             // do not hold a wake lock while waiting for an event...
             loc_eng_data.release_wakelock_cb();
             LOC_LOGD("loc_eng_deferred_action_thread. waiting for events\n");
-            pthread_cond_wait(&loc_eng_data.deferred_action_cond,
-                                &loc_eng_data.deferred_action_mutex);
+            // wake up in time for the next loc_eng_timer
+            if (loc_eng_timer_next_expire(&timer_expire_time))
+            {
+               loc_eng_cond_timedwait_monotonic(&loc_eng_data.deferred_action_cond,
+                                                &loc_eng_data.deferred_action_mutex,
+                                                &timer_expire_time);
+            }
+            else
+            {
+               pthread_cond_wait(&loc_eng_data.deferred_action_cond,
+                                 &loc_eng_data.deferred_action_mutex);
+            }
             LOC_LOGD("loc_eng_deferred_action_thread signalled\n");
             // but after we are signalled reacquire the wake lock
             // until we are done processing the event.
             loc_eng_data.acquire_wakelock_cb();
      }
-      if (loc_eng_data.deferred_action_flags & DEFERRED_ACTION_QUIT)
+      if (loc_eng_cmd_quitting())
       {
          pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
          break; /* exit thread */
       }
-     // copy anything we need before releasing the mutex
-      loc_event = loc_eng_data.loc_event;
-      if (loc_event != 0) {
-          LOC_LOGD("loc_eng_deferred_action_thread event %llu\n",loc_event);
-          memcpy(&loc_event_payload, &loc_eng_data.loc_event_payload, sizeof(loc_event_payload));
-          loc_eng_data.loc_event = 0;
-      }
-      int flags = loc_eng_data.deferred_action_flags;
-      loc_eng_data.deferred_action_flags = 0;
-      engine_status = loc_eng_data.engine_status;
-      aiding_data_for_deletion = loc_eng_data.aiding_data_for_deletion;
-      status = loc_eng_data.agps_status;
-      loc_eng_data.agps_status = 0;
+      // One command per pass, the queue keeps the order they were posted in
+      cmd = loc_eng_cmd_take(&pending, &latency_msec);
 
       // perform all actions after releasing the mutex to avoid blocking RPCs from the ARM9
       pthread_mutex_unlock(&(loc_eng_data.deferred_action_mutex));
 
-      if (loc_event != 0) {
-          loc_eng_process_loc_event(loc_event, &loc_event_payload);
+      if (cmd != NULL)
+      {
+         loc_eng_trace_queue(cmd->type, pending, latency_msec,
+                             loc_eng_ioctl_async_in_flight(), loc_eng_timer_armed());
+
+         switch (cmd->type)
+         {
+         case LOC_ENG_CMD_EVENT:
+            LOC_LOGD("loc_eng_deferred_action_thread event %llu\n", cmd->u.event.loc_event);
+            loc_eng_process_loc_event(cmd->u.event.loc_event, &cmd->u.event.payload);
+            break;
+
+         case LOC_ENG_CMD_DELETE_AIDING:
+            // Deleted below once the engine is off
+            loc_eng_data.aiding_data_for_deletion |= cmd->u.aiding_data;
+            break;
+
+         case LOC_ENG_CMD_AGPS_STATUS:
+            // ATL open/close actions
+            loc_eng_data.conn_handle = cmd->u.agps.conn_handle;
+            loc_eng_process_atl_action(cmd->u.agps.status);
+            break;
+
+         //Process connectivity manager events at this point
+         case LOC_ENG_CMD_DATA_OPEN:
+            loc_eng_ioctl_data_open_status(SUCCESS);
+            loc_eng_deferred_stop();
+            break;
+
+         case LOC_ENG_CMD_DATA_CLOSED:
+            loc_eng_ioctl_data_close_status(SUCCESS);
+            loc_eng_deferred_stop();
+            break;
+
+         case LOC_ENG_CMD_DATA_FAILED:
+            if(loc_eng_data.data_connection_is_on == TRUE)
+            {
+               loc_eng_ioctl_data_open_status(FAILURE);
+            }else
+            {
+               loc_eng_ioctl_data_close_status(FAILURE);
+            }
+            loc_eng_data.data_connection_is_on = FALSE;
+            loc_eng_deferred_stop();
+            break;
+
+         case LOC_ENG_CMD_IOCTL_DONE:
+            // Handled with the timeouts below
+            break;
+
+         case LOC_ENG_CMD_BATCH_FLUSH:
+            // Batched fixes
+            loc_eng_batch_flush(loc_eng_report_batched_position);
+            break;
+
+         case LOC_ENG_CMD_SCHED_ALARM:
+            // Duty cycling, turn the engine back on
+            loc_eng_sched_warm_start();
+            break;
+
+         case LOC_ENG_CMD_INTERP_STOP:
+            // Session stopped, predictions end with it
+            loc_eng_interp_stop();
+            break;
+
+         case LOC_ENG_CMD_XTRA_INJECT:
+         default:
+            break;
+         }
+
+         loc_eng_cmd_done(cmd);
       }
 
+      // Timeouts: NI responses, asynchronous IOCTLs, deferred stop
+      loc_eng_timer_process();
+
+      // Completions of asynchronous IOCTLs, reported or timed out
+      loc_eng_ioctl_async_process();
+
       // Send_delete_aiding_data must be done when GPS engine is off
-      if ((engine_status != GPS_STATUS_ENGINE_ON) && (aiding_data_for_deletion != 0))
+      if ((loc_eng_data.engine_status != GPS_STATUS_ENGINE_ON) &&
+          (loc_eng_data.aiding_data_for_deletion != 0))
       {
          loc_eng_delete_aiding_data_action();
          loc_eng_data.aiding_data_for_deletion = 0;
@@ -2196,55 +2722,12 @@ static void loc_eng_deferred_action_thread(void* arg)
       {
          loc_eng_inject_xtra_data_in_buffer();
       }
+   }
 
-      //Process connectivity manager events at this point
-      if(flags & DEFERRED_ACTION_AGPS_DATA_SUCCESS)
-      {
-         loc_eng_ioctl_data_open_status(SUCCESS);
-         if(flags & DEFERRED_ACTION_AGPS_DATA_CLOSED)
-         {
-            LOC_LOGE("Error condition in the ATL events posted by GpsLocationProvider\n");
-         }
-      }else if(flags & DEFERRED_ACTION_AGPS_DATA_CLOSED)
-      {
-         loc_eng_ioctl_data_close_status(SUCCESS);
-      }else if(flags & DEFERRED_ACTION_AGPS_DATA_FAILED)
-      {
-         if(loc_eng_data.data_connection_is_on == TRUE)
-         {
-            loc_eng_ioctl_data_open_status(FAILURE);
-         }else
-         {
-            loc_eng_ioctl_data_close_status(FAILURE);
-         }
-         loc_eng_data.data_connection_is_on = FALSE;
-      }
-      if (flags & (DEFERRED_ACTION_AGPS_DATA_SUCCESS |
-                   DEFERRED_ACTION_AGPS_DATA_CLOSED |
-                   DEFERRED_ACTION_AGPS_DATA_FAILED))
-      {
-          pthread_mutex_lock(&(loc_eng_data.deferred_stop_mutex));
-          // work around problem with loc_eng_stop when AGPS requests are pending
-          // we defer stopping the engine until the AGPS request is done
-          loc_eng_data.agps_request_pending = false;
-          if (loc_eng_data.stop_request_pending)
-           {
-              LOC_LOGD ("handling deferred stop\n");
-              if (loc_stop_fix(loc_eng_data.client_handle) != RPC_LOC_API_SUCCESS)
-               {
-                   LOC_LOGD ("loc_stop_fix failed!\n");
-               }
-           }
-           pthread_mutex_unlock(&(loc_eng_data.deferred_stop_mutex));
-       }
+   loc_eng_cmd_log_stats();
 
-      // ATL open/close actions
-      if (status != 0 )
-      {
-         loc_eng_process_atl_action(status);
-         status = 0;
-      }
-   }
+   // Let pending completions release their resources
+   loc_eng_ioctl_async_cancel_all();
 
 #ifdef LIBLOC_USE_GPS_PRIVACY_LOCK
    loc_eng_set_gps_lock(RPC_LOC_LOCK_ALL);
@@ -44,10 +44,21 @@ typedef unsigned char boolean;
 #define FALSE 0
 #endif
 
+#include <loc_eng_timer.h>
 #include <loc_eng_ioctl.h>
 #include <loc_eng_xtra.h>
 #include <loc_eng_ni.h>
+#include <loc_eng_batch.h>
+#include <loc_eng_resolver.h>
+#include <loc_eng_kalman.h>
+#include <loc_eng_interp.h>
+#include <loc_eng_sv.h>
+#include <loc_eng_nmea.h>
+#include <loc_eng_geofence.h>
+#include <loc_eng_sched.h>
+#include <loc_eng_cmd.h>
 #include <loc_eng_log.h>
+#include <loc_eng_trace.h>
 #include <loc_eng_cfg.h>
 
 #define LOC_IOCTL_DEFAULT_TIMEOUT 1500 // 1500 milli-seconds
@@ -57,6 +68,9 @@ typedef unsigned char boolean;
 
 // The system sees GPS engine turns off after inactive for this period of time
 #define GPS_AUTO_OFF_TIME         2  /* secs */
+
+// A stop deferred for a pending AGPS data call is forced after this time
+#define DEFERRED_STOP_TIMEOUT     20 /* secs */
 //To signify that when requesting a data connection HAL need not specify whether CDMA or UMTS
 #define DONT_CARE                 0
 
@@ -67,16 +81,6 @@ enum loc_mute_session_e_type {
    LOC_MUTE_SESS_IN_SESSION
 };
 
-enum {
-    DEFERRED_ACTION_EVENT               = 0x01,
-    DEFERRED_ACTION_DELETE_AIDING       = 0x02,
-    DEFERRED_ACTION_AGPS_STATUS         = 0x04,
-    DEFERRED_ACTION_AGPS_DATA_SUCCESS   = 0x08,
-    DEFERRED_ACTION_AGPS_DATA_CLOSED    = 0x10,
-    DEFERRED_ACTION_AGPS_DATA_FAILED    = 0x20,
-    DEFERRED_ACTION_QUIT                = 0x40,
-};
-
 // Module data
 typedef struct
 {
@@ -90,18 +94,36 @@ typedef struct
    gps_ni_notify_callback         ni_notify_cb;
    gps_acquire_wakelock           acquire_wakelock_cb;
    gps_release_wakelock           release_wakelock_cb;
-   AGpsStatusValue                agps_status;
    // used to defer stopping the GPS engine until AGPS data calls are done
    boolean                         agps_request_pending;
    boolean                         stop_request_pending;
+   int                             deferred_stop_timer;
    pthread_mutex_t                 deferred_stop_mutex;
    loc_eng_xtra_data_s_type       xtra_module_data;
-   // data from loc_event_cb
-   rpc_loc_event_mask_type        loc_event;
-   rpc_loc_event_payload_u_type   loc_event_payload;
 
    boolean                        client_opened;
    boolean                        navigating;
+
+   // Fix criteria last set by the framework and last acknowledged by the modem
+   rpc_loc_fix_criteria_s_type    fix_criteria;
+   boolean                        fix_criteria_set;
+   rpc_loc_fix_criteria_s_type    fix_criteria_applied;
+   boolean                        fix_criteria_applied_valid;
+
+   // Position smoothing (SMOOTHING in gps.conf), owned by the deferred action
+   // thread, which resets it when position_filter_reset is set under
+   // deferred_action_mutex
+   loc_eng_kf_s_type              position_filter;
+   boolean                        position_filter_reset;
+
+   // Satellite list last reported to the framework, owned by the deferred
+   // action thread, which forgets it when sv_status_reset is set under
+   // deferred_action_mutex
+   GpsSvStatus                    sv_status;
+   boolean                        sv_status_valid;
+   long long                      sv_status_msec;
+   boolean                        sv_status_reset;
+
    boolean                        data_connection_is_on;
 
    // ATL variables
@@ -114,6 +136,7 @@ typedef struct
    GpsStatusValue                 fix_session_status;
 
    // Aiding data information to be deleted, aiding data can only be deleted when GPS engine is off
+   // (owned by the deferred action thread, requests come through LOC_ENG_CMD_DELETE_AIDING)
    GpsAidingData                  aiding_data_for_deletion;
 
    // IOCTL CB lock
@@ -125,12 +148,12 @@ typedef struct
    // Timer thread (wakes up every second)
    pthread_t                      timer_thread;
 
-   // Mutex used by deferred action thread
+   // Mutex used by deferred action thread. Module locks (batch, ioctl, NI,
+   // scheduler, deferred stop) are taken before it, loc_eng_timer's lock
+   // after it, never the other way round.
    pthread_mutex_t                deferred_action_mutex;
    // Condition variable used by deferred action thread
    pthread_cond_t                 deferred_action_cond;
-   // flags for pending events for deferred action thread
-   int                             deferred_action_flags;
    // For muting session broadcast
    pthread_mutex_t                mute_session_lock;
    loc_mute_session_e_type        mute_session_state;
@@ -142,19 +165,28 @@ extern loc_eng_data_s_type loc_eng_data;
 extern void loc_eng_mute_one_session();
 
 /* LOGGING MACROS */
+#define LOC_LOG_LEVEL_E   1
+#define LOC_LOG_LEVEL_W   2
+#define LOC_LOG_LEVEL_I   3
+#define LOC_LOG_LEVEL_D   4
+#define LOC_LOG_LEVEL_V   5
+
+// Check before building anything that is only used for logging
+#define LOC_LOG_ENABLED(level) (gps_conf.DEBUG_LEVEL >= (level))
+
 #define LOC_LOGE(...) \
-if (gps_conf.DEBUG_LEVEL >= 1) { ALOGE(__VA_ARGS__); }
+if (LOC_LOG_ENABLED(LOC_LOG_LEVEL_E)) { ALOGE(__VA_ARGS__); }
 
 #define LOC_LOGW(...) \
-if (gps_conf.DEBUG_LEVEL >= 2) { ALOGW(__VA_ARGS__); }
+if (LOC_LOG_ENABLED(LOC_LOG_LEVEL_W)) { ALOGW(__VA_ARGS__); }
 
 #define LOC_LOGI(...) \
-if (gps_conf.DEBUG_LEVEL >= 3) { ALOGI(__VA_ARGS__); }
+if (LOC_LOG_ENABLED(LOC_LOG_LEVEL_I)) { ALOGI(__VA_ARGS__); }
 
 #define LOC_LOGD(...) \
-if (gps_conf.DEBUG_LEVEL >= 4) { ALOGD(__VA_ARGS__); }
+if (LOC_LOG_ENABLED(LOC_LOG_LEVEL_D)) { ALOGD(__VA_ARGS__); }
 
 #define LOC_LOGV(...) \
-if (gps_conf.DEBUG_LEVEL >= 5) { ALOGV(__VA_ARGS__); }
+if (LOC_LOG_ENABLED(LOC_LOG_LEVEL_V)) { ALOGV(__VA_ARGS__); }
 
 #endif // LOC_ENG_H
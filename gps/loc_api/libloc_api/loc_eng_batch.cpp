@@ -0,0 +1,309 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <hardware/gps.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+static int loc_eng_batch_flush_proxy();
+static void loc_eng_batch_timeout(void *user_data);
+
+const LocBatchInterface sLocEngBatchInterface =
+{
+   sizeof(LocBatchInterface),
+   loc_eng_batch_flush_proxy,
+};
+
+/* Position reports are buffered as they come from the RPC callback, without
+ * waking the deferred action thread, and delivered from there when flushed.
+ * The lock protects the ring and the configuration. */
+static loc_eng_batch_data_s_type loc_eng_batch_data =
+{
+   PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*===========================================================================
+FUNCTION    loc_eng_batch_init
+
+DESCRIPTION
+   Applies BATCH_SIZE and BATCH_TIMEOUT from gps.conf and drops any fixes
+   left from a previous client. Called from loc_eng_init.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_batch_init()
+{
+   int batch_size = (int) gps_conf.BATCH_SIZE;
+
+   if (batch_size > LOC_ENG_BATCH_MAX)
+   {
+      LOC_LOGW("loc_eng_batch_init: BATCH_SIZE %d limited to %d\n", batch_size, LOC_ENG_BATCH_MAX);
+      batch_size = LOC_ENG_BATCH_MAX;
+   }
+
+   pthread_mutex_lock(&loc_eng_batch_data.lock);
+   // A batch of one fix is the same as no batching
+   loc_eng_batch_data.batch_size = batch_size > 1 ? batch_size : 0;
+   loc_eng_batch_data.batch_timeout_msec = (long long) gps_conf.BATCH_TIMEOUT * 1000;
+   loc_eng_batch_data.head = 0;
+   loc_eng_batch_data.count = 0;
+   loc_eng_timer_stop(loc_eng_batch_data.timer_id);
+   loc_eng_batch_data.timer_id = LOC_ENG_TIMER_INVALID;
+   pthread_mutex_unlock(&loc_eng_batch_data.lock);
+
+   LOC_LOGD("loc_eng_batch_init: batch size = %d, timeout = %ld sec\n",
+         batch_size, gps_conf.BATCH_TIMEOUT);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batch_enabled
+
+DESCRIPTION
+   Tells whether fixes are batched instead of reported one by one.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   TRUE if batching is configured
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_batch_enabled()
+{
+   boolean enabled;
+
+   pthread_mutex_lock(&loc_eng_batch_data.lock);
+   enabled = loc_eng_batch_data.batch_size != 0;
+   pthread_mutex_unlock(&loc_eng_batch_data.lock);
+
+   return enabled;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batch_add
+
+DESCRIPTION
+   Buffers a position report in place of reporting it; it is converted
+   and filtered when the batch is flushed. The caller requests the flush
+   when this returns TRUE. If the ring is full the oldest report is
+   dropped. The first report of a batch arms a timer for BATCH_TIMEOUT, so
+   that the batch is delivered in time even if no further fix arrives.
+
+DEPENDENCIES
+   Called from loc_event_cb, or from loc_eng_report_position while the
+   session is duty cycled
+
+RETURN VALUE
+   TRUE if the batch is full or its oldest fix is older than BATCH_TIMEOUT
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_batch_add(const rpc_loc_parsed_position_s_type *report)
+{
+   loc_eng_batch_data_s_type *batch = &loc_eng_batch_data;
+   long long now_msec = loc_eng_timer_now_msec();
+   boolean flush_due;
+
+   pthread_mutex_lock(&batch->lock);
+   if (batch->count == 0)
+   {
+      batch->first_fix_msec = now_msec;
+      if (batch->batch_timeout_msec != 0 && batch->timer_id == LOC_ENG_TIMER_INVALID)
+      {
+         batch->timer_id = loc_eng_timer_start((uint32) batch->batch_timeout_msec,
+                                               loc_eng_batch_timeout, NULL);
+      }
+   }
+
+   if (batch->count < LOC_ENG_BATCH_MAX)
+   {
+      memcpy(&batch->reports[(batch->head + batch->count) % LOC_ENG_BATCH_MAX],
+             report, sizeof *report);
+      batch->count++;
+   }
+   else
+   {
+      memcpy(&batch->reports[batch->head], report, sizeof *report);
+      batch->head = (batch->head + 1) % LOC_ENG_BATCH_MAX;
+   }
+
+   flush_due = batch->count >= batch->batch_size ||
+         (batch->batch_timeout_msec != 0 &&
+          now_msec - batch->first_fix_msec >= batch->batch_timeout_msec);
+   pthread_mutex_unlock(&batch->lock);
+
+   return flush_due;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batch_request_flush
+
+DESCRIPTION
+   Wakes up the deferred action thread to deliver the buffered fixes. This
+   is what takes the wake lock while batching, it is released once the
+   thread is idle again.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_batch_request_flush()
+{
+   loc_eng_cmd_post(LOC_ENG_CMD_BATCH_FLUSH);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batch_flush
+
+DESCRIPTION
+   Hands all buffered position reports, oldest first, to report_cb, which
+   converts and delivers them.
+
+DEPENDENCIES
+   Must be called from the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_batch_flush(loc_eng_batch_report_cb report_cb)
+{
+   loc_eng_batch_data_s_type *batch = &loc_eng_batch_data;
+   int count, i;
+
+   // Copy out so that fixes arriving meanwhile are not held up by the callbacks
+   pthread_mutex_lock(&batch->lock);
+   count = batch->count;
+   for (i = 0; i < count; i++)
+   {
+      memcpy(&batch->flushing[i], &batch->reports[(batch->head + i) % LOC_ENG_BATCH_MAX],
+             sizeof batch->flushing[i]);
+   }
+   batch->head = 0;
+   batch->count = 0;
+   loc_eng_timer_stop(batch->timer_id);
+   batch->timer_id = LOC_ENG_TIMER_INVALID;
+   pthread_mutex_unlock(&batch->lock);
+
+   LOC_LOGD("loc_eng_batch_flush: %d fixes\n", count);
+
+   for (i = 0; i < count; i++)
+   {
+      report_cb(&batch->flushing[i]);
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batch_timeout
+
+DESCRIPTION
+   Timer callback, the oldest buffered fix has waited BATCH_TIMEOUT.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_batch_timeout(void *user_data)
+{
+   pthread_mutex_lock(&loc_eng_batch_data.lock);
+   loc_eng_batch_data.timer_id = LOC_ENG_TIMER_INVALID;
+   pthread_mutex_unlock(&loc_eng_batch_data.lock);
+
+   loc_eng_batch_request_flush();
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batch_flush_proxy
+
+DESCRIPTION
+   LocBatchInterface flush, hands the flush to the deferred action thread
+   so that location_cb is always called from there.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0 on success, -1 if the GPS is not initialized
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_batch_flush_proxy()
+{
+   if (loc_eng_data.acquire_wakelock_cb == NULL)
+   {
+      LOC_LOGE("loc_eng_batch_flush_proxy: GPS not initialized.\n");
+      return -1;
+   }
+
+   loc_eng_batch_request_flush();
+   return 0;
+}
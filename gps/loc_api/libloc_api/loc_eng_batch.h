@@ -0,0 +1,75 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_BATCH_H
+#define LOC_ENG_BATCH_H
+
+#include <hardware/gps.h>
+
+#define LOC_ENG_BATCH_MAX                64      /* fixes buffered at most */
+
+// Extension to flush batched fixes on demand, see loc_eng_get_extension
+#define LOC_BATCH_INTERFACE              "loc-batch"
+
+typedef struct
+{
+   size_t          size;
+   // Delivers all buffered fixes through location_cb right away
+   int             (*flush)(void);
+} LocBatchInterface;
+
+extern const LocBatchInterface sLocEngBatchInterface;
+
+// Module data
+typedef struct
+{
+   pthread_mutex_t                lock;
+   int                            batch_size;    /* 0 if batching is off */
+   long long                      batch_timeout_msec;
+
+   // Ring of buffered position reports, oldest at head
+   rpc_loc_parsed_position_s_type reports[LOC_ENG_BATCH_MAX];
+   int                            head;
+   int                            count;
+   long long                      first_fix_msec; /* monotonic time the oldest fix was buffered */
+   int                            timer_id;      /* BATCH_TIMEOUT of the oldest fix */
+
+   // Copy of the ring being delivered, owned by the deferred action thread
+   rpc_loc_parsed_position_s_type flushing[LOC_ENG_BATCH_MAX];
+} loc_eng_batch_data_s_type;
+
+typedef void (*loc_eng_batch_report_cb)(const rpc_loc_parsed_position_s_type *report);
+
+extern void    loc_eng_batch_init();
+extern boolean loc_eng_batch_enabled();
+extern boolean loc_eng_batch_add(const rpc_loc_parsed_position_s_type *report);
+extern void    loc_eng_batch_request_flush();
+extern void    loc_eng_batch_flush(loc_eng_batch_report_cb report_cb);
+
+#endif /* LOC_ENG_BATCH_H */
@@ -65,6 +65,24 @@ loc_param_s_type loc_parameter_table[] =
   /* DEBUG LEVELS: 0 - none, 1 - Error, 2 - Warning, 3 - Info
                    4 - Debug, 5 - Verbose  */
   {"DEBUG_LEVEL",                 &gps_conf.DEBUG_LEVEL,          'n'},
+  /* File backing the binary trace ring, NULL keeps it in memory only */
+  {"TRACE_FILE",                  &gps_conf.TRACE_FILE,           's'},
+  /* Batched delivery: fixes per batch (0 - off) and max age in seconds */
+  {"BATCH_SIZE",                  &gps_conf.BATCH_SIZE,           'n'},
+  {"BATCH_TIMEOUT",               &gps_conf.BATCH_TIMEOUT,        'n'},
+  /* Seconds a resolved AGPS server address is used before a refresh */
+  {"AGPS_DNS_TTL",                &gps_conf.AGPS_DNS_TTL,         'n'},
+  /* Position smoothing: on/off, expected acceleration in m/s^2 and
+     outlier threshold in standard deviations (0 - no rejection) */
+  {"SMOOTHING",                   &gps_conf.SMOOTHING,            'n'},
+  {"SMOOTH_ACCEL",                &gps_conf.SMOOTH_ACCEL,         'n'},
+  {"OUTLIER_SIGMA",               &gps_conf.OUTLIER_SIGMA,        'n'},
+  {"INTERPOLATION_RATE",          &gps_conf.INTERPOLATION_RATE,   'n'},
+  {"SV_SNR_THRES",                &gps_conf.SV_SNR_THRES,         'n'},
+  {"SV_ELEV_THRES",               &gps_conf.SV_ELEV_THRES,        'n'},
+  {"SV_AZIM_THRES",               &gps_conf.SV_AZIM_THRES,        'n'},
+  {"NMEA_MASK",                   &gps_conf.NMEA_MASK,            'n'},
+  {"DUTY_CYCLE_INTERVAL",         &gps_conf.DUTY_CYCLE_INTERVAL,  'n'},
 };
 
 int loc_param_num = sizeof(loc_parameter_table) / sizeof(loc_param_s_type);
@@ -92,6 +110,19 @@ static void loc_default_parameters()
    gps_conf.ACCURACY_THRES = 0;
    gps_conf.ENABLE_WIPER = 0;
    gps_conf.DEBUG_LEVEL = 2; /* debug level */
+   strlcpy(gps_conf.TRACE_FILE, LOC_TRACE_FILE_DEFAULT, sizeof gps_conf.TRACE_FILE);
+   gps_conf.BATCH_SIZE = 0;
+   gps_conf.BATCH_TIMEOUT = 0;
+   gps_conf.AGPS_DNS_TTL = 600;
+   gps_conf.SMOOTHING = 0;
+   gps_conf.SMOOTH_ACCEL = 3;
+   gps_conf.OUTLIER_SIGMA = 5;
+   gps_conf.INTERPOLATION_RATE = 0;
+   gps_conf.SV_SNR_THRES = 2;
+   gps_conf.SV_ELEV_THRES = 1;
+   gps_conf.SV_AZIM_THRES = 2;
+   gps_conf.NMEA_MASK = 0xffff;
+   gps_conf.DUTY_CYCLE_INTERVAL = 0;
 }
 
 /*===========================================================================
@@ -35,6 +35,7 @@
 #define LOC_MAX_PARAM_LINE                 80
 
 #define GPS_CONF_FILE            "/etc/gps.conf"            /* primary */
+#define LOC_TRACE_FILE_DEFAULT   "/data/misc/gps/loc_trace.bin"
 
 /*=============================================================================
  *
@@ -55,6 +56,19 @@ typedef struct loc_gps_cfg_s
   unsigned long  ACCURACY_THRES;
   unsigned long  ENABLE_WIPER;
   unsigned long  DEBUG_LEVEL;
+  char           TRACE_FILE[LOC_MAX_PARAM_STRING + 1];
+  unsigned long  BATCH_SIZE;
+  unsigned long  BATCH_TIMEOUT;
+  unsigned long  AGPS_DNS_TTL;
+  unsigned long  SMOOTHING;
+  unsigned long  SMOOTH_ACCEL;
+  unsigned long  OUTLIER_SIGMA;
+  unsigned long  INTERPOLATION_RATE;
+  unsigned long  SV_SNR_THRES;
+  unsigned long  SV_ELEV_THRES;
+  unsigned long  SV_AZIM_THRES;
+  unsigned long  NMEA_MASK;
+  unsigned long  DUTY_CYCLE_INTERVAL;
   // char           string_val[LOC_MAX_PARAM_STRING + 1]; /* An example string value */
 } loc_gps_cfg_s_type;
 
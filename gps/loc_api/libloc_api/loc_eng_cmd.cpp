@@ -0,0 +1,719 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <hardware/gps.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+static const char* loc_eng_cmd_names[LOC_ENG_CMD_MAX] =
+{
+   "EVENT",
+   "DELETE_AIDING",
+   "AGPS_STATUS",
+   "DATA_OPEN",
+   "DATA_CLOSED",
+   "DATA_FAILED",
+   "XTRA_INJECT",
+   "IOCTL_DONE",
+   "BATCH_FLUSH",
+   "SCHED_ALARM",
+   "INTERP_STOP",
+};
+
+static loc_eng_cmd_data_s_type loc_eng_cmd_data;
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_release
+
+DESCRIPTION
+   Gives a command back to the pool, or frees it if it was allocated
+   because the pool was used up.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_cmd_release(loc_eng_cmd_s_type *cmd)
+{
+   loc_eng_cmd_data_s_type *data = &loc_eng_cmd_data;
+
+   if (cmd >= data->pool && cmd < data->pool + LOC_ENG_CMD_POOL_SIZE)
+   {
+      cmd->next = data->free;
+      data->free = cmd;
+   }
+   else
+   {
+      free(cmd);
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_init
+
+DESCRIPTION
+   Empties the command queue. Called from loc_eng_init before the deferred
+   action thread is created.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   Frees the commands left beyond the pool by a previous session
+
+===========================================================================*/
+void loc_eng_cmd_init()
+{
+   loc_eng_cmd_s_type *cmd, *next;
+   int i;
+
+   for (cmd = loc_eng_cmd_data.head; cmd != NULL; cmd = next)
+   {
+      next = cmd->next;
+      loc_eng_cmd_release(cmd);
+   }
+
+   memset(&loc_eng_cmd_data, 0, sizeof loc_eng_cmd_data);
+   for (i = LOC_ENG_CMD_POOL_SIZE - 1; i >= 0; i--)
+   {
+      loc_eng_cmd_data.pool[i].next = loc_eng_cmd_data.free;
+      loc_eng_cmd_data.free = &loc_eng_cmd_data.pool[i];
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_unlink
+
+DESCRIPTION
+   Takes a command out of the queue.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_cmd_unlink(loc_eng_cmd_s_type *cmd, loc_eng_cmd_s_type *prev)
+{
+   loc_eng_cmd_data_s_type *data = &loc_eng_cmd_data;
+
+   if (prev == NULL)
+   {
+      data->head = cmd->next;
+   }
+   else
+   {
+      prev->next = cmd->next;
+   }
+   if (data->tail == cmd)
+   {
+      data->tail = prev;
+   }
+   data->count--;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_find
+
+DESCRIPTION
+   Finds a queued command of a type, for an EVENT also of a loc event.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   The command, NULL if none is queued
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static loc_eng_cmd_s_type* loc_eng_cmd_find(loc_eng_cmd_e_type type,
+            rpc_loc_event_mask_type loc_event)
+{
+   loc_eng_cmd_s_type *cmd;
+
+   for (cmd = loc_eng_cmd_data.head; cmd != NULL; cmd = cmd->next)
+   {
+      if (cmd->type == type &&
+          (type != LOC_ENG_CMD_EVENT || cmd->u.event.loc_event == loc_event))
+      {
+         return cmd;
+      }
+   }
+
+   return NULL;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_replaceable
+
+DESCRIPTION
+   Tells whether a queued command only carries a report that a newer one
+   supersedes: a position, satellite or NMEA report.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   TRUE if the command may make room for another one
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static boolean loc_eng_cmd_replaceable(const loc_eng_cmd_s_type *cmd)
+{
+   if (cmd->type != LOC_ENG_CMD_EVENT)
+   {
+      return FALSE;
+   }
+
+   switch (cmd->u.event.loc_event)
+   {
+   case RPC_LOC_EVENT_PARSED_POSITION_REPORT:
+   case RPC_LOC_EVENT_SATELLITE_REPORT:
+   case RPC_LOC_EVENT_NMEA_1HZ_REPORT:
+   case RPC_LOC_EVENT_NMEA_POSITION_REPORT:
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_append
+
+DESCRIPTION
+   Queues a new command. If the pool is used up, the oldest queued
+   position, satellite or NMEA report makes room, those are superseded by
+   the reports that follow. Without one the command is allocated, so that
+   no other event, AGPS or data connection command is ever dropped.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   The command, NULL only if it could not be allocated
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static loc_eng_cmd_s_type* loc_eng_cmd_append(loc_eng_cmd_e_type type)
+{
+   loc_eng_cmd_data_s_type *data = &loc_eng_cmd_data;
+   loc_eng_cmd_s_type *cmd, *prev;
+
+   if (data->free == NULL)
+   {
+      for (prev = NULL, cmd = data->head; cmd != NULL; prev = cmd, cmd = cmd->next)
+      {
+         if (loc_eng_cmd_replaceable(cmd))
+         {
+            break;
+         }
+      }
+      if (cmd != NULL)
+      {
+         LOC_LOGW("loc_eng_cmd_append: queue full, event 0x%x replaced\n",
+               (uint32) cmd->u.event.loc_event);
+         data->stats[LOC_ENG_CMD_EVENT].dropped++;
+         loc_eng_cmd_unlink(cmd, prev);
+      }
+      else
+      {
+         cmd = (loc_eng_cmd_s_type *) malloc(sizeof *cmd);
+         if (cmd == NULL)
+         {
+            LOC_LOGE("loc_eng_cmd_append: out of memory, %s dropped\n", loc_eng_cmd_names[type]);
+            data->stats[type].dropped++;
+            return NULL;
+         }
+         LOC_LOGW("loc_eng_cmd_append: queue full, %u commands queued\n", data->count + 1);
+         data->stats[type].allocated++;
+      }
+   }
+   else
+   {
+      cmd = data->free;
+      data->free = cmd->next;
+   }
+
+   cmd->type = type;
+   cmd->post_msec = loc_eng_timer_now_msec();
+   cmd->next = NULL;
+   if (data->tail != NULL)
+   {
+      data->tail->next = cmd;
+   }
+   else
+   {
+      data->head = cmd;
+   }
+   data->tail = cmd;
+   data->count++;
+
+   return cmd;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_signal
+
+DESCRIPTION
+   Wakes up the deferred action thread.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_cmd_signal()
+{
+   /* hold a wake lock while events are pending for deferred_action_thread */
+   loc_eng_data.acquire_wakelock_cb();
+   pthread_cond_signal(&loc_eng_data.deferred_action_cond);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_post
+
+DESCRIPTION
+   Posts a command without payload. DATA_OPEN, DATA_CLOSED and DATA_FAILED
+   are queued in order, each time. XTRA_INJECT, IOCTL_DONE, BATCH_FLUSH,
+   SCHED_ALARM and INTERP_STOP only ask for work that is picked up from
+   their modules, so one queued command of each type is enough and repeats
+   are coalesced.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cmd_post(loc_eng_cmd_e_type type)
+{
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+
+   loc_eng_cmd_data.stats[type].posted++;
+   if ((type == LOC_ENG_CMD_XTRA_INJECT || type == LOC_ENG_CMD_IOCTL_DONE ||
+        type == LOC_ENG_CMD_BATCH_FLUSH || type == LOC_ENG_CMD_SCHED_ALARM ||
+        type == LOC_ENG_CMD_INTERP_STOP) &&
+       loc_eng_cmd_find(type, 0) != NULL)
+   {
+      loc_eng_cmd_data.stats[type].coalesced++;
+   }
+   else
+   {
+      loc_eng_cmd_append(type);
+   }
+   loc_eng_cmd_signal();
+
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_put_event
+
+DESCRIPTION
+   Queues a loc API event with a copy of its payload. A satellite report
+   replaces one still queued, since only the latest matters; all other
+   events are queued in order.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_cmd_put_event(rpc_loc_event_mask_type loc_event,
+            const rpc_loc_event_payload_u_type *payload)
+{
+   loc_eng_cmd_s_type *cmd = NULL;
+
+   loc_eng_cmd_data.stats[LOC_ENG_CMD_EVENT].posted++;
+   if (loc_event == RPC_LOC_EVENT_SATELLITE_REPORT)
+   {
+      cmd = loc_eng_cmd_find(LOC_ENG_CMD_EVENT, loc_event);
+      if (cmd != NULL)
+      {
+         loc_eng_cmd_data.stats[LOC_ENG_CMD_EVENT].coalesced++;
+      }
+   }
+   if (cmd == NULL)
+   {
+      cmd = loc_eng_cmd_append(LOC_ENG_CMD_EVENT);
+   }
+   if (cmd != NULL)
+   {
+      cmd->u.event.loc_event = loc_event;
+      memcpy(&cmd->u.event.payload, payload, sizeof(*payload));
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_post_event
+
+DESCRIPTION
+   Posts a loc API event with a copy of its payload, see
+   loc_eng_cmd_put_event.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cmd_post_event(rpc_loc_event_mask_type loc_event,
+            const rpc_loc_event_payload_u_type *payload)
+{
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   loc_eng_cmd_put_event(loc_event, payload);
+   loc_eng_cmd_signal();
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_queue_event
+
+DESCRIPTION
+   Queues a loc API event like loc_eng_cmd_post_event, but neither takes
+   the wake lock nor wakes up the deferred action thread. The event is
+   processed the next time the thread runs for something else.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cmd_queue_event(rpc_loc_event_mask_type loc_event,
+            const rpc_loc_event_payload_u_type *payload)
+{
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   loc_eng_cmd_put_event(loc_event, payload);
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_post_delete_aiding
+
+DESCRIPTION
+   Posts aiding data to delete, merged with a request still queued.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cmd_post_delete_aiding(GpsAidingData aiding_data)
+{
+   loc_eng_cmd_s_type *cmd;
+
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+
+   loc_eng_cmd_data.stats[LOC_ENG_CMD_DELETE_AIDING].posted++;
+   cmd = loc_eng_cmd_find(LOC_ENG_CMD_DELETE_AIDING, 0);
+   if (cmd != NULL)
+   {
+      loc_eng_cmd_data.stats[LOC_ENG_CMD_DELETE_AIDING].coalesced++;
+      cmd->u.aiding_data |= aiding_data;
+   }
+   else if ((cmd = loc_eng_cmd_append(LOC_ENG_CMD_DELETE_AIDING)) != NULL)
+   {
+      cmd->u.aiding_data = aiding_data;
+   }
+   loc_eng_cmd_signal();
+
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_post_agps_status
+
+DESCRIPTION
+   Posts an ATL request of the modem. Requests are never coalesced, each
+   one is handled in order with its own connection handle.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cmd_post_agps_status(AGpsStatusValue status,
+            rpc_loc_server_connection_handle conn_handle)
+{
+   loc_eng_cmd_s_type *cmd;
+
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+
+   loc_eng_cmd_data.stats[LOC_ENG_CMD_AGPS_STATUS].posted++;
+   cmd = loc_eng_cmd_append(LOC_ENG_CMD_AGPS_STATUS);
+   if (cmd != NULL)
+   {
+      cmd->u.agps.status = status;
+      cmd->u.agps.conn_handle = conn_handle;
+   }
+   loc_eng_cmd_signal();
+
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_post_quit
+
+DESCRIPTION
+   Asks the deferred action thread to exit. Quitting goes ahead of the
+   queued commands, which are discarded.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cmd_post_quit()
+{
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   loc_eng_cmd_data.quit = TRUE;
+   loc_eng_cmd_signal();
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_ready
+
+DESCRIPTION
+   Tells whether the deferred action thread has something to do.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   TRUE if a command is queued or the thread has to quit
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_cmd_ready()
+{
+   return loc_eng_cmd_data.count > 0 || loc_eng_cmd_data.quit;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_quitting
+
+DESCRIPTION
+   Tells whether the deferred action thread was asked to exit.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   TRUE after loc_eng_cmd_post_quit
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_cmd_quitting()
+{
+   return loc_eng_cmd_data.quit;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_take
+
+DESCRIPTION
+   Takes the oldest command off the queue and accounts for its latency,
+   the time since it was posted. The command stays valid until it is given
+   back with loc_eng_cmd_done.
+
+DEPENDENCIES
+   deferred_action_mutex held
+
+RETURN VALUE
+   The command, NULL if the queue is empty or the thread has to quit
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+loc_eng_cmd_s_type* loc_eng_cmd_take(int *pending, uint32 *latency_msec)
+{
+   loc_eng_cmd_data_s_type *data = &loc_eng_cmd_data;
+   loc_eng_cmd_stats_s_type *stats;
+   loc_eng_cmd_s_type *cmd;
+   uint32 latency;
+
+   *pending = data->count;
+   if (data->quit || data->head == NULL)
+   {
+      return NULL;
+   }
+
+   cmd = data->head;
+   loc_eng_cmd_unlink(cmd, NULL);
+
+   latency = (uint32) (loc_eng_timer_now_msec() - cmd->post_msec);
+   stats = &data->stats[cmd->type];
+   stats->processed++;
+   stats->latency_msec += latency;
+   if (latency > stats->max_latency_msec)
+   {
+      stats->max_latency_msec = latency;
+   }
+   *latency_msec = latency;
+
+   return cmd;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_done
+
+DESCRIPTION
+   Gives a processed command back to the pool, or frees it.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cmd_done(loc_eng_cmd_s_type *cmd)
+{
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   loc_eng_cmd_release(cmd);
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cmd_log_stats
+
+DESCRIPTION
+   Logs the counters and latencies of each command type.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cmd_log_stats()
+{
+   loc_eng_cmd_stats_s_type *stats;
+   int i;
+
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   for (i = 0; i < LOC_ENG_CMD_MAX; i++)
+   {
+      stats = &loc_eng_cmd_data.stats[i];
+      if (stats->posted == 0)
+      {
+         continue;
+      }
+      LOC_LOGI("loc_eng_cmd: %s posted %u, coalesced %u, dropped %u, allocated %u, "
+            "processed %u, latency avg %lld max %u msec\n", loc_eng_cmd_names[i],
+            stats->posted, stats->coalesced, stats->dropped, stats->allocated,
+            stats->processed,
+            stats->processed ? stats->latency_msec / stats->processed : 0,
+            stats->max_latency_msec);
+   }
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+}
@@ -0,0 +1,116 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_CMD_H
+#define LOC_ENG_CMD_H
+
+#include <hardware/gps.h>
+
+#define LOC_ENG_CMD_POOL_SIZE            16      /* commands queued without allocating */
+
+// Commands for the deferred action thread
+typedef enum
+{
+   LOC_ENG_CMD_EVENT = 0,                        /* loc API event and payload */
+   LOC_ENG_CMD_DELETE_AIDING,                    /* aiding data to delete */
+   LOC_ENG_CMD_AGPS_STATUS,                      /* ATL request of the modem */
+   LOC_ENG_CMD_DATA_OPEN,                        /* data connection results from the framework */
+   LOC_ENG_CMD_DATA_CLOSED,
+   LOC_ENG_CMD_DATA_FAILED,
+   LOC_ENG_CMD_XTRA_INJECT,                      /* XTRA data buffered for injection */
+   LOC_ENG_CMD_IOCTL_DONE,                       /* asynchronous IOCTL reported */
+   LOC_ENG_CMD_BATCH_FLUSH,                      /* batched fixes due */
+   LOC_ENG_CMD_SCHED_ALARM,                      /* duty cycling warm start due */
+   LOC_ENG_CMD_INTERP_STOP,                      /* session stopped, no more predictions */
+   LOC_ENG_CMD_MAX
+} loc_eng_cmd_e_type;
+
+typedef struct loc_eng_cmd_s
+{
+   loc_eng_cmd_e_type             type;
+   long long                      post_msec;     /* monotonic time it was posted */
+   struct loc_eng_cmd_s          *next;          /* queue or free list */
+   union
+   {
+      struct
+      {
+         rpc_loc_event_mask_type       loc_event;
+         rpc_loc_event_payload_u_type  payload;
+      } event;
+      GpsAidingData                    aiding_data;
+      struct
+      {
+         AGpsStatusValue               status;
+         rpc_loc_server_connection_handle conn_handle;
+      } agps;
+   } u;
+} loc_eng_cmd_s_type;
+
+// Per command type counters, for the statistics logged at cleanup
+typedef struct
+{
+   uint32                         posted;
+   uint32                         coalesced;     /* merged into a queued command */
+   uint32                         dropped;       /* replaced by a newer command or lost */
+   uint32                         allocated;     /* queued beyond the pool */
+   uint32                         processed;
+   long long                      latency_msec;  /* total from post to processing */
+   uint32                         max_latency_msec;
+} loc_eng_cmd_stats_s_type;
+
+// Module data, protected by loc_eng_data.deferred_action_mutex
+typedef struct
+{
+   loc_eng_cmd_s_type             pool[LOC_ENG_CMD_POOL_SIZE];
+   loc_eng_cmd_s_type            *head;          /* oldest command */
+   loc_eng_cmd_s_type            *tail;
+   loc_eng_cmd_s_type            *free;          /* unused pool commands */
+   int                            count;
+   boolean                        quit;
+   loc_eng_cmd_stats_s_type       stats[LOC_ENG_CMD_MAX];
+} loc_eng_cmd_data_s_type;
+
+extern void loc_eng_cmd_init();
+extern void loc_eng_cmd_post(loc_eng_cmd_e_type type);
+extern void loc_eng_cmd_post_event(rpc_loc_event_mask_type loc_event,
+            const rpc_loc_event_payload_u_type *payload);
+extern void loc_eng_cmd_queue_event(rpc_loc_event_mask_type loc_event,
+            const rpc_loc_event_payload_u_type *payload);
+extern void loc_eng_cmd_post_delete_aiding(GpsAidingData aiding_data);
+extern void loc_eng_cmd_post_agps_status(AGpsStatusValue status,
+            rpc_loc_server_connection_handle conn_handle);
+extern void loc_eng_cmd_post_quit();
+
+extern boolean             loc_eng_cmd_ready();
+extern boolean             loc_eng_cmd_quitting();
+extern loc_eng_cmd_s_type* loc_eng_cmd_take(int *pending, uint32 *latency_msec);
+extern void                loc_eng_cmd_done(loc_eng_cmd_s_type *cmd);
+extern void                loc_eng_cmd_log_stats();
+
+#endif /* LOC_ENG_CMD_H */
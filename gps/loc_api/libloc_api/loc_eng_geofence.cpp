@@ -0,0 +1,794 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include <hardware/gps.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+#define METERS_PER_DEG_LAT    111320.0
+
+static void loc_eng_geofence_init(LocGeofenceCallbacks *callbacks);
+static int  loc_eng_geofence_add(int32_t geofence_id, double latitude, double longitude,
+            float radius, int monitor, uint32_t dwell_msec);
+static int  loc_eng_geofence_remove(int32_t geofence_id);
+static int  loc_eng_geofence_pause(int32_t geofence_id);
+static int  loc_eng_geofence_resume(int32_t geofence_id);
+
+const LocGeofenceInterface sLocEngGeofenceInterface =
+{
+   sizeof(LocGeofenceInterface),
+   loc_eng_geofence_init,
+   loc_eng_geofence_add,
+   loc_eng_geofence_remove,
+   loc_eng_geofence_pause,
+   loc_eng_geofence_resume,
+};
+
+/* Changed by extension users, evaluated by the deferred action thread,
+ * protected by the lock */
+static loc_eng_geofence_data_s_type loc_eng_geofence_data =
+{
+   PTHREAD_MUTEX_INITIALIZER,
+};
+
+// A transition found by loc_eng_geofence_evaluate, reported after unlocking
+typedef struct
+{
+   int32_t                        id;
+   int                            transition;
+} loc_eng_geofence_event_s_type;
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_init
+
+DESCRIPTION
+   Registers the callbacks of the geofence extension.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_geofence_init(LocGeofenceCallbacks *callbacks)
+{
+   pthread_mutex_lock(&loc_eng_geofence_data.lock);
+   loc_eng_geofence_data.transition_cb = (callbacks != NULL) ? callbacks->transition_cb : NULL;
+   pthread_mutex_unlock(&loc_eng_geofence_data.lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_id_bucket
+
+DESCRIPTION
+   Hashes a fence id.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Bucket index
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_geofence_id_bucket(int32_t geofence_id)
+{
+   return (int) (((uint32_t) geofence_id * 2654435761u) >> 20) &
+          (LOC_ENG_GEOFENCE_ID_BUCKETS - 1);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_find
+
+DESCRIPTION
+   Finds a fence by id through the id hash.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   Index of the fence, -1 if not found
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_geofence_find(int32_t geofence_id)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   int i;
+
+   for (i = data->id_buckets[loc_eng_geofence_id_bucket(geofence_id)]; i >= 0;
+        i = data->fences[i].id_next)
+   {
+      if (data->fences[i].id == geofence_id)
+      {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_bucket
+
+DESCRIPTION
+   Hashes a grid cell.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Bucket index
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_geofence_bucket(int32_t cell_lat, int32_t cell_lon)
+{
+   return (int) (((uint32_t) cell_lat * 73856093u) ^ ((uint32_t) cell_lon * 19349663u)) &
+          (LOC_ENG_GEOFENCE_BUCKETS - 1);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_cell_range
+
+DESCRIPTION
+   Finds the grid cells covered by the bounding box of a fence.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   FALSE if the fence covers more than LOC_ENG_GEOFENCE_MAX_CELLS cells or
+   crosses the 180th meridian, and belongs on the large list
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static boolean loc_eng_geofence_cell_range(const loc_eng_geofence_s_type *fence,
+            int32_t *lat_min, int32_t *lat_max, int32_t *lon_min, int32_t *lon_max)
+{
+   double cos_lat = cos(fence->latitude * M_PI / 180.0);
+   double dlat = fence->radius / METERS_PER_DEG_LAT;
+   double dlon;
+
+   if (cos_lat < 0.01 || dlat > LOC_ENG_GEOFENCE_MAX_CELLS * LOC_ENG_GEOFENCE_CELL_DEG)
+   {
+      return FALSE; /* near a pole, or too large anyway */
+   }
+   dlon = dlat / cos_lat;
+   if (fence->longitude - dlon < -180.0 || fence->longitude + dlon >= 180.0)
+   {
+      return FALSE;
+   }
+
+   *lat_min = (int32_t) floor((fence->latitude - dlat) / LOC_ENG_GEOFENCE_CELL_DEG);
+   *lat_max = (int32_t) floor((fence->latitude + dlat) / LOC_ENG_GEOFENCE_CELL_DEG);
+   *lon_min = (int32_t) floor((fence->longitude - dlon) / LOC_ENG_GEOFENCE_CELL_DEG);
+   *lon_max = (int32_t) floor((fence->longitude + dlon) / LOC_ENG_GEOFENCE_CELL_DEG);
+
+   return (*lat_max - *lat_min + 1) * (*lon_max - *lon_min + 1) <= LOC_ENG_GEOFENCE_MAX_CELLS;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_leave
+
+DESCRIPTION
+   Takes a fence off the list of fences the fixes are inside, if it is on
+   it, and sets its new state.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_geofence_leave(int index, loc_eng_geofence_state_e_type state)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   loc_eng_geofence_s_type *fence = &data->fences[index];
+
+   if (fence->state == LOC_ENG_GEOFENCE_INSIDE)
+   {
+      if (fence->inside_prev >= 0)
+      {
+         data->fences[fence->inside_prev].inside_next = fence->inside_next;
+      }
+      else
+      {
+         data->inside = fence->inside_next;
+      }
+      if (fence->inside_next >= 0)
+      {
+         data->fences[fence->inside_next].inside_prev = fence->inside_prev;
+      }
+   }
+   fence->state = state;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_index
+
+DESCRIPTION
+   Adds a fence to the grid, or to the large list.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   FALSE if out of memory
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static boolean loc_eng_geofence_index(int index)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   loc_eng_geofence_s_type *fence = &data->fences[index];
+   loc_eng_geofence_cell_s_type *cell;
+   int32_t lat_min, lat_max, lon_min, lon_max, lat, lon;
+   int     bucket, c, i;
+
+   fence->large = !loc_eng_geofence_cell_range(fence, &lat_min, &lat_max, &lon_min, &lon_max);
+   if (fence->large)
+   {
+      fence->next = data->large;
+      data->large = index;
+      return TRUE;
+   }
+
+   for (lat = lat_min; lat <= lat_max; lat++)
+   {
+      for (lon = lon_min; lon <= lon_max; lon++)
+      {
+         if (data->cell_free < 0)
+         {
+            int capacity = data->cell_capacity ? data->cell_capacity * 2 : 256;
+            cell = (loc_eng_geofence_cell_s_type *)
+               realloc(data->cells, capacity * sizeof(loc_eng_geofence_cell_s_type));
+            if (cell == NULL)
+            {
+               return FALSE;
+            }
+            for (i = capacity - 1; i >= data->cell_capacity; i--)
+            {
+               cell[i].next = data->cell_free;
+               data->cell_free = i;
+            }
+            data->cells = cell;
+            data->cell_capacity = capacity;
+         }
+
+         c = data->cell_free;
+         cell = &data->cells[c];
+         data->cell_free = cell->next;
+
+         bucket = loc_eng_geofence_bucket(lat, lon);
+         cell->cell_lat = lat;
+         cell->cell_lon = lon;
+         cell->fence = index;
+         cell->next = data->buckets[bucket];
+         data->buckets[bucket] = c;
+      }
+   }
+
+   return TRUE;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_unindex
+
+DESCRIPTION
+   Takes a fence off the grid or the large list, and off the inside list.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_geofence_unindex(int index)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   loc_eng_geofence_s_type *fence = &data->fences[index];
+   int32_t lat_min, lat_max, lon_min, lon_max, lat, lon;
+   int    *link;
+
+   if (fence->large)
+   {
+      for (link = &data->large; *link >= 0; link = &data->fences[*link].next)
+      {
+         if (*link == index)
+         {
+            *link = fence->next;
+            break;
+         }
+      }
+   }
+   else if (loc_eng_geofence_cell_range(fence, &lat_min, &lat_max, &lon_min, &lon_max))
+   {
+      for (lat = lat_min; lat <= lat_max; lat++)
+      {
+         for (lon = lon_min; lon <= lon_max; lon++)
+         {
+            link = &data->buckets[loc_eng_geofence_bucket(lat, lon)];
+            while (*link >= 0)
+            {
+               loc_eng_geofence_cell_s_type *cell = &data->cells[*link];
+               if (cell->fence == index && cell->cell_lat == lat && cell->cell_lon == lon)
+               {
+                  int c = *link;
+                  *link = cell->next;
+                  cell->next = data->cell_free;
+                  data->cell_free = c;
+                  break;
+               }
+               link = &cell->next;
+            }
+         }
+      }
+   }
+
+   loc_eng_geofence_leave(index, LOC_ENG_GEOFENCE_UNKNOWN);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_add
+
+DESCRIPTION
+   Adds a circular fence. Its state is unknown until the next fix, which
+   reports ENTERED if the fix is inside.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+   -1: failure
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_geofence_add(int32_t geofence_id, double latitude, double longitude,
+            float radius, int monitor, uint32_t dwell_msec)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   loc_eng_geofence_s_type *fence;
+   int index, bucket, i, ret_val = -1;
+
+   if (latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0 ||
+       !(radius > 0))
+   {
+      LOC_LOGE("loc_eng_geofence_add: invalid fence %d\n", geofence_id);
+      return -1;
+   }
+
+   pthread_mutex_lock(&data->lock);
+
+   if (data->fences == NULL)
+   {
+      memset(data->buckets, 0xff, sizeof data->buckets);
+      memset(data->id_buckets, 0xff, sizeof data->id_buckets);
+      data->fence_free = data->cell_free = data->large = data->inside = -1;
+   }
+
+   if (loc_eng_geofence_find(geofence_id) >= 0 || data->num_fences >= LOC_ENG_GEOFENCE_MAX)
+   {
+      LOC_LOGE("loc_eng_geofence_add: cannot add fence %d\n", geofence_id);
+      goto done;
+   }
+
+   if (data->fence_free < 0)
+   {
+      int capacity = data->fence_capacity ? data->fence_capacity * 2 : 64;
+      fence = (loc_eng_geofence_s_type *)
+         realloc(data->fences, capacity * sizeof(loc_eng_geofence_s_type));
+      if (fence == NULL)
+      {
+         goto done;
+      }
+      for (i = capacity - 1; i >= data->fence_capacity; i--)
+      {
+         fence[i].in_use = FALSE;
+         fence[i].next = data->fence_free;
+         data->fence_free = i;
+      }
+      data->fences = fence;
+      data->fence_capacity = capacity;
+   }
+
+   index = data->fence_free;
+   fence = &data->fences[index];
+   data->fence_free = fence->next;
+
+   memset(fence, 0, sizeof *fence);
+   fence->id = geofence_id;
+   fence->in_use = TRUE;
+   fence->latitude = latitude;
+   fence->longitude = longitude;
+   fence->radius = radius;
+   fence->monitor = monitor;
+   fence->dwell_msec = dwell_msec;
+   fence->state = LOC_ENG_GEOFENCE_UNKNOWN;
+
+   if (!loc_eng_geofence_index(index))
+   {
+      loc_eng_geofence_unindex(index);
+      fence->in_use = FALSE;
+      fence->next = data->fence_free;
+      data->fence_free = index;
+      goto done;
+   }
+
+   bucket = loc_eng_geofence_id_bucket(geofence_id);
+   fence->id_next = data->id_buckets[bucket];
+   data->id_buckets[bucket] = index;
+   data->num_fences++;
+   ret_val = 0;
+
+done:
+   pthread_mutex_unlock(&data->lock);
+   return ret_val;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_remove
+
+DESCRIPTION
+   Removes a fence without reporting a transition.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+   -1: unknown fence
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_geofence_remove(int32_t geofence_id)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   int index, *link;
+
+   pthread_mutex_lock(&data->lock);
+   index = (data->fences != NULL) ? loc_eng_geofence_find(geofence_id) : -1;
+   if (index >= 0)
+   {
+      for (link = &data->id_buckets[loc_eng_geofence_id_bucket(geofence_id)]; *link != index;
+           link = &data->fences[*link].id_next)
+      {
+      }
+      *link = data->fences[index].id_next;
+      loc_eng_geofence_unindex(index);
+      data->fences[index].in_use = FALSE;
+      data->fences[index].next = data->fence_free;
+      data->fence_free = index;
+      data->num_fences--;
+   }
+   pthread_mutex_unlock(&data->lock);
+
+   return (index >= 0) ? 0 : -1;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_pause
+
+DESCRIPTION
+   Stops evaluating a fence. Its state is forgotten, so after it is resumed
+   the next fix reports ENTERED if inside.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+   -1: unknown fence
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_geofence_pause(int32_t geofence_id)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   int index;
+
+   pthread_mutex_lock(&data->lock);
+   index = (data->fences != NULL) ? loc_eng_geofence_find(geofence_id) : -1;
+   if (index >= 0)
+   {
+      loc_eng_geofence_leave(index, LOC_ENG_GEOFENCE_UNKNOWN);
+      data->fences[index].paused = TRUE;
+   }
+   pthread_mutex_unlock(&data->lock);
+
+   return (index >= 0) ? 0 : -1;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_resume
+
+DESCRIPTION
+   Evaluates a paused fence again from the next fix.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+   -1: unknown fence
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_geofence_resume(int32_t geofence_id)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   int index;
+
+   pthread_mutex_lock(&data->lock);
+   index = (data->fences != NULL) ? loc_eng_geofence_find(geofence_id) : -1;
+   if (index >= 0)
+   {
+      data->fences[index].paused = FALSE;
+   }
+   pthread_mutex_unlock(&data->lock);
+
+   return (index >= 0) ? 0 : -1;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_check
+
+DESCRIPTION
+   Tests a fence against a fix and reports ENTERED when the fix moves
+   inside. Once inside, the fix has to be more than its accuracy outside
+   the radius to count as outside, so noise at the boundary does not
+   toggle the fence.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_geofence_check(int index, const GpsLocation *location, double cos_lat,
+            long long now_msec, loc_eng_geofence_event_s_type *events, int *num_events)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   loc_eng_geofence_s_type *fence = &data->fences[index];
+   double north, east, limit;
+
+   if (fence->paused || fence->eval_seq == data->eval_seq)
+   {
+      return;
+   }
+   fence->eval_seq = data->eval_seq;
+
+   north = (location->latitude - fence->latitude) * METERS_PER_DEG_LAT;
+   east = (location->longitude - fence->longitude) * METERS_PER_DEG_LAT * cos_lat;
+   limit = fence->radius;
+   if (fence->state == LOC_ENG_GEOFENCE_INSIDE && (location->flags & GPS_LOCATION_HAS_ACCURACY))
+   {
+      limit += location->accuracy;
+   }
+   fence->eval_inside = (north * north + east * east <= limit * limit);
+
+   if (!fence->eval_inside)
+   {
+      if (fence->state == LOC_ENG_GEOFENCE_UNKNOWN)
+      {
+         fence->state = LOC_ENG_GEOFENCE_OUTSIDE;
+      }
+      return; /* exits are found from the inside list */
+   }
+
+   if (fence->state == LOC_ENG_GEOFENCE_INSIDE ||
+       ((fence->monitor & LOC_GEOFENCE_ENTERED) && *num_events >= LOC_ENG_GEOFENCE_MAX_EVENTS))
+   {
+      return;
+   }
+
+   if (fence->monitor & LOC_GEOFENCE_ENTERED)
+   {
+      events[*num_events].id = fence->id;
+      events[*num_events].transition = LOC_GEOFENCE_ENTERED;
+      (*num_events)++;
+   }
+
+   fence->state = LOC_ENG_GEOFENCE_INSIDE;
+   fence->enter_msec = now_msec;
+   fence->dwell_reported = FALSE;
+   fence->inside_prev = -1;
+   fence->inside_next = data->inside;
+   if (data->inside >= 0)
+   {
+      data->fences[data->inside].inside_prev = index;
+   }
+   data->inside = index;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_evaluate
+
+DESCRIPTION
+   Tests the fences near a fix, found through the grid, and the fences the
+   last fixes were inside, and reports their ENTERED, EXITED and DWELL
+   transitions. Transitions beyond LOC_ENG_GEOFENCE_MAX_EVENTS are left for
+   the next fix.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_geofence_evaluate(const GpsLocation *location)
+{
+   loc_eng_geofence_data_s_type *data = &loc_eng_geofence_data;
+   loc_eng_geofence_event_s_type events[LOC_ENG_GEOFENCE_MAX_EVENTS];
+   loc_geofence_transition_callback transition_cb;
+   loc_eng_geofence_s_type *fence;
+   loc_eng_geofence_cell_s_type *cell;
+   int32_t    cell_lat, cell_lon;
+   int        num_events = 0;
+   int        i, next;
+   long long  now_msec;
+   double     cos_lat;
+
+   if (!(location->flags & GPS_LOCATION_HAS_LAT_LONG))
+   {
+      return;
+   }
+
+   pthread_mutex_lock(&data->lock);
+
+   transition_cb = data->transition_cb;
+   if (data->num_fences == 0 || transition_cb == NULL)
+   {
+      pthread_mutex_unlock(&data->lock);
+      return;
+   }
+
+   now_msec = loc_eng_timer_now_msec();
+   cos_lat = cos(location->latitude * M_PI / 180.0);
+   data->eval_seq++;
+
+   cell_lat = (int32_t) floor(location->latitude / LOC_ENG_GEOFENCE_CELL_DEG);
+   cell_lon = (int32_t) floor(location->longitude / LOC_ENG_GEOFENCE_CELL_DEG);
+   for (i = data->buckets[loc_eng_geofence_bucket(cell_lat, cell_lon)]; i >= 0; i = cell->next)
+   {
+      cell = &data->cells[i];
+      if (cell->cell_lat == cell_lat && cell->cell_lon == cell_lon)
+      {
+         loc_eng_geofence_check(cell->fence, location, cos_lat, now_msec, events, &num_events);
+      }
+   }
+
+   for (i = data->large; i >= 0; i = data->fences[i].next)
+   {
+      loc_eng_geofence_check(i, location, cos_lat, now_msec, events, &num_events);
+   }
+
+   // Fences tested outside have been left. The grid only finds fences by
+   // their radius, so the others still get the test with the accuracy added.
+   for (i = data->inside; i >= 0; i = next)
+   {
+      fence = &data->fences[i];
+      next = fence->inside_next;
+
+      // Paused fences are not on the list, loc_eng_geofence_pause takes them off
+      if (fence->eval_seq != data->eval_seq)
+      {
+         loc_eng_geofence_check(i, location, cos_lat, now_msec, events, &num_events);
+      }
+      if (fence->eval_inside)
+      {
+         if ((fence->monitor & LOC_GEOFENCE_DWELL) && !fence->dwell_reported &&
+             now_msec - fence->enter_msec >= fence->dwell_msec &&
+             num_events < LOC_ENG_GEOFENCE_MAX_EVENTS)
+         {
+            events[num_events].id = fence->id;
+            events[num_events].transition = LOC_GEOFENCE_DWELL;
+            num_events++;
+            fence->dwell_reported = TRUE;
+         }
+         continue;
+      }
+
+      if (fence->monitor & LOC_GEOFENCE_EXITED)
+      {
+         if (num_events >= LOC_ENG_GEOFENCE_MAX_EVENTS)
+         {
+            continue;
+         }
+         events[num_events].id = fence->id;
+         events[num_events].transition = LOC_GEOFENCE_EXITED;
+         num_events++;
+      }
+
+      loc_eng_geofence_leave(i, LOC_ENG_GEOFENCE_OUTSIDE);
+   }
+
+   pthread_mutex_unlock(&data->lock);
+
+   // Callbacks may change the fences
+   for (i = 0; i < num_events; i++)
+   {
+      LOC_LOGD("loc_eng_geofence_evaluate: fence %d transition %d\n",
+            events[i].id, events[i].transition);
+      transition_cb(events[i].id, location, events[i].transition);
+   }
+}
@@ -0,0 +1,141 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_GEOFENCE_H
+#define LOC_ENG_GEOFENCE_H
+
+#include <hardware/gps.h>
+
+#define LOC_ENG_GEOFENCE_MAX             16384   /* fences at most */
+#define LOC_ENG_GEOFENCE_CELL_DEG        0.01    /* grid cell size, about 1 km */
+#define LOC_ENG_GEOFENCE_BUCKETS         4096    /* grid hash buckets, power of 2 */
+#define LOC_ENG_GEOFENCE_ID_BUCKETS      4096    /* id hash buckets, power of 2 */
+#define LOC_ENG_GEOFENCE_MAX_CELLS       16      /* larger fences are always checked */
+#define LOC_ENG_GEOFENCE_MAX_EVENTS      32      /* transitions per fix, the rest wait */
+
+// Extension for circular geofences evaluated on every fix, see loc_eng_get_extension
+#define LOC_GEOFENCE_INTERFACE           "loc-geofence"
+
+// Transitions
+#define LOC_GEOFENCE_ENTERED             0x01
+#define LOC_GEOFENCE_EXITED              0x02
+#define LOC_GEOFENCE_DWELL               0x04
+
+// Called from the deferred action thread for each transition of a fence
+typedef void (* loc_geofence_transition_callback)(int32_t geofence_id,
+            const GpsLocation *location, int transition);
+
+typedef struct
+{
+   size_t                           size;
+   loc_geofence_transition_callback transition_cb;
+} LocGeofenceCallbacks;
+
+typedef struct
+{
+   size_t          size;
+   // Registers callbacks, NULL to remove them
+   void            (*init)(LocGeofenceCallbacks *callbacks);
+   // Adds a fence reporting the LOC_GEOFENCE_* transitions in monitor, DWELL
+   // after dwell_msec inside. Returns 0, or -1 if the id is in use, the
+   // parameters are invalid or there are too many fences
+   int             (*add)(int32_t geofence_id, double latitude, double longitude,
+                          float radius, int monitor, uint32_t dwell_msec);
+   // Each returns 0, or -1 if the id is unknown
+   int             (*remove)(int32_t geofence_id);
+   int             (*pause)(int32_t geofence_id);
+   int             (*resume)(int32_t geofence_id);
+} LocGeofenceInterface;
+
+extern const LocGeofenceInterface sLocEngGeofenceInterface;
+
+typedef enum
+{
+   LOC_ENG_GEOFENCE_UNKNOWN = 0,
+   LOC_ENG_GEOFENCE_INSIDE,
+   LOC_ENG_GEOFENCE_OUTSIDE
+} loc_eng_geofence_state_e_type;
+
+typedef struct
+{
+   int32_t                        id;
+   boolean                        in_use;
+   boolean                        paused;
+   boolean                        large;         /* on the large list, not in the grid */
+   double                         latitude;
+   double                         longitude;
+   float                          radius;
+   int                            monitor;
+   uint32_t                       dwell_msec;
+
+   loc_eng_geofence_state_e_type  state;
+   long long                      enter_msec;
+   boolean                        dwell_reported;
+   uint32_t                       eval_seq;      /* last evaluation that checked it */
+   boolean                        eval_inside;   /* its result */
+   int                            inside_prev;   /* list of fences INSIDE, -1 ends */
+   int                            inside_next;
+   int                            next;          /* large list or free list */
+   int                            id_next;       /* id hash chain, -1 ends */
+} loc_eng_geofence_s_type;
+
+// A fence in one grid cell, chained per hash bucket
+typedef struct
+{
+   int32_t                        cell_lat;
+   int32_t                        cell_lon;
+   int                            fence;
+   int                            next;
+} loc_eng_geofence_cell_s_type;
+
+// Module data
+typedef struct
+{
+   pthread_mutex_t                lock;
+   loc_geofence_transition_callback transition_cb;
+
+   loc_eng_geofence_s_type       *fences;        /* grows, indices are stable */
+   int                            fence_capacity;
+   int                            fence_free;
+   int                            num_fences;
+   int                            id_buckets[LOC_ENG_GEOFENCE_ID_BUCKETS];
+
+   loc_eng_geofence_cell_s_type  *cells;
+   int                            cell_capacity;
+   int                            cell_free;
+   int                            buckets[LOC_ENG_GEOFENCE_BUCKETS];
+
+   int                            large;         /* fences checked on every fix */
+   int                            inside;
+   uint32_t                       eval_seq;
+} loc_eng_geofence_data_s_type;
+
+extern void loc_eng_geofence_evaluate(const GpsLocation *location);
+
+#endif /* LOC_ENG_GEOFENCE_H */
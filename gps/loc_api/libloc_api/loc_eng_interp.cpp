@@ -0,0 +1,284 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <hardware/gps.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+#define METERS_PER_DEG_LAT    111320.0
+
+static loc_eng_interp_data_s_type loc_eng_interp_data;
+
+// Callback of the extension, kept across loc_eng_init
+static pthread_mutex_t              loc_eng_interp_cb_lock = PTHREAD_MUTEX_INITIALIZER;
+static loc_interp_location_callback loc_eng_interp_location_cb;
+
+static void loc_eng_interp_timeout(void *user_data);
+static void loc_eng_interp_register(LocInterpCallbacks *callbacks);
+
+const LocInterpInterface sLocEngInterpInterface =
+{
+   sizeof(LocInterpInterface),
+   loc_eng_interp_register,
+};
+
+/*===========================================================================
+FUNCTION    loc_eng_interp_register
+
+DESCRIPTION
+   Registers the callbacks of the interpolation extension.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_interp_register(LocInterpCallbacks *callbacks)
+{
+   pthread_mutex_lock(&loc_eng_interp_cb_lock);
+   loc_eng_interp_location_cb = (callbacks != NULL) ? callbacks->location_cb : NULL;
+   pthread_mutex_unlock(&loc_eng_interp_cb_lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_interp_client
+
+DESCRIPTION
+   Gets the callback predicted locations go to.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   The callback, NULL if no client registered one
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static loc_interp_location_callback loc_eng_interp_client()
+{
+   loc_interp_location_callback location_cb;
+
+   pthread_mutex_lock(&loc_eng_interp_cb_lock);
+   location_cb = loc_eng_interp_location_cb;
+   pthread_mutex_unlock(&loc_eng_interp_cb_lock);
+
+   return location_cb;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_interp_init
+
+DESCRIPTION
+   Applies INTERPOLATION_RATE from gps.conf. Interpolation is off when
+   fixes are batched. Called from loc_eng_init.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_interp_init()
+{
+   unsigned long rate = gps_conf.INTERPOLATION_RATE;
+
+   memset(&loc_eng_interp_data, 0, sizeof loc_eng_interp_data);
+   loc_eng_interp_data.timer_id = LOC_ENG_TIMER_INVALID;
+
+   if (rate > LOC_ENG_INTERP_MAX_RATE)
+   {
+      LOC_LOGW("loc_eng_interp_init: INTERPOLATION_RATE %lu limited to %d\n",
+            rate, LOC_ENG_INTERP_MAX_RATE);
+      rate = LOC_ENG_INTERP_MAX_RATE;
+   }
+
+   // The modem already delivers 1 Hz
+   if (rate > 1 && !loc_eng_batch_enabled())
+   {
+      loc_eng_interp_data.period_msec = 1000 / rate;
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_interp_fix
+
+DESCRIPTION
+   Takes a real fix as the new base for predictions, so the predicted
+   stream snaps to it, and restarts the prediction timer.
+
+DEPENDENCIES
+   Must be called from the deferred action thread, after the fix has been
+   reported
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_interp_fix(const GpsLocation *location,
+            const rpc_loc_parsed_position_s_type *location_report_ptr)
+{
+   loc_eng_interp_data_s_type *interp = &loc_eng_interp_data;
+
+   if (interp->period_msec == 0)
+   {
+      return;
+   }
+
+   loc_eng_timer_stop(interp->timer_id);
+   interp->timer_id = LOC_ENG_TIMER_INVALID;
+
+   // Predictions need a client, the horizontal speed and the bearing
+   interp->have_fix = loc_eng_interp_client() != NULL &&
+      (location->flags & GPS_LOCATION_HAS_LAT_LONG) &&
+      (location->flags & GPS_LOCATION_HAS_BEARING) &&
+      (location_report_ptr->valid_mask & RPC_LOC_POS_VALID_SPEED_HORIZONTAL);
+   if (!interp->have_fix)
+   {
+      return;
+   }
+
+   memcpy(&interp->fix, location, sizeof interp->fix);
+   interp->fix_msec = loc_eng_timer_now_msec();
+   interp->speed_horizontal = location_report_ptr->speed_horizontal;
+   interp->speed_vertical = (location_report_ptr->valid_mask & RPC_LOC_POS_VALID_SPEED_VERTICAL) ?
+      location_report_ptr->speed_vertical : 0.0;
+
+   interp->timer_id = loc_eng_timer_start(interp->period_msec, loc_eng_interp_timeout, NULL);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_interp_stop
+
+DESCRIPTION
+   Stops predicting until the next real fix. Called for
+   LOC_ENG_CMD_INTERP_STOP, posted when the session stops.
+
+DEPENDENCIES
+   Must be called from the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_interp_stop()
+{
+   loc_eng_interp_data_s_type *interp = &loc_eng_interp_data;
+
+   loc_eng_timer_stop(interp->timer_id);
+   interp->timer_id = LOC_ENG_TIMER_INVALID;
+   interp->have_fix = FALSE;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_interp_timeout
+
+DESCRIPTION
+   Timer callback, reports a location dead-reckoned from the last real fix
+   with its horizontal and vertical speed and bearing to the extension. The accuracy grows
+   with the distance an acceleration of SMOOTH_ACCEL could have added.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_interp_timeout(void *user_data)
+{
+   loc_eng_interp_data_s_type *interp = &loc_eng_interp_data;
+   loc_interp_location_callback location_cb = loc_eng_interp_client();
+   GpsLocation location;
+   long long   age_msec;
+   double      dt, distance, bearing_rad;
+
+   interp->timer_id = LOC_ENG_TIMER_INVALID;
+
+   age_msec = loc_eng_timer_now_msec() - interp->fix_msec;
+   if (!interp->have_fix || location_cb == NULL || !loc_eng_data.navigating ||
+       age_msec > LOC_ENG_INTERP_MAX_AGE_MSEC)
+   {
+      return; /* wait for the next real fix */
+   }
+
+   dt = age_msec / 1000.0;
+   distance = interp->speed_horizontal * dt;
+   bearing_rad = interp->fix.bearing * M_PI / 180.0;
+
+   memcpy(&location, &interp->fix, sizeof location);
+   location.timestamp += age_msec;
+   location.latitude  += distance * cos(bearing_rad) / METERS_PER_DEG_LAT;
+   location.longitude += distance * sin(bearing_rad) /
+         (METERS_PER_DEG_LAT * cos(interp->fix.latitude * M_PI / 180.0));
+   if (location.flags & GPS_LOCATION_HAS_ALTITUDE)
+   {
+      location.altitude += interp->speed_vertical * dt;
+   }
+   if (location.flags & GPS_LOCATION_HAS_ACCURACY)
+   {
+      location.accuracy += 0.5 * gps_conf.SMOOTH_ACCEL * dt * dt;
+   }
+
+   location_cb(&location);
+
+   interp->timer_id = loc_eng_timer_start(interp->period_msec, loc_eng_interp_timeout, NULL);
+}
@@ -0,0 +1,78 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_INTERP_H
+#define LOC_ENG_INTERP_H
+
+#include <hardware/gps.h>
+
+#define LOC_ENG_INTERP_MAX_RATE          10      /* Hz, limited by the timer tick */
+#define LOC_ENG_INTERP_MAX_AGE_MSEC      2000    /* no predictions this long after a fix */
+
+// Extension delivering the predicted locations, see loc_eng_get_extension.
+// The framework has no way to tell them from fixes, so it only gets the
+// real fixes and nothing is predicted while no callback is registered.
+#define LOC_INTERP_INTERFACE             "loc-interp"
+
+// Called from the deferred action thread for each predicted location
+typedef void (* loc_interp_location_callback)(const GpsLocation *location);
+
+typedef struct
+{
+   size_t                       size;
+   loc_interp_location_callback location_cb;
+} LocInterpCallbacks;
+
+typedef struct
+{
+   size_t          size;
+   // Registers callbacks, NULL to remove them
+   void            (*init)(LocInterpCallbacks *callbacks);
+} LocInterpInterface;
+
+extern const LocInterpInterface sLocEngInterpInterface;
+
+// Module data, owned by the deferred action thread
+typedef struct
+{
+   int                            timer_id;
+   uint32                         period_msec;   /* 0 if interpolation is off */
+   boolean                        have_fix;
+   GpsLocation                    fix;           /* last real fix as reported */
+   long long                      fix_msec;      /* monotonic time it was reported */
+   double                         speed_horizontal;
+   double                         speed_vertical;
+} loc_eng_interp_data_s_type;
+
+extern void loc_eng_interp_init();
+extern void loc_eng_interp_fix(const GpsLocation *location,
+            const rpc_loc_parsed_position_s_type *location_report_ptr);
+extern void loc_eng_interp_stop();
+
+#endif /* LOC_ENG_INTERP_H */
@@ -36,6 +36,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <pthread.h>
+#include <string.h>
 
 #include <rpc/rpc.h>
 #include <loc_api_rpc_glue.h>
@@ -53,13 +54,73 @@
 // #undef LOGD
 // #define LOGD(...) {}
 
+/* Asynchronous IOCTLs waiting for their report, protected by loc_eng_ioctl_async_lock */
+static pthread_mutex_t            loc_eng_ioctl_async_lock = PTHREAD_MUTEX_INITIALIZER;
+static loc_eng_ioctl_async_s_type loc_eng_ioctl_async_slots[LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE];
+/* Set once the deferred action thread has gone, no completion could be delivered */
+static boolean                    loc_eng_ioctl_async_closed = FALSE;
+static uint32                     loc_eng_ioctl_async_seq = 0;
+/* Types of the synchronous IOCTLs in progress, protected by loc_eng_ioctl_async_lock */
+static rpc_loc_ioctl_e_type       loc_eng_ioctl_sync_types[LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE];
+static int                        loc_eng_ioctl_sync_count = 0;
+/* Signalled when an IOCTL report arrives or an IOCTL is no longer in flight */
+static pthread_cond_t             loc_eng_ioctl_async_cond;
+static boolean                    loc_eng_ioctl_async_cond_init = FALSE;
+
+static void loc_eng_ioctl_async_send_next(rpc_loc_ioctl_e_type ioctl_type);
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_busy
+
+DESCRIPTION
+   Tells whether an IOCTL of the given type has been sent and waits for its
+   report. The modem reports do not carry a transaction ID, so only one
+   IOCTL of a type, synchronous or not, may wait for a report at a time.
+
+DEPENDENCIES
+   loc_eng_ioctl_async_lock held
+
+RETURN VALUE
+   TRUE                 if an IOCTL of the type waits for its report
+   FALSE                otherwise
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static boolean loc_eng_ioctl_busy(rpc_loc_ioctl_e_type ioctl_type)
+{
+   int i;
+
+   for (i = 0; i < LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE; i++)
+   {
+      const loc_eng_ioctl_async_s_type *slot = &loc_eng_ioctl_async_slots[i];
+      if (slot->in_use && !slot->queued && !slot->done && !slot->failed &&
+          slot->ioctl_type == ioctl_type)
+      {
+         return TRUE;
+      }
+   }
+   for (i = 0; i < loc_eng_ioctl_sync_count; i++)
+   {
+      if (loc_eng_ioctl_sync_types[i] == ioctl_type)
+      {
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
 /*===========================================================================
 
 FUNCTION    loc_eng_ioctl
 
 DESCRIPTION
    This function calls loc_ioctl and waits for the callback result before
-   returning back to the user.
+   returning back to the user. If an IOCTL of the same type is in flight,
+   it first waits for that one's report. Both waits together take at most
+   timeout_msec.
 
 DEPENDENCIES
    N/A
@@ -82,11 +143,56 @@ boolean loc_eng_ioctl
 )
 {
    int ret_val = RPC_LOC_API_SUCCESS;
+   long long start_msec = loc_eng_timer_now_msec();
+   long long expire_msec = start_msec + timeout_msec;
+   long long remaining_msec;
+   struct timespec expire_time;
+   int i;
 
    LOC_LOGD("loc_eng_ioctl called: client = %d, ioctl_type = %s\n", (int32) handle,
          loc_get_ioctl_type_name(ioctl_type));
 
-   ret_val = loc_api_sync_ioctl(handle, ioctl_type, ioctl_data_ptr, timeout_msec, cb_data_ptr);
+   // The report of an IOCTL of the same type in flight would be taken for ours
+   expire_time.tv_sec = expire_msec / 1000;
+   expire_time.tv_nsec = (expire_msec % 1000) * 1000000;
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   while (loc_eng_ioctl_busy(ioctl_type))
+   {
+      if (loc_eng_cond_timedwait_monotonic(&loc_eng_ioctl_async_cond, &loc_eng_ioctl_async_lock,
+                                           &expire_time) == ETIMEDOUT)
+      {
+         break;
+      }
+   }
+   // Whatever the wait used up is gone for the IOCTL itself
+   remaining_msec = expire_msec - loc_eng_timer_now_msec();
+   if (loc_eng_ioctl_busy(ioctl_type) || loc_eng_ioctl_sync_count == LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE ||
+       remaining_msec <= 0)
+   {
+      pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+      LOC_LOGE("loc_eng_ioctl: %s busy\n", loc_get_ioctl_type_name(ioctl_type));
+      return FALSE;
+   }
+   loc_eng_ioctl_sync_types[loc_eng_ioctl_sync_count++] = ioctl_type;
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+   ret_val = loc_api_sync_ioctl(handle, ioctl_type, ioctl_data_ptr, (uint32) remaining_msec,
+                                cb_data_ptr);
+   loc_eng_trace_ioctl(ioctl_type, ret_val,
+         (uint32) (loc_eng_timer_now_msec() - start_msec), FALSE);
+
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   for (i = 0; i < loc_eng_ioctl_sync_count; i++)
+   {
+      if (loc_eng_ioctl_sync_types[i] == ioctl_type)
+      {
+         loc_eng_ioctl_sync_types[i] = loc_eng_ioctl_sync_types[--loc_eng_ioctl_sync_count];
+         break;
+      }
+   }
+   pthread_cond_broadcast(&loc_eng_ioctl_async_cond);
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+   loc_eng_ioctl_async_send_next(ioctl_type);
 
    LOC_LOGD("loc_eng_ioctl result: client = %d, ioctl_type = %s, %s\n",
          (int32) handle,
@@ -95,3 +201,487 @@ boolean loc_eng_ioctl
 
    return ret_val == RPC_LOC_API_SUCCESS;
 }
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async_init
+
+DESCRIPTION
+   Clears the table of asynchronous IOCTLs. Called from loc_eng_init before
+   the deferred action thread is started.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_ioctl_async_init()
+{
+   if (!loc_eng_ioctl_async_cond_init)
+   {
+      loc_eng_cond_init_monotonic(&loc_eng_ioctl_async_cond);
+      loc_eng_ioctl_async_cond_init = TRUE;
+   }
+
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   memset(loc_eng_ioctl_async_slots, 0, sizeof loc_eng_ioctl_async_slots);
+   loc_eng_ioctl_async_closed = FALSE;
+   loc_eng_ioctl_sync_count = 0;
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+}
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async_timeout
+
+DESCRIPTION
+   Timer callback, marks an asynchronous IOCTL whose report did not arrive
+   in time. The completion is run by loc_eng_ioctl_async_process.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_ioctl_async_timeout(void *user_data)
+{
+   loc_eng_ioctl_async_s_type *slot = (loc_eng_ioctl_async_s_type *) user_data;
+
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   if (slot->in_use && !slot->done)
+   {
+      slot->timed_out = TRUE;
+   }
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+}
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async
+
+DESCRIPTION
+   Non-blocking variant of loc_eng_ioctl. The IOCTL is sent to the modem and
+   the call returns right away; done_cb is called on the deferred action
+   thread once the IOCTL report arrives or the loc_eng_timer armed for
+   timeout_msec fires.
+
+   The modem reports do not carry a transaction ID, so while an IOCTL of
+   the same type is in flight the request is queued and sent once that one
+   is done. A queued IOCTL that cannot be sent is completed with the
+   loc_ioctl error.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   RPC_LOC_API_SUCCESS  if the IOCTL was sent or queued; done_cb will be called
+   Loc API error code   otherwise; done_cb will not be called, the caller
+                        may try again later
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_ioctl_async
+(
+      rpc_loc_client_handle_type           handle,
+      rpc_loc_ioctl_e_type                 ioctl_type,
+      rpc_loc_ioctl_data_u_type*           ioctl_data_ptr,
+      uint32                               timeout_msec,
+      loc_eng_ioctl_done_cb                done_cb,
+      void                                *user_data
+)
+{
+   loc_eng_ioctl_async_s_type *slot = NULL;
+   boolean queue = FALSE;
+   int ret_val;
+   int i;
+
+   LOC_LOGD("loc_eng_ioctl_async called: client = %d, ioctl_type = %s\n", (int32) handle,
+         loc_get_ioctl_type_name(ioctl_type));
+
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   if (loc_eng_ioctl_async_closed)
+   {
+      pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+      LOC_LOGE("loc_eng_ioctl_async: deferred action thread is not running\n");
+      return RPC_LOC_API_INVALID_HANDLE;
+   }
+
+   // Stay behind the IOCTLs of the same type queued before
+   for (i = 0; i < LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE; i++)
+   {
+      if (loc_eng_ioctl_async_slots[i].in_use && loc_eng_ioctl_async_slots[i].queued &&
+          loc_eng_ioctl_async_slots[i].ioctl_type == ioctl_type)
+      {
+         queue = TRUE;
+      }
+      if (slot == NULL && !loc_eng_ioctl_async_slots[i].in_use)
+      {
+         slot = &loc_eng_ioctl_async_slots[i];
+      }
+   }
+
+   if (slot == NULL)
+   {
+      pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+      LOC_LOGE("loc_eng_ioctl_async: buffer full, ioctl_type = %s\n", loc_get_ioctl_type_name(ioctl_type));
+      return RPC_LOC_API_ENGINE_BUSY;
+   }
+
+   // Claim the slot before the call, the report may arrive before loc_ioctl returns
+   slot->in_use = TRUE;
+   slot->queued = queue || loc_eng_ioctl_busy(ioctl_type);
+   slot->done = FALSE;
+   slot->timed_out = FALSE;
+   slot->failed = FALSE;
+   slot->seq = loc_eng_ioctl_async_seq++;
+   slot->handle = handle;
+   slot->ioctl_type = ioctl_type;
+   slot->has_data = (ioctl_data_ptr != NULL);
+   if (slot->has_data)
+   {
+      memcpy(&slot->ioctl_data, ioctl_data_ptr, sizeof slot->ioctl_data);
+   }
+   slot->timeout_msec = timeout_msec;
+   slot->done_cb = done_cb;
+   slot->user_data = user_data;
+   slot->start_msec = loc_eng_timer_now_msec();
+   slot->timer_id = LOC_ENG_TIMER_INVALID;
+   if (slot->queued)
+   {
+      pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+      LOC_LOGD("loc_eng_ioctl_async: %s queued\n", loc_get_ioctl_type_name(ioctl_type));
+      return RPC_LOC_API_SUCCESS;
+   }
+   slot->timer_id = loc_eng_timer_start(timeout_msec, loc_eng_ioctl_async_timeout, slot);
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+   ret_val = loc_ioctl(handle, ioctl_type, ioctl_data_ptr);
+
+   if (ret_val != RPC_LOC_API_SUCCESS)
+   {
+      LOC_LOGE("loc_eng_ioctl_async: loc_ioctl returned %s\n", loc_get_ioctl_status_name(ret_val));
+      pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+      loc_eng_timer_stop(slot->timer_id);
+      slot->in_use = FALSE;
+      pthread_cond_broadcast(&loc_eng_ioctl_async_cond);
+      pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+      // Requests may have been queued behind this one meanwhile
+      loc_eng_ioctl_async_send_next(ioctl_type);
+   }
+
+   return ret_val;
+}
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async_send_next
+
+DESCRIPTION
+   Sends the oldest queued asynchronous IOCTL of the given type, unless an
+   IOCTL of that type still waits for its report. If loc_ioctl fails the
+   IOCTL is completed with its error on the deferred action thread.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_ioctl_async_send_next(rpc_loc_ioctl_e_type ioctl_type)
+{
+   loc_eng_ioctl_async_s_type *slot = NULL;
+   rpc_loc_ioctl_data_u_type   ioctl_data;
+   rpc_loc_client_handle_type  handle;
+   boolean                     has_data;
+   int ret_val;
+   int i;
+
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   if (!loc_eng_ioctl_async_closed && !loc_eng_ioctl_busy(ioctl_type))
+   {
+      for (i = 0; i < LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE; i++)
+      {
+         loc_eng_ioctl_async_s_type *next = &loc_eng_ioctl_async_slots[i];
+         if (next->in_use && next->queued && next->ioctl_type == ioctl_type &&
+             (slot == NULL || (int32) (next->seq - slot->seq) < 0))
+         {
+            slot = next;
+         }
+      }
+   }
+   if (slot == NULL)
+   {
+      pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+      return;
+   }
+
+   slot->queued = FALSE;
+   slot->start_msec = loc_eng_timer_now_msec();
+   slot->timer_id = loc_eng_timer_start(slot->timeout_msec, loc_eng_ioctl_async_timeout, slot);
+   handle = slot->handle;
+   has_data = slot->has_data;
+   memcpy(&ioctl_data, &slot->ioctl_data, sizeof ioctl_data);
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+   LOC_LOGD("loc_eng_ioctl_async: sending queued %s\n", loc_get_ioctl_type_name(ioctl_type));
+   ret_val = loc_ioctl(handle, ioctl_type, has_data ? &ioctl_data : NULL);
+
+   if (ret_val != RPC_LOC_API_SUCCESS)
+   {
+      LOC_LOGE("loc_eng_ioctl_async: loc_ioctl returned %s\n", loc_get_ioctl_status_name(ret_val));
+      pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+      loc_eng_timer_stop(slot->timer_id);
+      slot->failed = TRUE;
+      slot->send_status = ret_val;
+      pthread_cond_broadcast(&loc_eng_ioctl_async_cond);
+      pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+      loc_eng_cmd_post(LOC_ENG_CMD_IOCTL_DONE);
+   }
+}
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async_report
+
+DESCRIPTION
+   Matches an IOCTL report against the asynchronous IOCTLs in flight and
+   wakes up the deferred action thread to run the completion. Called from
+   the RPC callback thread.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   TRUE                 if the report completed an asynchronous IOCTL
+   FALSE                otherwise
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_ioctl_async_report
+(
+      rpc_loc_client_handle_type           handle,
+      const rpc_loc_ioctl_callback_s_type *ioctl_report_ptr
+)
+{
+   boolean matched = FALSE;
+   int i;
+
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   for (i = 0; i < LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE; i++)
+   {
+      loc_eng_ioctl_async_s_type *slot = &loc_eng_ioctl_async_slots[i];
+      if (slot->in_use && !slot->queued && !slot->done && !slot->failed &&
+          slot->handle == handle &&
+          slot->ioctl_type == ioctl_report_ptr->type)
+      {
+         memcpy(&slot->cb_data, ioctl_report_ptr, sizeof slot->cb_data);
+         slot->done = TRUE;
+         matched = TRUE;
+         pthread_cond_broadcast(&loc_eng_ioctl_async_cond);
+         break;
+      }
+   }
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+   if (matched)
+   {
+      loc_eng_cmd_post(LOC_ENG_CMD_IOCTL_DONE);
+   }
+
+   return matched;
+}
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async_complete
+
+DESCRIPTION
+   Runs the completion handlers of the asynchronous IOCTLs that have either
+   received their report, timed out or failed to be sent, and sends the
+   next queued IOCTL of their type. If expire_all is set, every IOCTL in
+   flight or queued is completed with RPC_LOC_API_GENERAL_FAILURE.
+
+DEPENDENCIES
+   Must be called from the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_ioctl_async_complete(boolean expire_all)
+{
+   int i;
+
+   for (i = 0; i < LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE; i++)
+   {
+      loc_eng_ioctl_async_s_type *slot = &loc_eng_ioctl_async_slots[i];
+      loc_eng_ioctl_async_s_type  completed;
+      int                         status;
+
+      pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+      if (!slot->in_use)
+      {
+         pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+         continue;
+      }
+
+      if (slot->done)
+      {
+         status = slot->cb_data.status;
+      }
+      else if (slot->failed)
+      {
+         status = slot->send_status;
+      }
+      else if (expire_all)
+      {
+         status = RPC_LOC_API_GENERAL_FAILURE;
+      }
+      else if (slot->timed_out)
+      {
+         status = RPC_LOC_API_TIMEOUT;
+      }
+      else
+      {
+         pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+         continue;
+      }
+
+      // Free the slot before calling out, the handler may submit a new IOCTL
+      memcpy(&completed, slot, sizeof completed);
+      loc_eng_timer_stop(slot->timer_id);
+      slot->in_use = FALSE;
+      pthread_cond_broadcast(&loc_eng_ioctl_async_cond);
+      pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+      loc_eng_trace_ioctl(completed.ioctl_type, status,
+            (uint32) (loc_eng_timer_now_msec() - completed.start_msec), TRUE);
+
+      LOC_LOGD("loc_eng_ioctl_async result: client = %d, ioctl_type = %s, %s\n",
+            (int32) completed.handle,
+            loc_get_ioctl_type_name(completed.ioctl_type),
+            loc_get_ioctl_status_name(status));
+
+      if (completed.done_cb != NULL)
+      {
+         completed.done_cb(completed.ioctl_type, status,
+               completed.done ? &completed.cb_data : NULL,
+               completed.user_data);
+      }
+
+      if (!expire_all)
+      {
+         loc_eng_ioctl_async_send_next(completed.ioctl_type);
+      }
+   }
+}
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async_in_flight
+
+DESCRIPTION
+   Counts the asynchronous IOCTLs waiting for their report or completion.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Number of slots in use
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_ioctl_async_in_flight()
+{
+   int count = 0;
+   int i;
+
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   for (i = 0; i < LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE; i++)
+   {
+      if (loc_eng_ioctl_async_slots[i].in_use)
+      {
+         count++;
+      }
+   }
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+   return count;
+}
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async_process
+
+DESCRIPTION
+   Delivers completed and timed out asynchronous IOCTLs. Called on every
+   pass of the deferred action thread, after loc_eng_timer_process.
+
+DEPENDENCIES
+   Must be called from the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_ioctl_async_process()
+{
+   loc_eng_ioctl_async_complete(FALSE);
+}
+
+/*===========================================================================
+
+FUNCTION    loc_eng_ioctl_async_cancel_all
+
+DESCRIPTION
+   Fails every asynchronous IOCTL still in flight, so completion handlers
+   get a chance to release their resources, and rejects new submissions
+   until loc_eng_ioctl_async_init. Called when the deferred action thread
+   exits.
+
+DEPENDENCIES
+   Must be called from the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_ioctl_async_cancel_all()
+{
+   pthread_mutex_lock(&loc_eng_ioctl_async_lock);
+   loc_eng_ioctl_async_closed = TRUE;
+   pthread_mutex_unlock(&loc_eng_ioctl_async_lock);
+
+   loc_eng_ioctl_async_complete(TRUE);
+}
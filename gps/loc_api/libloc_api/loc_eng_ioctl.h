@@ -39,4 +39,62 @@ extern boolean loc_eng_ioctl
       rpc_loc_ioctl_callback_s_type       *cb_data_ptr
 );
 
+// Maximum number of asynchronous IOCTLs in flight or queued at the same
+// time, and of synchronous IOCTLs in progress
+#define LOC_ENG_IOCTL_ASYNC_BUFFER_SIZE 8
+
+// Completion handler for loc_eng_ioctl_async, called on the deferred action
+// thread. status is the Loc API status of the IOCTL report, or
+// RPC_LOC_API_TIMEOUT. cb_data_ptr is NULL unless the report has arrived.
+typedef void (*loc_eng_ioctl_done_cb)
+(
+      rpc_loc_ioctl_e_type                 ioctl_type,
+      int                                  status,
+      const rpc_loc_ioctl_callback_s_type *cb_data_ptr,
+      void                                *user_data
+);
+
+typedef struct
+{
+   boolean                        in_use;
+   boolean                        queued;        /* not sent, an IOCTL of its type is in flight */
+   boolean                        done;          /* report arrived, completion pending */
+   boolean                        timed_out;     /* timer fired, completion pending */
+   boolean                        failed;        /* sending from the queue failed, completion pending */
+   int                            send_status;   /* Loc API status of the failed loc_ioctl */
+   uint32                         seq;           /* submission order, queued IOCTLs are sent in it */
+   rpc_loc_client_handle_type     handle;
+   rpc_loc_ioctl_e_type           ioctl_type;
+   boolean                        has_data;
+   rpc_loc_ioctl_data_u_type      ioctl_data;    /* kept until a queued IOCTL is sent */
+   uint32                         timeout_msec;
+   long long                      start_msec;    /* monotonic, for the latency trace */
+   int                            timer_id;      /* loc_eng_timer for the timeout */
+   loc_eng_ioctl_done_cb          done_cb;
+   void                          *user_data;
+   rpc_loc_ioctl_callback_s_type  cb_data;       /* received IOCTL report */
+} loc_eng_ioctl_async_s_type;
+
+extern void loc_eng_ioctl_async_init();
+
+extern int loc_eng_ioctl_async
+(
+      rpc_loc_client_handle_type           handle,
+      rpc_loc_ioctl_e_type                 ioctl_type,
+      rpc_loc_ioctl_data_u_type*           ioctl_data_ptr,
+      uint32                               timeout_msec,
+      loc_eng_ioctl_done_cb                done_cb,
+      void                                *user_data
+);
+
+extern boolean loc_eng_ioctl_async_report
+(
+      rpc_loc_client_handle_type           handle,
+      const rpc_loc_ioctl_callback_s_type *ioctl_report_ptr
+);
+
+extern int  loc_eng_ioctl_async_in_flight();
+extern void loc_eng_ioctl_async_process();
+extern void loc_eng_ioctl_async_cancel_all();
+
 #endif // LOC_ENG_IOCTL_H
@@ -0,0 +1,236 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <hardware/gps.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+#define METERS_PER_DEG_LAT    111320.0   /* spherical earth, enough for fix-to-fix offsets */
+
+/*===========================================================================
+FUNCTION    loc_eng_kf_axis_init
+
+DESCRIPTION
+   Starts an axis at rest with the uncertainty of the first fix.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_kf_axis_init(loc_eng_kf_axis_s_type *axis, double r)
+{
+   axis->v    = 0.0;
+   axis->p_xx = r;
+   axis->p_xv = 0.0;
+   axis->p_vv = 100.0;   /* (10 m/s)^2, the speed is unknown */
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_kf_axis_predict
+
+DESCRIPTION
+   Constant velocity prediction over dt seconds, with white acceleration
+   noise of variance q. Returns the predicted offset in meters.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Predicted position change
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static double loc_eng_kf_axis_predict(loc_eng_kf_axis_s_type *axis, double dt, double q)
+{
+   double dt2 = dt * dt;
+
+   axis->p_xx += 2.0 * dt * axis->p_xv + dt2 * axis->p_vv + q * dt2 * dt2 / 4.0;
+   axis->p_xv += dt * axis->p_vv + q * dt2 * dt / 2.0;
+   axis->p_vv += q * dt2;
+
+   return axis->v * dt;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_kf_axis_correct
+
+DESCRIPTION
+   Applies the innovation y (measured minus predicted position, meters)
+   with measurement variance r.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Position correction in meters
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static double loc_eng_kf_axis_correct(loc_eng_kf_axis_s_type *axis, double y, double r)
+{
+   double s   = axis->p_xx + r;
+   double k_x = axis->p_xx / s;
+   double k_v = axis->p_xv / s;
+
+   axis->v    += k_v * y;
+   axis->p_vv -= k_v * axis->p_xv;
+   axis->p_xx *= (1.0 - k_x);
+   axis->p_xv *= (1.0 - k_x);
+
+   return k_x * y;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_kf_reset
+
+DESCRIPTION
+   Forgets the track, the next fix starts a new one.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_kf_reset(loc_eng_kf_s_type *kf)
+{
+   memset(kf, 0, sizeof *kf);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_kf_update
+
+DESCRIPTION
+   Constant velocity Kalman filter over latitude and longitude, run on each
+   reported fix. The fix is replaced with the filtered position. A fix too
+   far from the prediction, relative to the predicted and reported
+   (hor_unc_circular) uncertainties, is rejected; after
+   LOC_ENG_KF_MAX_REJECTED rejections in a row, or a gap of more than
+   LOC_ENG_KF_RESET_SEC, the filter restarts from the reported fix.
+
+   SMOOTH_ACCEL (m/s^2) in gps.conf sets the expected acceleration and
+   OUTLIER_SIGMA the rejection threshold in standard deviations.
+
+DEPENDENCIES
+   Fixes without position or accuracy are passed through untouched
+
+RETURN VALUE
+   FALSE if the fix is an outlier and should be dropped
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_kf_update(loc_eng_kf_s_type *kf, GpsLocation *location)
+{
+   double r, q, dt, k;
+   double m_per_deg_lon, d_east, d_north, y_east, y_north, d2;
+
+   if ((location->flags & (GPS_LOCATION_HAS_LAT_LONG | GPS_LOCATION_HAS_ACCURACY)) !=
+       (GPS_LOCATION_HAS_LAT_LONG | GPS_LOCATION_HAS_ACCURACY))
+   {
+      return TRUE;
+   }
+
+   r  = (double) location->accuracy * location->accuracy;
+   dt = kf->initialized ? (double) (location->timestamp - kf->timestamp) / 1000.0 : 0.0;
+
+   if (!kf->initialized || dt <= 0.0 || dt > LOC_ENG_KF_RESET_SEC ||
+       kf->rejected >= LOC_ENG_KF_MAX_REJECTED)
+   {
+      kf->initialized = TRUE;
+      kf->latitude    = location->latitude;
+      kf->longitude   = location->longitude;
+      kf->timestamp   = location->timestamp;
+      kf->rejected    = 0;
+      loc_eng_kf_axis_init(&kf->east, r);
+      loc_eng_kf_axis_init(&kf->north, r);
+      return TRUE;
+   }
+
+   q = (double) gps_conf.SMOOTH_ACCEL * gps_conf.SMOOTH_ACCEL;
+   k = (double) gps_conf.OUTLIER_SIGMA;
+   m_per_deg_lon = METERS_PER_DEG_LAT * cos(kf->latitude * M_PI / 180.0);
+
+   // Predict, the predicted position becomes the origin of the local frame
+   d_east  = loc_eng_kf_axis_predict(&kf->east, dt, q);
+   d_north = loc_eng_kf_axis_predict(&kf->north, dt, q);
+   kf->latitude  += d_north / METERS_PER_DEG_LAT;
+   kf->longitude += d_east / m_per_deg_lon;
+   kf->timestamp  = location->timestamp;
+
+   y_east  = (location->longitude - kf->longitude) * m_per_deg_lon;
+   y_north = (location->latitude - kf->latitude) * METERS_PER_DEG_LAT;
+
+   // Normalized innovation, a jump beyond k sigma is an outlier
+   d2 = y_east * y_east / (kf->east.p_xx + r) + y_north * y_north / (kf->north.p_xx + r);
+   if (k > 0.0 && d2 > k * k)
+   {
+      kf->rejected++;
+      LOC_LOGW("loc_eng_kf_update: outlier rejected, %.1f m off with accuracy %.1f m\n",
+            sqrt(y_east * y_east + y_north * y_north), location->accuracy);
+      return FALSE;
+   }
+   kf->rejected = 0;
+
+   kf->longitude += loc_eng_kf_axis_correct(&kf->east, y_east, r) / m_per_deg_lon;
+   kf->latitude  += loc_eng_kf_axis_correct(&kf->north, y_north, r) / METERS_PER_DEG_LAT;
+
+   location->latitude  = kf->latitude;
+   location->longitude = kf->longitude;
+
+   return TRUE;
+}
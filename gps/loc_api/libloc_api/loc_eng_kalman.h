@@ -0,0 +1,62 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_KALMAN_H
+#define LOC_ENG_KALMAN_H
+
+#include <hardware/gps.h>
+
+#define LOC_ENG_KF_RESET_SEC             10      /* gap after which the filter restarts */
+#define LOC_ENG_KF_MAX_REJECTED          3       /* outliers in a row before the filter restarts */
+
+// Position and velocity along one local axis (east or north), the position
+// itself is kept as latitude and longitude
+typedef struct
+{
+   double                         v;             /* m/s */
+   double                         p_xx;          /* covariance, m^2 */
+   double                         p_xv;
+   double                         p_vv;
+} loc_eng_kf_axis_s_type;
+
+typedef struct
+{
+   boolean                        initialized;
+   double                         latitude;
+   double                         longitude;
+   GpsUtcTime                     timestamp;     /* msec, of the last fix used */
+   loc_eng_kf_axis_s_type         east;
+   loc_eng_kf_axis_s_type         north;
+   int                            rejected;      /* outliers in a row */
+} loc_eng_kf_s_type;
+
+extern void    loc_eng_kf_reset(loc_eng_kf_s_type *kf);
+extern boolean loc_eng_kf_update(loc_eng_kf_s_type *kf, GpsLocation *location);
+
+#endif /* LOC_ENG_KALMAN_H */
@@ -52,7 +52,7 @@
 
 typedef struct
 {
-   char                 name[128];
+   const char*          name;
    long                 val;
 } loc_name_val_s_type;
 
@@ -61,7 +61,7 @@ typedef struct
 #define UNKNOWN_STR "UNKNOWN"
 
 /* Event names */
-loc_name_val_s_type loc_eng_event_name[] =
+static const loc_name_val_s_type loc_eng_event_name[] =
    {
       NAME_VAL( RPC_LOC_EVENT_PARSED_POSITION_REPORT ),
       NAME_VAL( RPC_LOC_EVENT_SATELLITE_REPORT ),
@@ -76,10 +76,10 @@ loc_name_val_s_type loc_eng_event_name[] =
       NAME_VAL( RPC_LOC_EVENT_WPS_NEEDED_REQUEST ),
 #endif
    };
-int loc_event_num = sizeof loc_eng_event_name / sizeof(loc_name_val_s_type);
+static const int loc_event_num = sizeof loc_eng_event_name / sizeof(loc_name_val_s_type);
 
 /* IOCTL Type names */
-loc_name_val_s_type loc_ioctl_type_name[] =
+static const loc_name_val_s_type loc_ioctl_type_name[] =
    {
       NAME_VAL( RPC_LOC_IOCTL_GET_API_VERSION ),
       NAME_VAL( RPC_LOC_IOCTL_SET_FIX_CRITERIA ),
@@ -117,10 +117,10 @@ loc_name_val_s_type loc_ioctl_type_name[] =
       NAME_VAL( RPC_LOC_IOCTL_SET_CUSTOM_PDE_SERVER_ADDR ),
       NAME_VAL( RPC_LOC_IOCTL_GET_CUSTOM_PDE_SERVER_ADDR ),
    };
-int loc_ioctl_type_num = sizeof loc_ioctl_type_name / sizeof(loc_name_val_s_type);
+static const int loc_ioctl_type_num = sizeof loc_ioctl_type_name / sizeof(loc_name_val_s_type);
 
 /* IOCTL Status names */
-loc_name_val_s_type loc_ioctl_status_name[] =
+static const loc_name_val_s_type loc_ioctl_status_name[] =
    {
       NAME_VAL( RPC_LOC_API_SUCCESS ),
       NAME_VAL( RPC_LOC_API_GENERAL_FAILURE ),
@@ -131,10 +131,10 @@ loc_name_val_s_type loc_ioctl_status_name[] =
       NAME_VAL( RPC_LOC_API_PHONE_OFFLINE ),
       NAME_VAL( RPC_LOC_API_TIMEOUT )
    };
-int loc_ioctl_status_num = sizeof loc_ioctl_status_name / sizeof(loc_name_val_s_type);
+static const int loc_ioctl_status_num = sizeof loc_ioctl_status_name / sizeof(loc_name_val_s_type);
 
 /* Fix session status names */
-loc_name_val_s_type loc_sess_status_name[] =
+static const loc_name_val_s_type loc_sess_status_name[] =
    {
       NAME_VAL( RPC_LOC_SESS_STATUS_SUCCESS ),
       NAME_VAL( RPC_LOC_SESS_STATUS_IN_PROGESS ),
@@ -146,26 +146,26 @@ loc_name_val_s_type loc_sess_status_name[] =
       NAME_VAL( RPC_LOC_SESS_STATUS_USER_END ),
       NAME_VAL( RPC_LOC_SESS_STATUS_ENGINE_LOCKED )
    };
-int loc_sess_status_num = sizeof loc_sess_status_name / sizeof(loc_name_val_s_type);
+static const int loc_sess_status_num = sizeof loc_sess_status_name / sizeof(loc_name_val_s_type);
 
 /* Engine state names */
-loc_name_val_s_type loc_engine_state_name[] =
+static const loc_name_val_s_type loc_engine_state_name[] =
    {
       NAME_VAL( RPC_LOC_ENGINE_STATE_ON ),
       NAME_VAL( RPC_LOC_ENGINE_STATE_OFF )
    };
-int loc_engine_state_num = sizeof loc_engine_state_name / sizeof(loc_name_val_s_type);
+static const int loc_engine_state_num = sizeof loc_engine_state_name / sizeof(loc_name_val_s_type);
 
 /* Fix session state names */
-loc_name_val_s_type loc_fix_session_state_name[] =
+static const loc_name_val_s_type loc_fix_session_state_name[] =
    {
       NAME_VAL( RPC_LOC_FIX_SESSION_STATE_BEGIN ),
       NAME_VAL( RPC_LOC_FIX_SESSION_STATE_END )
    };
-int loc_fix_session_state_num = sizeof loc_fix_session_state_name / sizeof(loc_name_val_s_type);
+static const int loc_fix_session_state_num = sizeof loc_fix_session_state_name / sizeof(loc_name_val_s_type);
 
 /* GPS status names */
-loc_name_val_s_type gps_status_name[] =
+static const loc_name_val_s_type gps_status_name[] =
    {
       NAME_VAL( GPS_STATUS_NONE ),
       NAME_VAL( GPS_STATUS_SESSION_BEGIN ),
@@ -173,31 +173,94 @@ loc_name_val_s_type gps_status_name[] =
       NAME_VAL( GPS_STATUS_ENGINE_ON ),
       NAME_VAL( GPS_STATUS_ENGINE_OFF ),
    };
-int gps_status_num = sizeof gps_status_name / sizeof(loc_name_val_s_type);
+static const int gps_status_num = sizeof gps_status_name / sizeof(loc_name_val_s_type);
 
-/* Get names from value */
-static const char* loc_eng_get_name_from_mask(loc_name_val_s_type table[], int table_size, long mask)
+/* Direct index over a name table, built once on first use. Value tables are
+ * indexed by the low bits of the value, mask tables by bit position. An entry
+ * that collides with an earlier one is left out and found by linear scan. */
+#define LOC_NAME_INDEX_SIZE 128  /* must be a power of 2 */
+
+typedef struct
+{
+   const loc_name_val_s_type*  table;
+   int                         table_size;
+   boolean                     by_mask;
+   const loc_name_val_s_type*  index[LOC_NAME_INDEX_SIZE];
+} loc_name_index_s_type;
+
+static loc_name_index_s_type loc_event_index        = { loc_eng_event_name, loc_event_num, TRUE };
+static loc_name_index_s_type loc_ioctl_type_index   = { loc_ioctl_type_name, loc_ioctl_type_num, FALSE };
+static loc_name_index_s_type loc_ioctl_status_index = { loc_ioctl_status_name, loc_ioctl_status_num, FALSE };
+static loc_name_index_s_type loc_sess_status_index  = { loc_sess_status_name, loc_sess_status_num, FALSE };
+static loc_name_index_s_type loc_engine_state_index = { loc_engine_state_name, loc_engine_state_num, FALSE };
+static loc_name_index_s_type loc_fix_session_state_index = { loc_fix_session_state_name, loc_fix_session_state_num, FALSE };
+static loc_name_index_s_type gps_status_index       = { gps_status_name, gps_status_num, FALSE };
+
+static pthread_once_t loc_name_index_once = PTHREAD_ONCE_INIT;
+
+/* Index slot of a value, -1 if it cannot be indexed */
+static int loc_name_index_slot(const loc_name_index_s_type *index, long val)
+{
+   if (!index->by_mask)
+   {
+      return (int) (val & (LOC_NAME_INDEX_SIZE - 1));
+   }
+   if ((unsigned long) val == 0)
+   {
+      return -1;
+   }
+   /* position of the lowest bit set, the mask tables are sorted by bit */
+   return __builtin_ctzl((unsigned long) val);
+}
+
+static void loc_name_index_build(loc_name_index_s_type *index)
 {
-   int i;
-   for (i = 0; i < table_size; i++)
+   int i, slot;
+   for (i = 0; i < index->table_size; i++)
    {
-      if (table[i].val & (long) mask)
+      slot = loc_name_index_slot(index, index->table[i].val);
+      if (slot >= 0 && slot < LOC_NAME_INDEX_SIZE && index->index[slot] == NULL)
       {
-         return table[i].name;
+         index->index[slot] = &index->table[i];
       }
    }
-   return UNKNOWN_STR;
 }
 
-/* Get names from value */
-static const char* loc_eng_get_name_from_val(loc_name_val_s_type table[], int table_size, long value)
+static void loc_name_index_init(void)
+{
+   loc_name_index_build(&loc_event_index);
+   loc_name_index_build(&loc_ioctl_type_index);
+   loc_name_index_build(&loc_ioctl_status_index);
+   loc_name_index_build(&loc_sess_status_index);
+   loc_name_index_build(&loc_engine_state_index);
+   loc_name_index_build(&loc_fix_session_state_index);
+   loc_name_index_build(&gps_status_index);
+}
+
+/* Get names from value, or from the first bit set for mask tables */
+static const char* loc_eng_get_name(const loc_name_index_s_type *index, long val)
 {
-   int i;
-   for (i = 0; i < table_size; i++)
+   const loc_name_val_s_type *entry = NULL;
+   int i, slot;
+
+   pthread_once(&loc_name_index_once, loc_name_index_init);
+
+   slot = loc_name_index_slot(index, val);
+   if (slot >= 0 && slot < LOC_NAME_INDEX_SIZE)
+   {
+      entry = index->index[slot];
+   }
+   if (entry != NULL && (index->by_mask ? (entry->val & val) : (entry->val == val)))
+   {
+      return entry->name;
+   }
+
+   /* Not indexed, fall back to a scan */
+   for (i = 0; i < index->table_size; i++)
    {
-      if (table[i].val == (long) value)
+      if (index->by_mask ? (index->table[i].val & val) : (index->table[i].val == val))
       {
-         return table[i].name;
+         return index->table[i].name;
       }
    }
    return UNKNOWN_STR;
@@ -206,50 +269,43 @@ static const char* loc_eng_get_name_from_val(loc_name_val_s_type table[], int ta
 /* Finds the first event found in the mask */
 const char* loc_get_event_name(rpc_loc_event_mask_type loc_event_mask)
 {
-   return loc_eng_get_name_from_mask(loc_eng_event_name, loc_event_num,
-         (long) loc_event_mask);
+   return loc_eng_get_name(&loc_event_index, (long) loc_event_mask);
 }
 
 /* Finds IOCTL type name */
 const char* loc_get_ioctl_type_name(rpc_loc_ioctl_e_type ioctl_type)
 {
-   return loc_eng_get_name_from_val(loc_ioctl_type_name, loc_ioctl_type_num,
-         (long) ioctl_type);
+   return loc_eng_get_name(&loc_ioctl_type_index, (long) ioctl_type);
 }
 
 /* Finds IOCTL status name */
 const char* loc_get_ioctl_status_name(uint32 status)
 {
-   return loc_eng_get_name_from_val(loc_ioctl_status_name, loc_ioctl_status_num,
-         (long) status);
+   return loc_eng_get_name(&loc_ioctl_status_index, (long) status);
 }
 
 /* Finds session status name */
 const char* loc_get_sess_status_name(rpc_loc_session_status_e_type status)
 {
-   return loc_eng_get_name_from_val(loc_sess_status_name, loc_sess_status_num,
-         (long) status);
+   return loc_eng_get_name(&loc_sess_status_index, (long) status);
 }
 
 /* Find engine state name */
 const char* loc_get_engine_state_name(rpc_loc_engine_state_e_type state)
 {
-   return loc_eng_get_name_from_val(loc_engine_state_name, loc_engine_state_num,
-         (long) state);
+   return loc_eng_get_name(&loc_engine_state_index, (long) state);
 }
 
 /* Find engine state name */
 const char* loc_get_fix_session_state_name(rpc_loc_fix_session_state_e_type state)
 {
-   return loc_eng_get_name_from_val(loc_fix_session_state_name, loc_fix_session_state_num,
-         (long) state);
+   return loc_eng_get_name(&loc_fix_session_state_index, (long) state);
 }
 
 /* Find Android GPS status name */
 const char* loc_get_gps_status_name(GpsStatusValue gps_status)
 {
-   return loc_eng_get_name_from_val(gps_status_name, gps_status_num,
-         (long) gps_status);
+   return loc_eng_get_name(&gps_status_index, (long) gps_status);
 }
 
 const char* log_succ_fail_string(int is_succ)
@@ -297,62 +353,14 @@ static void log_status_report(const rpc_loc_status_event_s_type *status_event)
    }
 }
 
-#define CHECK_MASK(type, value, mask_var, mask) \
-   ((mask_var & mask) ? (type) value : (type) (-1))
-
-/* Logs valid fields in the GNSS SV constellation report */
+/* Logs the GNSS SV constellation report summary, the DOPs and the SV list
+ * are in the trace ring */
 static void log_satellite_report(const rpc_loc_gnss_info_s_type *gnss)
 {
-   if (gnss->valid_mask & RPC_LOC_GNSS_INFO_VALID_POS_DOP)
-   {
-      LOC_LOGV("position dop: %.3f\n", (float) gnss->position_dop);
-   }
-   if (gnss->valid_mask & RPC_LOC_GNSS_INFO_VALID_HOR_DOP)
-   {
-      LOC_LOGV("horizontal dop: %.3f\n", (float) gnss->horizontal_dop);
-   }
-   if (gnss->valid_mask & RPC_LOC_GNSS_INFO_VALID_VERT_DOP)
-   {
-      LOC_LOGV("vertical dop: %.3f\n", (float) gnss->vertical_dop);
-   }
-   if (gnss->valid_mask & RPC_LOC_GNSS_INFO_VALID_ALTITUDE_ASSUMED)
-   {
-      LOC_LOGV("altitude assumed: %d\n", (int) gnss->altitude_assumed);
-   }
    if (gnss->valid_mask & RPC_LOC_GNSS_INFO_VALID_SV_COUNT)
    {
       LOC_LOGD("sv count: %d\n", (int) gnss->sv_count);
    }
-   if (gnss->valid_mask & RPC_LOC_GNSS_INFO_VALID_SV_LIST)
-   {
-      LOC_LOGV("sv list: ");
-
-      if (gnss->sv_count)
-      {
-         LOC_LOGV("\n\tsys\tprn\thlth\tproc\teph\talm\telev\tazi\tsnr\n");
-      }
-      else {
-         LOC_LOGV("empty\n");
-      }
-
-      int i;
-      for (i = 0; i < gnss->sv_count; i++)
-      {
-         const rpc_loc_sv_info_s_type *sv = &gnss->sv_list.sv_list_val[i];
-         rpc_loc_sv_info_valid_mask_type mask = sv->valid_mask;
-         LOC_LOGV("  %d: \t%d\t%d\t%d\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\n", i,
-               CHECK_MASK(int,   sv->system,         mask, RPC_LOC_SV_INFO_VALID_SYSTEM),
-               CHECK_MASK(int,   sv->prn,            mask, RPC_LOC_SV_INFO_VALID_PRN),
-               CHECK_MASK(int,   sv->health_status,  mask, RPC_LOC_SV_INFO_VALID_HEALTH_STATUS),
-               CHECK_MASK(int,   sv->process_status, mask, RPC_LOC_SV_INFO_VALID_PROCESS_STATUS),
-               CHECK_MASK(int,   sv->has_eph,        mask, RPC_LOC_SV_INFO_VALID_HAS_EPH),
-               CHECK_MASK(int,   sv->has_alm,        mask, RPC_LOC_SV_INFO_VALID_HAS_ALM),
-               CHECK_MASK(float, sv->elevation,      mask, RPC_LOC_SV_INFO_VALID_ELEVATION),
-               CHECK_MASK(float, sv->azimuth,        mask, RPC_LOC_SV_INFO_VALID_AZIMUTH),
-               CHECK_MASK(float, sv->snr,            mask, RPC_LOC_SV_INFO_VALID_SNR)
-         );
-      }
-   }
 }
 
 /*===========================================================================
@@ -407,12 +415,32 @@ int loc_eng_callback_log_header(
    return 0;
 }
 
-/* Logs a callback event */
+/* Logs a callback event. Reports always go to the trace ring, text is only
+ * formatted when the debug level lets it through */
 int loc_eng_callback_log(
       rpc_loc_event_mask_type               loc_event,              /* event mask           */
       const rpc_loc_event_payload_u_type*   loc_event_payload       /* payload              */
 )
 {
+   switch (loc_event)
+   {
+   case RPC_LOC_EVENT_SATELLITE_REPORT:
+      loc_eng_trace_satellites(&loc_event_payload->
+            rpc_loc_event_payload_u_type_u.gnss_report);
+      break;
+   case RPC_LOC_EVENT_PARSED_POSITION_REPORT:
+      loc_eng_trace_position(&loc_event_payload->
+            rpc_loc_event_payload_u_type_u.parsed_location_report);
+      break;
+   default:
+      break;
+   }
+
+   if (!LOC_LOG_ENABLED(LOC_LOG_LEVEL_D))
+   {
+      return 0;
+   }
+
    switch (loc_event)
    {
    case RPC_LOC_EVENT_SATELLITE_REPORT:
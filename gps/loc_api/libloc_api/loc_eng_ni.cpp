@@ -67,18 +67,13 @@ boolean loc_eng_ni_data_init = FALSE;
 loc_eng_ni_data_s_type loc_eng_ni_data;
 
 extern loc_eng_data_s_type loc_eng_data;
-/* User response callback waiting conditional variable */
-pthread_cond_t             user_cb_arrived_cond = PTHREAD_COND_INITIALIZER;
-
-/* User callback waiting data block, protected by user_cb_data_mutex */
-pthread_mutex_t            user_cb_data_mutex   = PTHREAD_MUTEX_INITIALIZER;
 
 /*=============================================================================
  *
  *                             FUNCTION DECLARATIONS
  *
  *============================================================================*/
-static void* loc_ni_thread_proc(void *threadid);
+static void loc_ni_response_timer_cb(void *user_data);
 /*===========================================================================
 
 FUNCTION respond_from_enum
@@ -130,19 +125,24 @@ static void loc_ni_respond
    LOC_LOGD("Sending NI response: %s\n", respond_from_enum(resp));
 
    rpc_loc_ioctl_data_u_type data;
-   rpc_loc_ioctl_callback_s_type callback_payload;
 
    memcpy(&data.rpc_loc_ioctl_data_u_type_u.user_verify_resp.ni_event_pass_back,
          request_pass_back, sizeof (rpc_loc_ni_event_s_type));
    data.rpc_loc_ioctl_data_u_type_u.user_verify_resp.user_resp = resp;
 
-   loc_eng_ioctl(
+   // Nothing to do with the report, only wait for it in the background
+   int rc = loc_eng_ioctl_async(
          loc_eng_data.client_handle,
          RPC_LOC_IOCTL_INFORM_NI_USER_RESPONSE,
          &data,
          LOC_IOCTL_DEFAULT_TIMEOUT,
-         &callback_payload
+         NULL,
+         NULL
    );
+   if (rc != RPC_LOC_API_SUCCESS)
+   {
+      LOC_LOGE("NI response not sent: %s\n", loc_get_ioctl_status_name(rc));
+   }
 }
 
 /*===========================================================================
@@ -517,26 +517,22 @@ static void loc_ni_request_handler(const char *msg, const rpc_loc_ni_event_s_typ
          LOC_LOGI("              extras: %s", notif.extras);
       }
 
-      /* For robustness, spawn a thread at this point to timeout to clear up the notification status, even though
+      /* For robustness, arm a timer at this point to timeout to clear up the notification status, even though
        * the OEM layer in java does not do so.
        **/
       loc_eng_ni_data.response_time_left = 5 + (notif.timeout != 0 ? notif.timeout : LOC_NI_NO_RESPONSE_TIME);
       LOC_LOGI("Automatically sends 'no response' in %d seconds (to clear status)\n", loc_eng_ni_data.response_time_left);
 
-      /* @todo may required when android framework issue is fixed
-       * loc_eng_ni_data.callbacks_ref->create_thread_cb("loc_api_ni", loc_ni_thread_proc, NULL);
-       */
-
-      int rc = 0;
-      rc = pthread_create(&loc_eng_ni_data.loc_ni_thread, NULL, loc_ni_thread_proc, NULL);
-      if (rc)
+      loc_eng_ni_data.user_response_received = FALSE;
+      loc_eng_ni_data.response_timer = loc_eng_timer_start(loc_eng_ni_data.response_time_left * 1000,
+                                                           loc_ni_response_timer_cb, NULL);
+      if (loc_eng_ni_data.response_timer == LOC_ENG_TIMER_INVALID)
       {
-         LOC_LOGE("Loc NI thread is not created.\n");
-      }
-      rc = pthread_detach(loc_eng_ni_data.loc_ni_thread);
-      if (rc)
-      {
-         LOC_LOGE("Loc NI thread is not detached.\n");
+         /* Nothing would ever clear the notification, answer it right away */
+         LOC_LOGE("Loc NI response timer is not started, sending 'no response'.\n");
+         pthread_mutex_unlock(&loc_eng_ni_data.loc_ni_lock);
+         loc_ni_response_timer_cb(NULL);
+         return;
       }
       pthread_mutex_unlock(&loc_eng_ni_data.loc_ni_lock);
 
@@ -561,10 +557,10 @@ RETURN VALUE
 ===========================================================================*/
 int loc_ni_process_user_response(GpsUserResponseType userResponse)
 {
-   int rc=0;
    LOC_LOGD("NI response from UI: %d", userResponse);
 
    rpc_loc_ni_user_resp_e_type resp;
+   boolean timer_started;
    switch (userResponse)
    {
    case GPS_NI_RESPONSE_ACCEPT:
@@ -579,12 +575,19 @@ int loc_ni_process_user_response(GpsUserResponseType userResponse)
    default:
       return -1;
    }
-   /* Turn of the timeout*/
-   pthread_mutex_lock(&user_cb_data_mutex);
+   /* Turn of the timeout, the response is sent right away from the deferred action thread */
+   pthread_mutex_lock(&loc_eng_ni_data.loc_ni_lock);
    loc_eng_ni_data.resp = resp;
    loc_eng_ni_data.user_response_received = TRUE;
-   rc = pthread_cond_signal(&user_cb_arrived_cond);
-   pthread_mutex_unlock(&user_cb_data_mutex);
+   loc_eng_timer_stop(loc_eng_ni_data.response_timer);
+   loc_eng_ni_data.response_timer = loc_eng_timer_start(0, loc_ni_response_timer_cb, NULL);
+   timer_started = (loc_eng_ni_data.response_timer != LOC_ENG_TIMER_INVALID);
+   pthread_mutex_unlock(&loc_eng_ni_data.loc_ni_lock);
+
+   if (!timer_started)
+   {
+      loc_ni_response_timer_cb(NULL);
+   }
    return 0;
 }
 
@@ -635,49 +638,54 @@ int loc_eng_ni_callback (
 
 /*===========================================================================
 
-FUNCTION loc_ni_thread_proc
+FUNCTION loc_ni_response_timer_cb
+
+DESCRIPTION
+   Sends the NI response to the modem, either the user response or
+   'no response' once the notification has timed out, and clears the
+   notification status.
+
+DEPENDENCIES
+   Called on the deferred action thread, or directly when the timer
+   cannot be armed
+
+RETURN VALUE
+   none
 
 ===========================================================================*/
-static void* loc_ni_thread_proc(void *threadid)
+static void loc_ni_response_timer_cb(void *user_data)
 {
-   int rc = 0;          /* return code from pthread calls */
-
-   struct timeval present_time;
-   struct timespec expire_time;
+   rpc_loc_ni_user_resp_e_type resp;
+   rpc_loc_ni_event_s_type     request;
 
-   LOC_LOGD("Starting Loc NI thread...\n");
-   pthread_mutex_lock(&user_cb_data_mutex);
-   /* Calculate absolute expire time */
-   gettimeofday(&present_time, NULL);
-   expire_time.tv_sec  = present_time.tv_sec;
-   expire_time.tv_nsec = present_time.tv_usec * 1000;
-   expire_time.tv_sec += loc_eng_ni_data.response_time_left;
-   LOC_LOGD("loc_ni_thread_proc-Time out set for abs time %ld\n", (long) expire_time.tv_sec );
+   pthread_mutex_lock(&loc_eng_ni_data.loc_ni_lock);
+   if (!loc_eng_ni_data.notif_in_progress)
+   {
+      pthread_mutex_unlock(&loc_eng_ni_data.loc_ni_lock);
+      return;
+   }
 
-   while (!loc_eng_ni_data.user_response_received)
+   if (loc_eng_ni_data.user_response_received == TRUE)
    {
-      rc = pthread_cond_timedwait(&user_cb_arrived_cond, &user_cb_data_mutex, &expire_time);
-      if (rc == ETIMEDOUT)
-      {
-         loc_eng_ni_data.resp = RPC_LOC_NI_LCS_NOTIFY_VERIFY_NORESP;
-         LOC_LOGD("loc_ni_thread_proc-Thread time out after valting for specified time. Ret Val %d\n",rc );
-         break;
-      }
+      LOC_LOGD("loc_ni_response_timer_cb-Java layer has sent us a user response\n");
+      resp = loc_eng_ni_data.resp;
+      loc_eng_ni_data.user_response_received = FALSE; /* Reset the user response flag for the next session*/
    }
-      if (loc_eng_ni_data.user_response_received == TRUE)
-      {
-         LOC_LOGD("loc_ni_thread_proc-Java layer has sent us a user response and return value from "
-                  "pthread_cond_timedwait = %d\n",rc );
-         loc_eng_ni_data.user_response_received = FALSE; /* Reset the user response flag for the next session*/
-      }
-   loc_ni_respond(loc_eng_ni_data.resp, &loc_eng_ni_data.loc_ni_request);
-   pthread_mutex_unlock(&user_cb_data_mutex);
-   pthread_mutex_lock(&loc_eng_ni_data.loc_ni_lock);
+   else
+   {
+      LOC_LOGD("loc_ni_response_timer_cb-Time out after waiting %d seconds\n",
+            loc_eng_ni_data.response_time_left);
+      resp = RPC_LOC_NI_LCS_NOTIFY_VERIFY_NORESP;
+   }
+   memcpy(&request, &loc_eng_ni_data.loc_ni_request, sizeof request);
+
    loc_eng_ni_data.notif_in_progress = FALSE;
    loc_eng_ni_data.response_time_left = 0;
    loc_eng_ni_data.current_notif_id = -1;
+   loc_eng_ni_data.response_timer = LOC_ENG_TIMER_INVALID;
    pthread_mutex_unlock(&loc_eng_ni_data.loc_ni_lock);
-   return NULL;
+
+   loc_ni_respond(resp, &request);
 }
 
 /*===========================================================================
@@ -710,6 +718,7 @@ void loc_eng_ni_init(GpsNiCallbacks *callbacks)
    loc_eng_ni_data.current_notif_id = -1;
    loc_eng_ni_data.response_time_left = 0;
    loc_eng_ni_data.user_response_received = FALSE;
+   loc_eng_ni_data.response_timer = LOC_ENG_TIMER_INVALID;
 
    srand(time(NULL));
    loc_eng_data.ni_notify_cb = callbacks->notify_cb;
@@ -37,7 +37,7 @@
 extern const GpsNiInterface sLocEngNiInterface;
 
 typedef struct {
-   pthread_t               loc_ni_thread;            /* NI thread */
+   int                     response_timer;           /* loc_eng_timer for the NI response */
    pthread_mutex_t         loc_ni_lock;
    int                     response_time_left;       /* examine time for NI response */
    boolean                 user_response_received;   /* NI User reponse received or not from Java layer*/
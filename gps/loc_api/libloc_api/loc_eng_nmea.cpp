@@ -0,0 +1,508 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <hardware/gps.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+#define KNOTS_TO_MPS          0.514444
+
+static void loc_eng_nmea_set_callbacks(LocNmeaCallbacks *callbacks);
+static void loc_eng_nmea_set_mask(uint32_t mask);
+
+const LocNmeaInterface sLocEngNmeaInterface =
+{
+   sizeof(LocNmeaInterface),
+   loc_eng_nmea_set_callbacks,
+   loc_eng_nmea_set_mask,
+};
+
+/* Set by extension users, read by the deferred action thread, protected by
+ * the lock */
+static loc_eng_nmea_data_s_type loc_eng_nmea_data =
+{
+   PTHREAD_MUTEX_INITIALIZER,
+   LOC_NMEA_MASK_ALL,
+};
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_init
+
+DESCRIPTION
+   Applies NMEA_MASK from gps.conf. Called from loc_eng_init.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_nmea_init()
+{
+   loc_eng_nmea_set_mask(gps_conf.NMEA_MASK);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_set_callbacks
+
+DESCRIPTION
+   Registers the callbacks of the NMEA extension.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_nmea_set_callbacks(LocNmeaCallbacks *callbacks)
+{
+   pthread_mutex_lock(&loc_eng_nmea_data.lock);
+   loc_eng_nmea_data.gga_cb = (callbacks != NULL) ? callbacks->gga_cb : NULL;
+   loc_eng_nmea_data.rmc_cb = (callbacks != NULL) ? callbacks->rmc_cb : NULL;
+   pthread_mutex_unlock(&loc_eng_nmea_data.lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_set_mask
+
+DESCRIPTION
+   Selects the sentence types forwarded to nmea_cb.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_nmea_set_mask(uint32_t mask)
+{
+   LOC_LOGD("loc_eng_nmea_set_mask: 0x%x\n", mask);
+
+   pthread_mutex_lock(&loc_eng_nmea_data.lock);
+   loc_eng_nmea_data.mask = mask;
+   pthread_mutex_unlock(&loc_eng_nmea_data.lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_hex
+
+DESCRIPTION
+   Converts a hexadecimal digit.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0-15, or -1 if c is not a hexadecimal digit
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_nmea_hex(char c)
+{
+   if (c >= '0' && c <= '9') return c - '0';
+   if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+   if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+   return -1;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_tokenize
+
+DESCRIPTION
+   Splits a sentence into its comma separated fields without copying it.
+   Field 0 is the address, e.g. GPGGA. The checksum is verified if present.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Number of fields, -1 if the sentence is malformed
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_nmea_tokenize(const char *sentence, int length,
+            loc_eng_nmea_field_s_type *fields, int max_fields)
+{
+   const char     *end = sentence + length;
+   const char     *p;
+   unsigned char   checksum = 0;
+   int             num_fields = 0;
+   int             hi, lo;
+
+   if (length < 1 || sentence[0] != '$')
+   {
+      return -1;
+   }
+
+   fields[0].ptr = sentence + 1;
+   for (p = sentence + 1; p < end && *p != '*' && *p != '\r' && *p != '\n'; p++)
+   {
+      checksum ^= (unsigned char) *p;
+      if (*p == ',')
+      {
+         fields[num_fields].len = p - fields[num_fields].ptr;
+         if (++num_fields >= max_fields)
+         {
+            return -1;
+         }
+         fields[num_fields].ptr = p + 1;
+      }
+   }
+   fields[num_fields].len = p - fields[num_fields].ptr;
+   num_fields++;
+
+   if (p < end && *p == '*')
+   {
+      if (end - p < 3 ||
+          (hi = loc_eng_nmea_hex(p[1])) < 0 || (lo = loc_eng_nmea_hex(p[2])) < 0 ||
+          checksum != ((hi << 4) | lo))
+      {
+         return -1;
+      }
+   }
+
+   return num_fields;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_double
+
+DESCRIPTION
+   Parses a decimal field in place. Fields are not terminated, so the C
+   library conversions cannot be used on them.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   The value, 0 for an empty field
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static double loc_eng_nmea_double(const loc_eng_nmea_field_s_type *field)
+{
+   const char *p = field->ptr;
+   const char *end = field->ptr + field->len;
+   double      value = 0, scale = 1;
+   boolean     negative = FALSE;
+
+   if (p < end && (*p == '-' || *p == '+'))
+   {
+      negative = (*p == '-');
+      p++;
+   }
+   for (; p < end && *p >= '0' && *p <= '9'; p++)
+   {
+      value = value * 10 + (*p - '0');
+   }
+   if (p < end && *p == '.')
+   {
+      for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+      {
+         scale /= 10;
+         value += (*p - '0') * scale;
+      }
+   }
+
+   return negative ? -value : value;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_degrees
+
+DESCRIPTION
+   Converts a [d]ddmm.mmmm field and its hemisphere field to degrees.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Degrees, negative for S and W
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static double loc_eng_nmea_degrees(const loc_eng_nmea_field_s_type *value,
+            const loc_eng_nmea_field_s_type *hemisphere)
+{
+   double ddmm = loc_eng_nmea_double(value);
+   double degrees = (int) (ddmm / 100) + (ddmm - 100 * (int) (ddmm / 100)) / 60;
+
+   if (hemisphere->len > 0 && (hemisphere->ptr[0] == 'S' || hemisphere->ptr[0] == 'W'))
+   {
+      degrees = -degrees;
+   }
+
+   return degrees;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_utc_msec
+
+DESCRIPTION
+   Converts an hhmmss.sss field to milliseconds since midnight.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Milliseconds
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static uint32_t loc_eng_nmea_utc_msec(const loc_eng_nmea_field_s_type *field)
+{
+   double   hhmmss = loc_eng_nmea_double(field);
+   uint32_t hhmm = (uint32_t) (hhmmss / 100);
+
+   return ((hhmm / 100) * 3600 + (hhmm % 100) * 60) * 1000 +
+          (uint32_t) ((hhmmss - hhmm * 100) * 1000 + 0.5);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_type
+
+DESCRIPTION
+   Finds the sentence type from the address field, ignoring the talker.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   One LOC_NMEA_MASK_* bit
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static uint32_t loc_eng_nmea_type(const char *sentence, int length)
+{
+   const char *type = sentence + 3;   /* $ and two talker characters */
+
+   if (length < 6)
+   {
+      return LOC_NMEA_MASK_OTHER;
+   }
+
+   if (memcmp(type, "GGA", 3) == 0) return LOC_NMEA_MASK_GGA;
+   if (memcmp(type, "RMC", 3) == 0) return LOC_NMEA_MASK_RMC;
+   if (memcmp(type, "GSV", 3) == 0) return LOC_NMEA_MASK_GSV;
+   if (memcmp(type, "GSA", 3) == 0) return LOC_NMEA_MASK_GSA;
+   if (memcmp(type, "VTG", 3) == 0) return LOC_NMEA_MASK_VTG;
+   return LOC_NMEA_MASK_OTHER;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_parse
+
+DESCRIPTION
+   Hands GGA and RMC sentences to the extension callbacks.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_nmea_parse(const char *sentence, int length, uint32_t type,
+            long long timestamp, loc_nmea_gga_callback gga_cb, loc_nmea_rmc_callback rmc_cb)
+{
+   loc_eng_nmea_field_s_type fields[LOC_ENG_NMEA_MAX_FIELDS];
+   int num_fields;
+
+   num_fields = loc_eng_nmea_tokenize(sentence, length, fields, LOC_ENG_NMEA_MAX_FIELDS);
+
+   if (type == LOC_NMEA_MASK_GGA && gga_cb != NULL && num_fields >= 12)
+   {
+      LocNmeaGga gga;
+
+      gga.size = sizeof(LocNmeaGga);
+      gga.timestamp = timestamp;
+      gga.utc_msec = loc_eng_nmea_utc_msec(&fields[1]);
+      gga.latitude = loc_eng_nmea_degrees(&fields[2], &fields[3]);
+      gga.longitude = loc_eng_nmea_degrees(&fields[4], &fields[5]);
+      gga.fix_quality = (int) loc_eng_nmea_double(&fields[6]);
+      gga.num_svs = (int) loc_eng_nmea_double(&fields[7]);
+      gga.hdop = loc_eng_nmea_double(&fields[8]);
+      gga.altitude = loc_eng_nmea_double(&fields[9]);
+      gga.geoid_separation = loc_eng_nmea_double(&fields[11]);
+      gga_cb(&gga);
+   }
+   else if (type == LOC_NMEA_MASK_RMC && rmc_cb != NULL && num_fields >= 10)
+   {
+      LocNmeaRmc rmc;
+
+      rmc.size = sizeof(LocNmeaRmc);
+      rmc.timestamp = timestamp;
+      rmc.utc_msec = loc_eng_nmea_utc_msec(&fields[1]);
+      rmc.valid = (fields[2].len > 0 && fields[2].ptr[0] == 'A');
+      rmc.latitude = loc_eng_nmea_degrees(&fields[3], &fields[4]);
+      rmc.longitude = loc_eng_nmea_degrees(&fields[5], &fields[6]);
+      rmc.speed = loc_eng_nmea_double(&fields[7]) * KNOTS_TO_MPS;
+      rmc.bearing = loc_eng_nmea_double(&fields[8]);
+      rmc.date = (uint32_t) loc_eng_nmea_double(&fields[9]);
+      rmc_cb(&rmc);
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_report
+
+DESCRIPTION
+   Forwards the sentences of an NMEA report selected by the mask to nmea_cb,
+   in place and in as few calls as possible, and parses GGA and RMC for the
+   extension callbacks. nmea_cb gets the wall-clock time in msec since the
+   epoch, as the framework expects; the extension callbacks get the
+   monotonic clock.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_nmea_report(const char *nmea, int length)
+{
+   gps_nmea_callback      nmea_cb = loc_eng_data.nmea_cb;
+   loc_nmea_gga_callback  gga_cb;
+   loc_nmea_rmc_callback  rmc_cb;
+   uint32_t               mask, type;
+   const char            *end = nmea + length;
+   const char            *sentence, *next;
+   const char            *run = NULL;   /* start of the sentences to forward */
+   struct timeval         tv;
+   long long              now, utc;
+
+   pthread_mutex_lock(&loc_eng_nmea_data.lock);
+   mask = loc_eng_nmea_data.mask;
+   gga_cb = loc_eng_nmea_data.gga_cb;
+   rmc_cb = loc_eng_nmea_data.rmc_cb;
+   pthread_mutex_unlock(&loc_eng_nmea_data.lock);
+
+   if (nmea_cb == NULL)
+   {
+      mask = 0;
+   }
+   if (mask == 0 && gga_cb == NULL && rmc_cb == NULL)
+   {
+      return;
+   }
+
+   // Reports may carry a terminating NUL
+   while (end > nmea && end[-1] == '\0')
+   {
+      end--;
+   }
+
+   now = loc_eng_timer_now_msec();
+   gettimeofday(&tv, (struct timezone *) NULL);
+   utc = tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+
+   if (mask == LOC_NMEA_MASK_ALL && gga_cb == NULL && rmc_cb == NULL)
+   {
+      nmea_cb(utc, nmea, end - nmea);
+      return;
+   }
+
+   for (sentence = nmea; sentence < end; sentence = next)
+   {
+      next = (const char *) memchr(sentence + 1, '$', end - sentence - 1);
+      if (next == NULL)
+      {
+         next = end;
+      }
+
+      type = loc_eng_nmea_type(sentence, next - sentence);
+      if (type & (LOC_NMEA_MASK_GGA | LOC_NMEA_MASK_RMC))
+      {
+         loc_eng_nmea_parse(sentence, next - sentence, type, now, gga_cb, rmc_cb);
+      }
+
+      if (type & mask)
+      {
+         if (run == NULL)
+         {
+            run = sentence;
+         }
+      }
+      else if (run != NULL)
+      {
+         nmea_cb(utc, run, sentence - run);
+         run = NULL;
+      }
+   }
+
+   if (run != NULL)
+   {
+      nmea_cb(utc, run, end - run);
+   }
+}
@@ -0,0 +1,121 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_NMEA_H
+#define LOC_ENG_NMEA_H
+
+#include <hardware/gps.h>
+
+// Sentence types, same bits as RPC_LOC_NMEA_MASK_*
+#define LOC_NMEA_MASK_GGA                0x0001
+#define LOC_NMEA_MASK_RMC                0x0002
+#define LOC_NMEA_MASK_GSV                0x0004
+#define LOC_NMEA_MASK_GSA                0x0008
+#define LOC_NMEA_MASK_VTG                0x0010
+#define LOC_NMEA_MASK_OTHER              0x8000
+#define LOC_NMEA_MASK_ALL                0xffff
+
+// Extension to select forwarded sentences and get parsed ones, see loc_eng_get_extension
+#define LOC_NMEA_INTERFACE               "loc-nmea"
+
+// Parsed GGA sentence
+typedef struct
+{
+   size_t          size;
+   int64_t         timestamp;                    /* monotonic, msec */
+   uint32_t        utc_msec;                     /* UTC time of day */
+   double          latitude;                     /* degrees, south negative */
+   double          longitude;                    /* degrees, west negative */
+   int             fix_quality;                  /* 0 = no fix */
+   int             num_svs;
+   float           hdop;
+   double          altitude;                     /* above mean sea level, meters */
+   float           geoid_separation;             /* meters */
+} LocNmeaGga;
+
+// Parsed RMC sentence
+typedef struct
+{
+   size_t          size;
+   int64_t         timestamp;                    /* monotonic, msec */
+   uint32_t        utc_msec;                     /* UTC time of day */
+   uint32_t        date;                         /* ddmmyy */
+   int             valid;                        /* status A */
+   double          latitude;
+   double          longitude;
+   float           speed;                        /* meters per second */
+   float           bearing;                      /* degrees */
+} LocNmeaRmc;
+
+typedef void (* loc_nmea_gga_callback)(const LocNmeaGga *gga);
+typedef void (* loc_nmea_rmc_callback)(const LocNmeaRmc *rmc);
+
+// Called from the deferred action thread, either may be NULL
+typedef struct
+{
+   size_t                size;
+   loc_nmea_gga_callback gga_cb;
+   loc_nmea_rmc_callback rmc_cb;
+} LocNmeaCallbacks;
+
+typedef struct
+{
+   size_t          size;
+   // Registers callbacks for parsed sentences, NULL to remove them
+   void            (*init)(LocNmeaCallbacks *callbacks);
+   // Selects the sentences forwarded to nmea_cb, LOC_NMEA_MASK_* bits
+   void            (*set_mask)(uint32_t mask);
+} LocNmeaInterface;
+
+extern const LocNmeaInterface sLocEngNmeaInterface;
+
+// One field of a sentence, pointing into the sentence
+typedef struct
+{
+   const char     *ptr;
+   int             len;
+} loc_eng_nmea_field_s_type;
+
+#define LOC_ENG_NMEA_MAX_FIELDS          24
+
+// Module data
+typedef struct
+{
+   pthread_mutex_t                lock;
+   uint32_t                       mask;
+   loc_nmea_gga_callback          gga_cb;
+   loc_nmea_rmc_callback          rmc_cb;
+} loc_eng_nmea_data_s_type;
+
+extern void loc_eng_nmea_init();
+extern int  loc_eng_nmea_tokenize(const char *sentence, int length,
+            loc_eng_nmea_field_s_type *fields, int max_fields);
+extern void loc_eng_nmea_report(const char *nmea, int length);
+
+#endif /* LOC_ENG_NMEA_H */
@@ -0,0 +1,287 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netdb.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+/*=============================================================================
+ *
+ *                             DATA DECLARATION
+ *
+ *============================================================================*/
+
+/* Host name cache; entries waiting for the resolver thread are marked queued.
+ * gethostbyname is only ever called from the resolver thread. */
+static loc_eng_resolver_data_s_type loc_eng_resolver_data =
+{
+   PTHREAD_MUTEX_INITIALIZER,
+   PTHREAD_COND_INITIALIZER,
+};
+
+/*===========================================================================
+
+FUNCTION resolve_in_addr
+
+DESCRIPTION
+   Translates a hostname to in_addr struct. Blocks for up to the resolver
+   timeout.
+
+DEPENDENCIES
+   Must be called from the resolver thread
+
+RETURN VALUE
+   TRUE if successful
+
+SIDE EFFECTS
+   n/a
+
+===========================================================================*/
+static boolean resolve_in_addr(const char *host_addr, struct in_addr *in_addr_ptr)
+{
+   struct hostent             *hp;
+   hp = gethostbyname(host_addr);
+   if (hp != NULL) /* DNS OK */
+   {
+      memcpy(in_addr_ptr, hp->h_addr_list[0], hp->h_length);
+   }
+   else
+   {
+      /* IP not valid */
+      LOC_LOGE("DNS query on '%s' failed\n", host_addr);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+/*===========================================================================
+
+FUNCTION loc_eng_resolver_thread
+
+DESCRIPTION
+   Resolves queued host names one at a time and refreshes their cache
+   entries. A failed refresh keeps the stale address.
+
+DEPENDENCIES
+   n/a
+
+RETURN VALUE
+   Never returns
+
+SIDE EFFECTS
+   n/a
+
+===========================================================================*/
+static void* loc_eng_resolver_thread(void *arg)
+{
+   loc_eng_resolver_data_s_type *data = &loc_eng_resolver_data;
+
+   while (1)
+   {
+      loc_eng_resolver_entry_s_type *entry = NULL;
+      char                           hostname[LOC_ENG_RESOLVER_HOST_MAX];
+      struct in_addr                 addr;
+      loc_eng_resolver_cb            cb = NULL;
+      void                          *user_data = NULL;
+      boolean                        notify = FALSE;
+      int                            i;
+
+      pthread_mutex_lock(&data->lock);
+      while (entry == NULL)
+      {
+         for (i = 0; i < LOC_ENG_RESOLVER_CACHE_SIZE && entry == NULL; i++)
+         {
+            if (data->cache[i].in_use && data->cache[i].queued)
+            {
+               entry = &data->cache[i];
+            }
+         }
+         if (entry == NULL)
+         {
+            pthread_cond_wait(&data->cond, &data->lock);
+         }
+      }
+      strlcpy(hostname, entry->hostname, sizeof hostname);
+      pthread_mutex_unlock(&data->lock);
+
+      // Blocking lookup, without holding the cache lock
+      boolean resolved = resolve_in_addr(hostname, &addr);
+
+      pthread_mutex_lock(&data->lock);
+      // The entry stays queued while resolving, so it has not been evicted
+      entry->queued = FALSE;
+      if (resolved)
+      {
+         notify = !entry->resolved || entry->addr.s_addr != addr.s_addr;
+         entry->resolved = TRUE;
+         entry->addr = addr;
+         entry->expire_msec = loc_eng_timer_now_msec() + (long long) gps_conf.AGPS_DNS_TTL * 1000;
+         cb = entry->cb;
+         user_data = entry->user_data;
+      }
+      pthread_mutex_unlock(&data->lock);
+
+      LOC_LOGD("loc_eng_resolver_thread: %s %s\n", hostname,
+            resolved ? inet_ntoa(addr) : "not resolved");
+
+      if (notify && cb != NULL)
+      {
+         cb(hostname, addr, user_data);
+      }
+   }
+
+   return NULL;
+}
+
+/*===========================================================================
+
+FUNCTION loc_eng_resolve
+
+DESCRIPTION
+   Translates a hostname to in_addr struct without blocking. IP addresses
+   in dot notation are converted right away. Otherwise the cached address
+   is returned, even when it is older than AGPS_DNS_TTL; a missing or stale
+   address is (re)resolved on the resolver thread, and cb is called there
+   if the result is new or has changed.
+
+DEPENDENCIES
+   n/a
+
+RETURN VALUE
+   TRUE if an address is returned in addr_ptr
+   FALSE if the caller has to wait for cb
+
+SIDE EFFECTS
+   Starts the resolver thread on first use
+
+===========================================================================*/
+boolean loc_eng_resolve(const char *hostname, struct in_addr *addr_ptr,
+            loc_eng_resolver_cb cb, void *user_data)
+{
+   loc_eng_resolver_data_s_type  *data = &loc_eng_resolver_data;
+   loc_eng_resolver_entry_s_type *entry = NULL;
+   loc_eng_resolver_entry_s_type *free_entry = NULL;
+   loc_eng_resolver_entry_s_type *lru_entry = NULL;
+   long long                      now_msec = loc_eng_timer_now_msec();
+   boolean                        ret_val = FALSE;
+   int                            i;
+
+   /* Try IP representation */
+   if (inet_aton(hostname, addr_ptr) != 0)
+   {
+      return TRUE;
+   }
+
+   pthread_mutex_lock(&data->lock);
+   for (i = 0; i < LOC_ENG_RESOLVER_CACHE_SIZE; i++)
+   {
+      loc_eng_resolver_entry_s_type *cached = &data->cache[i];
+      if (!cached->in_use)
+      {
+         if (free_entry == NULL)
+         {
+            free_entry = cached;
+         }
+      }
+      else if (strcmp(cached->hostname, hostname) == 0)
+      {
+         entry = cached;
+         break;
+      }
+      else if (!cached->queued &&
+               (lru_entry == NULL || cached->last_used_msec < lru_entry->last_used_msec))
+      {
+         lru_entry = cached;
+      }
+   }
+
+   if (entry == NULL)
+   {
+      // Take a free entry, or evict the least recently used one not being resolved
+      entry = (free_entry != NULL) ? free_entry : lru_entry;
+      if (entry == NULL)
+      {
+         pthread_mutex_unlock(&data->lock);
+         LOC_LOGE("loc_eng_resolve: too many lookups in flight, %s dropped\n", hostname);
+         return FALSE;
+      }
+      memset(entry, 0, sizeof *entry);
+      entry->in_use = TRUE;
+      strlcpy(entry->hostname, hostname, sizeof entry->hostname);
+   }
+
+   entry->last_used_msec = now_msec;
+   entry->cb = cb;
+   entry->user_data = user_data;
+
+   if (entry->resolved)
+   {
+      *addr_ptr = entry->addr;
+      ret_val = TRUE;
+   }
+
+   if ((!entry->resolved || now_msec >= entry->expire_msec) && !entry->queued)
+   {
+      entry->queued = TRUE;
+      if (!data->thread_started)
+      {
+         pthread_t      thread;
+         pthread_attr_t attr;
+
+         pthread_attr_init(&attr);
+         pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+         data->thread_started =
+            (pthread_create(&thread, &attr, loc_eng_resolver_thread, NULL) == 0);
+         pthread_attr_destroy(&attr);
+         if (!data->thread_started)
+         {
+            LOC_LOGE("loc_eng_resolve: cannot start the resolver thread\n");
+         }
+      }
+      pthread_cond_signal(&data->cond);
+   }
+   pthread_mutex_unlock(&data->lock);
+
+   return ret_val;
+}
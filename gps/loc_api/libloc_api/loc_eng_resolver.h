@@ -0,0 +1,67 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_RESOLVER_H
+#define LOC_ENG_RESOLVER_H
+
+#include <pthread.h>
+#include <netinet/in.h>
+
+#define LOC_ENG_RESOLVER_CACHE_SIZE      4       /* AGPS hosts remembered */
+#define LOC_ENG_RESOLVER_HOST_MAX        100     /* same as the server address buffers */
+
+// Called on the resolver thread when a host gets its first address or a
+// refresh finds a different one
+typedef void (*loc_eng_resolver_cb)(const char *hostname, struct in_addr addr, void *user_data);
+
+typedef struct
+{
+   boolean                        in_use;
+   char                           hostname[LOC_ENG_RESOLVER_HOST_MAX];
+   boolean                        resolved;      /* addr is set, possibly stale */
+   struct in_addr                 addr;
+   long long                      expire_msec;   /* monotonic, addr is stale after it */
+   long long                      last_used_msec;
+   boolean                        queued;        /* waiting for the resolver thread */
+   loc_eng_resolver_cb            cb;
+   void                          *user_data;
+} loc_eng_resolver_entry_s_type;
+
+typedef struct
+{
+   pthread_mutex_t                lock;
+   pthread_cond_t                 cond;
+   boolean                        thread_started;
+   loc_eng_resolver_entry_s_type  cache[LOC_ENG_RESOLVER_CACHE_SIZE];
+} loc_eng_resolver_data_s_type;
+
+extern boolean loc_eng_resolve(const char *hostname, struct in_addr *addr_ptr,
+            loc_eng_resolver_cb cb, void *user_data);
+
+#endif /* LOC_ENG_RESOLVER_H */
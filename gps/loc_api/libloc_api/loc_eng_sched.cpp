@@ -0,0 +1,674 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include <hardware/gps.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+#ifndef CLOCK_BOOTTIME_ALARM
+#define CLOCK_BOOTTIME_ALARM 9
+#endif
+
+#ifndef EPOLLWAKEUP
+#define EPOLLWAKEUP (1u << 29)
+#endif
+
+// Upper bounds of the TTFF histogram buckets, the last one is open
+static const uint32 loc_eng_sched_ttff_bounds[LOC_ENG_SCHED_TTFF_BUCKETS - 1] =
+{
+   1000, 2000, 5000, 10000, 20000, 30000
+};
+
+/* The session is started and stopped by the framework thread, fixes and the
+ * warm start run on the deferred action thread, protected by the lock. The
+ * lock is never held across loc API calls. */
+static loc_eng_sched_data_s_type loc_eng_sched_data =
+{
+   PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_alarm_thread
+
+DESCRIPTION
+   Waits for the warm start alarm and posts it to the deferred action
+   thread. The alarm wakes the AP from suspend, EPOLLWAKEUP keeps it awake
+   until the posted command has taken its wake lock.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_sched_alarm_thread(void *arg)
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   struct epoll_event event;
+   uint64_t expirations;
+   int n;
+
+   LOC_LOGD("loc_eng_sched_alarm_thread started\n");
+
+   while (1)
+   {
+      n = epoll_wait(sched->alarm_epoll_fd, &event, 1, -1);
+      if (n < 0 && errno == EINTR)
+      {
+         continue;
+      }
+      if (n < 0)
+      {
+         LOC_LOGE("loc_eng_sched_alarm_thread: epoll_wait failed, errno = %d\n", errno);
+         break;
+      }
+      if (n == 1 &&
+          read(sched->alarm_fd, &expirations, sizeof expirations) == sizeof expirations)
+      {
+         loc_eng_cmd_post(LOC_ENG_CMD_SCHED_ALARM);
+      }
+   }
+
+   // No more duty cycling, sessions keep the engine on from now on
+   pthread_mutex_lock(&sched->lock);
+   close(sched->alarm_fd);
+   close(sched->alarm_epoll_fd);
+   sched->alarm_fd = -1;
+   sched->alarm_epoll_fd = -1;
+   sched->cycling = FALSE;
+   pthread_mutex_unlock(&sched->lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_arm
+
+DESCRIPTION
+   Arms the warm start alarm, which runs on CLOCK_BOOTTIME_ALARM and so
+   counts the time spent in suspend and wakes the AP when it expires.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   TRUE if armed
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static boolean loc_eng_sched_arm(long long msec)
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   struct itimerspec alarm_time;
+
+   memset(&alarm_time, 0, sizeof alarm_time);
+   alarm_time.it_value.tv_sec = (time_t) (msec / 1000);
+   alarm_time.it_value.tv_nsec = (long) (msec % 1000) * 1000000;
+   if (sched->alarm_fd < 0 || timerfd_settime(sched->alarm_fd, 0, &alarm_time, NULL) != 0)
+   {
+      LOC_LOGE("loc_eng_sched_arm: cannot arm the warm start alarm, errno = %d\n", errno);
+      return FALSE;
+   }
+
+   sched->alarm_armed = TRUE;
+   return TRUE;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_disarm
+
+DESCRIPTION
+   Cancels the warm start alarm.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_sched_disarm()
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   struct itimerspec alarm_time;
+
+   if (sched->alarm_armed)
+   {
+      memset(&alarm_time, 0, sizeof alarm_time);
+      timerfd_settime(sched->alarm_fd, 0, &alarm_time, NULL);
+      sched->alarm_armed = FALSE;
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_predict_ttff
+
+DESCRIPTION
+   Predicts the TTFF of the next warm start from the history, pessimistically.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   TTFF in msec
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static uint32 loc_eng_sched_predict_ttff()
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   uint32 ttff = 0;
+   int i;
+
+   if (sched->ttff_count == 0)
+   {
+      return LOC_ENG_SCHED_DEFAULT_TTFF_MSEC;
+   }
+
+   // Newest samples first, ttff_count of them
+   for (i = 0; i < sched->ttff_count; i++)
+   {
+      int index = (sched->ttff_next - 1 - i + LOC_ENG_SCHED_TTFF_HISTORY) %
+                  LOC_ENG_SCHED_TTFF_HISTORY;
+      if (sched->ttff_msec[index] > ttff)
+      {
+         ttff = sched->ttff_msec[index];
+      }
+   }
+
+   return ttff;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_add_ttff
+
+DESCRIPTION
+   Adds a TTFF sample to the history and the session histogram.
+
+DEPENDENCIES
+   Lock held
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_sched_add_ttff(uint32 ttff)
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   int bucket;
+
+   sched->ttff_msec[sched->ttff_next] = ttff;
+   sched->ttff_next = (sched->ttff_next + 1) % LOC_ENG_SCHED_TTFF_HISTORY;
+   if (sched->ttff_count < LOC_ENG_SCHED_TTFF_HISTORY)
+   {
+      sched->ttff_count++;
+   }
+
+   for (bucket = 0; bucket < LOC_ENG_SCHED_TTFF_BUCKETS - 1; bucket++)
+   {
+      if (ttff < loc_eng_sched_ttff_bounds[bucket])
+      {
+         break;
+      }
+   }
+   sched->stats.ttff_histogram[bucket]++;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_init
+
+DESCRIPTION
+   Creates the warm start alarm and the thread waiting for it. Without them,
+   for instance when the kernel has no CLOCK_BOOTTIME_ALARM, sessions are
+   not duty cycled.
+
+DEPENDENCIES
+   Called once from loc_eng_init
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_sched_init(gps_create_thread create_thread_cb)
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   struct epoll_event event;
+
+   sched->alarm_fd = timerfd_create(CLOCK_BOOTTIME_ALARM, 0);
+   sched->alarm_epoll_fd = sched->alarm_fd < 0 ? -1 : epoll_create(1);
+   if (sched->alarm_epoll_fd >= 0)
+   {
+      memset(&event, 0, sizeof event);
+      event.events = EPOLLIN | EPOLLWAKEUP;
+      event.data.fd = sched->alarm_fd;
+      if (epoll_ctl(sched->alarm_epoll_fd, EPOLL_CTL_ADD, sched->alarm_fd, &event) != 0 ||
+          create_thread_cb("loc_sched", loc_eng_sched_alarm_thread, NULL) == 0)
+      {
+         close(sched->alarm_epoll_fd);
+         sched->alarm_epoll_fd = -1;
+      }
+   }
+
+   if (sched->alarm_epoll_fd < 0)
+   {
+      LOC_LOGE("loc_eng_sched_init: no wakeup alarm, errno = %d, duty cycling disabled\n", errno);
+      if (sched->alarm_fd >= 0)
+      {
+         close(sched->alarm_fd);
+         sched->alarm_fd = -1;
+      }
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_start
+
+DESCRIPTION
+   Starts scheduling a session whose first fix has just been requested.
+   Periodic sessions with intervals of DUTY_CYCLE_INTERVAL seconds or more
+   turn the engine off between fixes.
+
+DEPENDENCIES
+   Called from loc_eng_start after loc_start_fix succeeded
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_sched_start(const rpc_loc_fix_criteria_s_type *fix_criteria)
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   long long now_msec = loc_eng_timer_now_msec();
+
+   pthread_mutex_lock(&sched->lock);
+
+   memset(&sched->stats, 0, sizeof sched->stats);
+   sched->stats.start_msec = now_msec;
+   sched->stats.on_since_msec = now_msec;
+
+   sched->running = TRUE;
+   sched->engine_on = TRUE;
+   sched->waiting_fix = TRUE;
+   sched->engine_start_msec = now_msec;
+   sched->session++;
+   loc_eng_sched_disarm();
+   sched->interval_msec = fix_criteria->min_interval;
+   sched->cycling = sched->alarm_fd >= 0 && gps_conf.DUTY_CYCLE_INTERVAL > 0 &&
+                    fix_criteria->recurrence_type == RPC_LOC_PERIODIC_FIX &&
+                    fix_criteria->min_interval >= gps_conf.DUTY_CYCLE_INTERVAL * 1000;
+
+   LOC_LOGD("loc_eng_sched_start: interval %u msec, duty cycling %d\n",
+         sched->interval_msec, sched->cycling);
+
+   pthread_mutex_unlock(&sched->lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_stop
+
+DESCRIPTION
+   Stops scheduling and logs the session statistics.
+
+DEPENDENCIES
+   Called from loc_eng_stop
+
+RETURN VALUE
+   TRUE if the scheduler has turned the engine off, so there is no fix
+   session to stop on the modem
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_sched_stop()
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   loc_eng_sched_stats_s_type *stats = &sched->stats;
+   long long now_msec = loc_eng_timer_now_msec();
+   long long session_msec;
+   boolean   engine_off;
+
+   pthread_mutex_lock(&sched->lock);
+
+   if (!sched->running)
+   {
+      pthread_mutex_unlock(&sched->lock);
+      return FALSE;
+   }
+
+   engine_off = !sched->engine_on;
+   loc_eng_sched_disarm();
+   sched->running = FALSE;
+   sched->cycling = FALSE;
+
+   if (stats->on_since_msec != 0)
+   {
+      stats->on_msec += now_msec - stats->on_since_msec;
+      stats->on_since_msec = 0;
+   }
+   session_msec = now_msec - stats->start_msec;
+
+   LOC_LOGI("loc_eng_sched: session %lld msec, engine on %lld msec (%d%%), %u fixes, "
+         "%u cycles, %u kept on\n", session_msec, stats->on_msec,
+         session_msec > 0 ? (int) (stats->on_msec * 100 / session_msec) : 100,
+         stats->fixes, stats->cycles, stats->kept_on);
+   LOC_LOGI("loc_eng_sched: TTFF <1s %u, <2s %u, <5s %u, <10s %u, <20s %u, <30s %u, >=30s %u\n",
+         stats->ttff_histogram[0], stats->ttff_histogram[1], stats->ttff_histogram[2],
+         stats->ttff_histogram[3], stats->ttff_histogram[4], stats->ttff_histogram[5],
+         stats->ttff_histogram[6]);
+
+   pthread_mutex_unlock(&sched->lock);
+
+   return engine_off;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_fix
+
+DESCRIPTION
+   Accounts for a reported fix. When duty cycling, the engine is turned off
+   until the TTFF predicted from the history, plus a margin, before the
+   next fix is due. If that leaves less than LOC_ENG_SCHED_MIN_OFF_MSEC off,
+   the engine stays on and the oldest TTFF sample is dropped, so that a
+   poor history does not keep it on for good.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_sched_fix()
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   long long now_msec, off_msec;
+   uint32    session;
+   boolean   restart;
+   int       rc;
+
+   pthread_mutex_lock(&sched->lock);
+
+   if (!sched->running || !sched->engine_on)
+   {
+      pthread_mutex_unlock(&sched->lock);
+      return;
+   }
+
+   now_msec = loc_eng_timer_now_msec();
+   sched->stats.fixes++;
+
+   if (sched->waiting_fix)
+   {
+      sched->waiting_fix = FALSE;
+      loc_eng_sched_add_ttff((uint32) (now_msec - sched->engine_start_msec));
+   }
+
+   if (!sched->cycling)
+   {
+      pthread_mutex_unlock(&sched->lock);
+      return;
+   }
+
+   sched->deadline_msec = now_msec + sched->interval_msec;
+   off_msec = (long long) sched->interval_msec - loc_eng_sched_predict_ttff() -
+              LOC_ENG_SCHED_MARGIN_MSEC;
+   if (off_msec < LOC_ENG_SCHED_MIN_OFF_MSEC || !loc_eng_sched_arm(off_msec))
+   {
+      sched->stats.kept_on++;
+      if (sched->ttff_count > 0)
+      {
+         sched->ttff_count--; /* forget the oldest sample */
+      }
+      pthread_mutex_unlock(&sched->lock);
+      return;
+   }
+
+   // The engine counts as off from here, so that loc_eng_stop does not stop
+   // the fix session again while it is being stopped
+   sched->engine_on = FALSE;
+   session = sched->session;
+   pthread_mutex_unlock(&sched->lock);
+
+   rc = loc_stop_fix(loc_eng_data.client_handle);
+
+   pthread_mutex_lock(&sched->lock);
+
+   if (session != sched->session)
+   {
+      // Stopped and started again meanwhile, the new fix session may have
+      // reached the modem before this stop did
+      restart = sched->running && sched->engine_on && rc == RPC_LOC_API_SUCCESS;
+      pthread_mutex_unlock(&sched->lock);
+      if (restart)
+      {
+         loc_start_fix(loc_eng_data.client_handle);
+      }
+      return;
+   }
+
+   if (!sched->running)
+   {
+      pthread_mutex_unlock(&sched->lock);
+      return;
+   }
+
+   if (rc != RPC_LOC_API_SUCCESS)
+   {
+      LOC_LOGE("loc_eng_sched_fix: loc_stop_fix failed, engine stays on\n");
+      loc_eng_sched_disarm();
+      sched->engine_on = TRUE;
+      pthread_mutex_unlock(&sched->lock);
+      return;
+   }
+
+   // The alarm wakes the AP for the warm start, nothing holds a wake lock
+   // while the engine is off
+   LOC_LOGD("loc_eng_sched_fix: engine off for %lld msec\n", off_msec);
+   sched->stats.cycles++;
+   sched->stats.on_msec += now_msec - sched->stats.on_since_msec;
+   sched->stats.on_since_msec = 0;
+
+   pthread_mutex_unlock(&sched->lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_warm_start
+
+DESCRIPTION
+   Turns the engine back on ahead of the next fix, when the warm start
+   alarm has expired.
+
+DEPENDENCIES
+   Called on the deferred action thread for LOC_ENG_CMD_SCHED_ALARM
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_sched_warm_start()
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   long long now_msec;
+   uint32    session;
+   boolean   stop;
+   int       rc;
+
+   pthread_mutex_lock(&sched->lock);
+
+   if (!sched->running || sched->engine_on || !sched->alarm_armed)
+   {
+      pthread_mutex_unlock(&sched->lock);
+      return;
+   }
+
+   // The engine counts as on from here, so that loc_eng_stop stops the fix
+   // session being started
+   now_msec = loc_eng_timer_now_msec();
+   sched->alarm_armed = FALSE;
+   sched->engine_on = TRUE;
+   sched->waiting_fix = TRUE;
+   sched->engine_start_msec = now_msec;
+   sched->stats.on_since_msec = now_msec;
+   session = sched->session;
+   pthread_mutex_unlock(&sched->lock);
+
+   rc = loc_start_fix(loc_eng_data.client_handle);
+
+   pthread_mutex_lock(&sched->lock);
+
+   if (session != sched->session || !sched->running)
+   {
+      // Stopped meanwhile, loc_eng_stop may have stopped the fix session
+      // before this start reached the modem
+      stop = !sched->running && rc == RPC_LOC_API_SUCCESS;
+      pthread_mutex_unlock(&sched->lock);
+      if (stop)
+      {
+         loc_stop_fix(loc_eng_data.client_handle);
+      }
+      return;
+   }
+
+   if (rc != RPC_LOC_API_SUCCESS)
+   {
+      LOC_LOGE("loc_eng_sched_warm_start: loc_start_fix failed, retrying\n");
+      sched->engine_on = FALSE;
+      sched->waiting_fix = FALSE;
+      sched->stats.on_since_msec = 0;
+      loc_eng_sched_arm(LOC_ENG_SCHED_MARGIN_MSEC);
+      pthread_mutex_unlock(&sched->lock);
+      return;
+   }
+
+   LOC_LOGD("loc_eng_sched_warm_start: %lld msec before the deadline\n",
+         sched->deadline_msec - now_msec);
+
+   pthread_mutex_unlock(&sched->lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_cycling
+
+DESCRIPTION
+   Tells whether the scheduler has turned the engine off in this session.
+   Engine and session status changes are then its own doing and are not
+   reported to the framework, which sees one session from start to stop.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   TRUE if duty cycling has begun
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_sched_cycling()
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   boolean cycling;
+
+   pthread_mutex_lock(&sched->lock);
+   cycling = sched->running && sched->cycling && sched->stats.cycles > 0;
+   pthread_mutex_unlock(&sched->lock);
+
+   return cycling;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sched_duty_cycled
+
+DESCRIPTION
+   Tells whether the session is duty cycled, so that each fix has to reach
+   loc_eng_sched_fix as it comes, even while fixes are batched.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   TRUE if the running session turns the engine off between fixes
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_sched_duty_cycled()
+{
+   loc_eng_sched_data_s_type *sched = &loc_eng_sched_data;
+   boolean duty_cycled;
+
+   pthread_mutex_lock(&sched->lock);
+   duty_cycled = sched->running && sched->cycling;
+   pthread_mutex_unlock(&sched->lock);
+
+   return duty_cycled;
+}
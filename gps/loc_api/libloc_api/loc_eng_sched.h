@@ -0,0 +1,85 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_SCHED_H
+#define LOC_ENG_SCHED_H
+
+#include <hardware/gps.h>
+
+#define LOC_ENG_SCHED_TTFF_HISTORY       8       /* TTFF samples kept */
+#define LOC_ENG_SCHED_DEFAULT_TTFF_MSEC  30000   /* assumed before the first fix */
+#define LOC_ENG_SCHED_MARGIN_MSEC        2000    /* warm start this much earlier */
+#define LOC_ENG_SCHED_MIN_OFF_MSEC       10000   /* shorter off times keep the engine on */
+#define LOC_ENG_SCHED_TTFF_BUCKETS       7       /* <1 <2 <5 <10 <20 <30 >=30 s */
+
+// Per-session statistics, logged when the session stops
+typedef struct
+{
+   long long                      start_msec;
+   long long                      on_msec;       /* engine on time, until on_since_msec */
+   long long                      on_since_msec; /* 0 while the engine is off */
+   uint32                         fixes;
+   uint32                         cycles;        /* engine turned off between fixes */
+   uint32                         kept_on;       /* fixes after which the engine stayed on */
+   uint32                         ttff_histogram[LOC_ENG_SCHED_TTFF_BUCKETS];
+} loc_eng_sched_stats_s_type;
+
+// Module data
+typedef struct
+{
+   pthread_mutex_t                lock;
+   boolean                        running;       /* between loc_eng_start and loc_eng_stop */
+   boolean                        cycling;       /* duty cycling this session */
+   boolean                        engine_on;     /* fix session started on the modem */
+   boolean                        waiting_fix;   /* engine started, no fix yet */
+   uint32                         interval_msec;
+   long long                      engine_start_msec;
+   long long                      deadline_msec; /* when the next fix is due */
+   uint32                         session;       /* counts loc_eng_sched_start calls */
+
+   int                            alarm_fd;      /* CLOCK_BOOTTIME_ALARM timerfd, -1 if none */
+   int                            alarm_epoll_fd;
+   boolean                        alarm_armed;   /* warm start pending */
+
+   uint32                         ttff_msec[LOC_ENG_SCHED_TTFF_HISTORY];
+   int                            ttff_count;
+   int                            ttff_next;
+
+   loc_eng_sched_stats_s_type     stats;
+} loc_eng_sched_data_s_type;
+
+extern void    loc_eng_sched_init(gps_create_thread create_thread_cb);
+extern void    loc_eng_sched_start(const rpc_loc_fix_criteria_s_type *fix_criteria);
+extern boolean loc_eng_sched_stop();
+extern void    loc_eng_sched_fix();
+extern void    loc_eng_sched_warm_start();
+extern boolean loc_eng_sched_cycling();
+extern boolean loc_eng_sched_duty_cycled();
+
+#endif /* LOC_ENG_SCHED_H */
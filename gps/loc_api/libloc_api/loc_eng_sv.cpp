@@ -0,0 +1,262 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <hardware/gps.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+static void loc_eng_sv_init(LocSvCallbacks *callbacks);
+static int  loc_eng_sv_get_table(LocSvTable *table);
+
+const LocSvInterface sLocEngSvInterface =
+{
+   sizeof(LocSvInterface),
+   loc_eng_sv_init,
+   loc_eng_sv_get_table,
+};
+
+/* Written by the deferred action thread, read by extension users, protected
+ * by the lock */
+static loc_eng_sv_data_s_type loc_eng_sv_data =
+{
+   PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*===========================================================================
+FUNCTION    loc_eng_sv_init
+
+DESCRIPTION
+   Registers the callbacks of the satellite extension.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_sv_init(LocSvCallbacks *callbacks)
+{
+   pthread_mutex_lock(&loc_eng_sv_data.lock);
+   loc_eng_sv_data.sv_table_cb = (callbacks != NULL) ? callbacks->sv_table_cb : NULL;
+   pthread_mutex_unlock(&loc_eng_sv_data.lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sv_get_table
+
+DESCRIPTION
+   Copies the satellite table of the latest report.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+   -1: no satellite report yet
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_eng_sv_get_table(LocSvTable *table)
+{
+   int ret_val = -1;
+
+   pthread_mutex_lock(&loc_eng_sv_data.lock);
+   if (loc_eng_sv_data.table_valid)
+   {
+      memcpy(table, &loc_eng_sv_data.table, sizeof(LocSvTable));
+      ret_val = 0;
+   }
+   pthread_mutex_unlock(&loc_eng_sv_data.lock);
+
+   return ret_val;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_sv_update
+
+DESCRIPTION
+   Rebuilds the satellite table from a modem report, with the masks of each
+   constellation in its own numbering, and passes it to the extension
+   callback. Unlike the framework report this is never throttled.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_sv_update(const rpc_loc_gnss_info_s_type *gnss_report_ptr)
+{
+   LocSvTable                    table;
+   LocSvInfo                    *sv_ptr;
+   LocSvSystemMasks             *masks;
+   const rpc_loc_sv_info_s_type *sv_info_ptr;
+   loc_sv_table_callback         sv_table_cb;
+   uint32_t                      bit;
+   int                           num_svs_max, i, n;
+
+   memset(&table, 0, offsetof(LocSvTable, sv_list));
+   table.size = sizeof(LocSvTable);
+   table.timestamp = (GpsUtcTime) time(NULL) * 1000;
+
+   if (gnss_report_ptr->valid_mask & RPC_LOC_GNSS_INFO_VALID_POS_DOP)
+   {
+      table.position_dop = gnss_report_ptr->position_dop;
+   }
+   if (gnss_report_ptr->valid_mask & RPC_LOC_GNSS_INFO_VALID_HOR_DOP)
+   {
+      table.horizontal_dop = gnss_report_ptr->horizontal_dop;
+   }
+   if (gnss_report_ptr->valid_mask & RPC_LOC_GNSS_INFO_VALID_VERT_DOP)
+   {
+      table.vertical_dop = gnss_report_ptr->vertical_dop;
+   }
+
+   num_svs_max = 0;
+   if ((gnss_report_ptr->valid_mask & RPC_LOC_GNSS_INFO_VALID_SV_COUNT) &&
+       (gnss_report_ptr->valid_mask & RPC_LOC_GNSS_INFO_VALID_SV_LIST))
+   {
+      num_svs_max = gnss_report_ptr->sv_count;
+      if (num_svs_max > (int) gnss_report_ptr->sv_list.sv_list_len)
+      {
+         num_svs_max = gnss_report_ptr->sv_list.sv_list_len;
+      }
+      if (num_svs_max > LOC_SV_MAX_SVS)
+      {
+         num_svs_max = LOC_SV_MAX_SVS;
+      }
+   }
+
+   for (i = 0; i < num_svs_max; i++)
+   {
+      sv_info_ptr = &(gnss_report_ptr->sv_list.sv_list_val[i]);
+      if (!(sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_SYSTEM) ||
+          !(sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_PRN))
+      {
+         continue;
+      }
+
+      sv_ptr = &table.sv_list[table.num_svs];
+      switch (sv_info_ptr->system)
+      {
+      case RPC_LOC_SV_SYSTEM_GPS:
+         sv_ptr->system = LOC_SV_SYSTEM_GPS;
+         n = sv_info_ptr->prn;
+         break;
+      case RPC_LOC_SV_SYSTEM_SBAS:
+         sv_ptr->system = LOC_SV_SYSTEM_SBAS;
+         n = sv_info_ptr->prn - 119;
+         break;
+      case RPC_LOC_SV_SYSTEM_GLONASS:
+         sv_ptr->system = LOC_SV_SYSTEM_GLONASS;
+         n = sv_info_ptr->prn;
+         break;
+      default:
+         continue; /* unsupported SV system */
+      }
+      if (n < 1 || n > 32)
+      {
+         continue;
+      }
+
+      sv_ptr->prn = sv_info_ptr->prn;
+      sv_ptr->flags = 0;
+      sv_ptr->snr = (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_SNR) ?
+         sv_info_ptr->snr : 0;
+      sv_ptr->elevation = (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_ELEVATION) ?
+         sv_info_ptr->elevation : 0;
+      sv_ptr->azimuth = (sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_AZIMUTH) ?
+         sv_info_ptr->azimuth : 0;
+
+      masks = &table.masks[sv_ptr->system];
+      bit = 1 << (n - 1);
+      masks->visible_mask |= bit;
+
+      if ((sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_HAS_EPH) &&
+          (sv_info_ptr->has_eph == 1))
+      {
+         sv_ptr->flags |= LOC_SV_HAS_EPHEMERIS;
+         masks->ephemeris_mask |= bit;
+      }
+
+      if ((sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_HAS_ALM) &&
+          (sv_info_ptr->has_alm == 1))
+      {
+         sv_ptr->flags |= LOC_SV_HAS_ALMANAC;
+         masks->almanac_mask |= bit;
+      }
+
+      // Same rule as the GPS used-in-fix mask reported to the framework
+      if ((sv_info_ptr->valid_mask & RPC_LOC_SV_INFO_VALID_PROCESS_STATUS) &&
+          (sv_info_ptr->process_status == RPC_LOC_SV_STATUS_TRACK))
+      {
+         sv_ptr->flags |= LOC_SV_USED_IN_FIX;
+         masks->used_in_fix_mask |= bit;
+      }
+
+      table.num_svs++;
+   }
+
+   pthread_mutex_lock(&loc_eng_sv_data.lock);
+   memcpy(&loc_eng_sv_data.table, &table,
+         offsetof(LocSvTable, sv_list) + table.num_svs * sizeof(LocSvInfo));
+   loc_eng_sv_data.table_valid = TRUE;
+   sv_table_cb = loc_eng_sv_data.sv_table_cb;
+   pthread_mutex_unlock(&loc_eng_sv_data.lock);
+
+   if (sv_table_cb != NULL)
+   {
+      sv_table_cb(&table);
+   }
+}
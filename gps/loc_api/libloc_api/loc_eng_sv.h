@@ -0,0 +1,115 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_SV_H
+#define LOC_ENG_SV_H
+
+#include <hardware/gps.h>
+
+#define LOC_SV_MAX_SVS                   64      /* satellites kept per report */
+
+// Extension giving the satellites of all constellations, see loc_eng_get_extension
+#define LOC_SV_INTERFACE                 "loc-sv"
+
+typedef enum
+{
+   LOC_SV_SYSTEM_GPS = 0,                        /* PRN 1-32 */
+   LOC_SV_SYSTEM_SBAS,                           /* PRN 120-151 */
+   LOC_SV_SYSTEM_GLONASS,                        /* slot 1-32 */
+   LOC_SV_SYSTEM_MAX
+} LocSvSystem;
+
+// Flags of LocSvInfo
+#define LOC_SV_HAS_EPHEMERIS             0x01
+#define LOC_SV_HAS_ALMANAC               0x02
+#define LOC_SV_USED_IN_FIX               0x04
+
+typedef struct
+{
+   LocSvSystem     system;
+   int             prn;                          /* numbered as in LocSvSystem */
+   uint16_t        flags;
+   float           snr;
+   float           elevation;
+   float           azimuth;
+} LocSvInfo;
+
+// Bit n-1 stands for satellite n of the constellation, n as in LocSvSystem
+typedef struct
+{
+   uint32_t        visible_mask;
+   uint32_t        ephemeris_mask;
+   uint32_t        almanac_mask;
+   uint32_t        used_in_fix_mask;
+} LocSvSystemMasks;
+
+typedef struct
+{
+   size_t          size;
+   GpsUtcTime      timestamp;                    /* system time of the report */
+   float           position_dop;                 /* 0 if not known */
+   float           horizontal_dop;
+   float           vertical_dop;
+   LocSvSystemMasks masks[LOC_SV_SYSTEM_MAX];
+   int             num_svs;
+   LocSvInfo       sv_list[LOC_SV_MAX_SVS];
+} LocSvTable;
+
+// Called on every satellite report of the modem, from the deferred action thread
+typedef void (* loc_sv_table_callback)(const LocSvTable *table);
+
+typedef struct
+{
+   size_t                size;
+   loc_sv_table_callback sv_table_cb;
+} LocSvCallbacks;
+
+typedef struct
+{
+   size_t          size;
+   // Registers callbacks, NULL to remove them
+   void            (*init)(LocSvCallbacks *callbacks);
+   // Copies the latest satellite table, returns -1 before the first report
+   int             (*get_sv_table)(LocSvTable *table);
+} LocSvInterface;
+
+extern const LocSvInterface sLocEngSvInterface;
+
+// Module data
+typedef struct
+{
+   pthread_mutex_t                lock;
+   loc_sv_table_callback          sv_table_cb;
+   boolean                        table_valid;
+   LocSvTable                     table;
+} loc_eng_sv_data_s_type;
+
+extern void loc_eng_sv_update(const rpc_loc_gnss_info_s_type *gnss_report_ptr);
+
+#endif /* LOC_ENG_SV_H */
@@ -0,0 +1,462 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+/*=============================================================================
+ *
+ *                             DATA DECLARATION
+ *
+ *============================================================================*/
+
+/* Hashed timer wheel: timers are chained into the slot of their expiry tick,
+ * so processing a tick only visits the timers that may be due in it */
+static loc_eng_timer_data_s_type loc_eng_timer_data =
+{
+   PTHREAD_MUTEX_INITIALIZER,
+};
+
+#define TIMER_INDEX(timer_id)   ((timer_id) & 0xFF)
+#define TIMER_SLOT(tick)        ((int) ((tick) & (LOC_ENG_TIMER_WHEEL_SLOTS - 1)))
+
+/*===========================================================================
+FUNCTION    loc_eng_timer_now_msec
+
+DESCRIPTION
+   Reads the monotonic clock, which is not affected by wall-clock changes.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Milliseconds since an arbitrary point in the past
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+long long loc_eng_timer_now_msec()
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cond_init_monotonic
+
+DESCRIPTION
+   Initializes a condition variable whose timed waits use the monotonic
+   clock, see loc_eng_cond_timedwait_monotonic.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_cond_init_monotonic(pthread_cond_t *cond)
+{
+#ifdef HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC
+   pthread_cond_init(cond, NULL);
+#else
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(cond, &attr);
+   pthread_condattr_destroy(&attr);
+#endif
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_cond_timedwait_monotonic
+
+DESCRIPTION
+   Waits on a condition variable until an absolute CLOCK_MONOTONIC time.
+
+DEPENDENCIES
+   cond was initialized by loc_eng_cond_init_monotonic
+
+RETURN VALUE
+   0 if signalled, ETIMEDOUT on expiry
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_cond_timedwait_monotonic(pthread_cond_t *cond, pthread_mutex_t *mutex,
+            const struct timespec *expire_time)
+{
+#ifdef HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC
+   return pthread_cond_timedwait_monotonic_np(cond, mutex, expire_time);
+#else
+   return pthread_cond_timedwait(cond, mutex, expire_time);
+#endif
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_timer_init
+
+DESCRIPTION
+   Disarms all timers. Called from loc_eng_init before the deferred action
+   thread is started.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_timer_init()
+{
+   int i;
+
+   pthread_mutex_lock(&loc_eng_timer_data.lock);
+
+   loc_eng_timer_data.last_tick = loc_eng_timer_now_msec() / LOC_ENG_TIMER_TICK_MSEC;
+   for (i = 0; i < LOC_ENG_TIMER_WHEEL_SLOTS; i++)
+   {
+      loc_eng_timer_data.wheel[i] = -1;
+   }
+   memset(loc_eng_timer_data.timers, 0, sizeof loc_eng_timer_data.timers);
+
+   pthread_mutex_unlock(&loc_eng_timer_data.lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_timer_unlink
+
+DESCRIPTION
+   Removes a timer from its wheel slot.
+
+DEPENDENCIES
+   loc_eng_timer_data.lock is held
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_timer_unlink(int index)
+{
+   int *link = &loc_eng_timer_data.wheel[TIMER_SLOT(loc_eng_timer_data.timers[index].expire_tick)];
+
+   while (*link >= 0)
+   {
+      if (*link == index)
+      {
+         *link = loc_eng_timer_data.timers[index].next;
+         break;
+      }
+      link = &loc_eng_timer_data.timers[*link].next;
+   }
+
+   loc_eng_timer_data.timers[index].in_use = FALSE;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_timer_start
+
+DESCRIPTION
+   Arms a one-shot timer. The callback is called on the deferred action
+   thread once timeout_msec has elapsed on the monotonic clock, with a
+   resolution of LOC_ENG_TIMER_TICK_MSEC. May be called from any thread.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Timer ID to pass to loc_eng_timer_stop
+   LOC_ENG_TIMER_INVALID if all timers are in use
+
+SIDE EFFECTS
+   Wakes up the deferred action thread so it can shorten its wait
+
+===========================================================================*/
+int loc_eng_timer_start(uint32 timeout_msec, loc_eng_timer_cb cb, void *user_data)
+{
+   long long expire_tick;
+   int timer_id = LOC_ENG_TIMER_INVALID;
+   int i;
+
+   expire_tick = (loc_eng_timer_now_msec() + timeout_msec + LOC_ENG_TIMER_TICK_MSEC - 1) /
+         LOC_ENG_TIMER_TICK_MSEC;
+
+   pthread_mutex_lock(&loc_eng_timer_data.lock);
+
+   for (i = 0; i < LOC_ENG_TIMER_MAX; i++)
+   {
+      loc_eng_timer_s_type *timer = &loc_eng_timer_data.timers[i];
+      if (timer->in_use) continue;
+
+      // Ticks already processed would only be visited again after a full turn
+      if (expire_tick <= loc_eng_timer_data.last_tick)
+      {
+         expire_tick = loc_eng_timer_data.last_tick + 1;
+      }
+
+      loc_eng_timer_data.generation = (loc_eng_timer_data.generation + 1) & 0x7FFFFF;
+      if (loc_eng_timer_data.generation == 0) loc_eng_timer_data.generation = 1;
+
+      timer_id = (loc_eng_timer_data.generation << 8) | i;
+      timer->in_use = TRUE;
+      timer->timer_id = timer_id;
+      timer->expire_tick = expire_tick;
+      timer->cb = cb;
+      timer->user_data = user_data;
+      timer->next = loc_eng_timer_data.wheel[TIMER_SLOT(expire_tick)];
+      loc_eng_timer_data.wheel[TIMER_SLOT(expire_tick)] = i;
+      break;
+   }
+
+   pthread_mutex_unlock(&loc_eng_timer_data.lock);
+
+   if (timer_id == LOC_ENG_TIMER_INVALID)
+   {
+      LOC_LOGE("loc_eng_timer_start: all %d timers in use\n", LOC_ENG_TIMER_MAX);
+      return timer_id;
+   }
+
+   LOC_LOGV("loc_eng_timer_start: timer 0x%X in %u ms\n", timer_id, timeout_msec);
+
+   pthread_mutex_lock(&loc_eng_data.deferred_action_mutex);
+   pthread_cond_signal(&loc_eng_data.deferred_action_cond);
+   pthread_mutex_unlock(&loc_eng_data.deferred_action_mutex);
+
+   return timer_id;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_timer_stop
+
+DESCRIPTION
+   Disarms a timer. Stopping a timer that has already fired or was never
+   started is harmless.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_timer_stop(int timer_id)
+{
+   if (timer_id == LOC_ENG_TIMER_INVALID) return;
+
+   pthread_mutex_lock(&loc_eng_timer_data.lock);
+
+   int index = TIMER_INDEX(timer_id);
+   if (index < LOC_ENG_TIMER_MAX &&
+       loc_eng_timer_data.timers[index].in_use &&
+       loc_eng_timer_data.timers[index].timer_id == timer_id)
+   {
+      loc_eng_timer_unlink(index);
+   }
+
+   pthread_mutex_unlock(&loc_eng_timer_data.lock);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_timer_next_expire
+
+DESCRIPTION
+   Finds when the deferred action thread has to wake up for the next timer.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   TRUE                 if a timer is armed, expire_time is set (CLOCK_MONOTONIC)
+   FALSE                if no timer is armed
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+boolean loc_eng_timer_next_expire(struct timespec *expire_time)
+{
+   long long next_tick = 0;
+   boolean found = FALSE;
+   int i;
+
+   pthread_mutex_lock(&loc_eng_timer_data.lock);
+   for (i = 0; i < LOC_ENG_TIMER_MAX; i++)
+   {
+      const loc_eng_timer_s_type *timer = &loc_eng_timer_data.timers[i];
+      if (timer->in_use && (!found || timer->expire_tick < next_tick))
+      {
+         next_tick = timer->expire_tick;
+         found = TRUE;
+      }
+   }
+   pthread_mutex_unlock(&loc_eng_timer_data.lock);
+
+   if (found)
+   {
+      long long expire_msec = next_tick * LOC_ENG_TIMER_TICK_MSEC;
+      expire_time->tv_sec  = expire_msec / 1000;
+      expire_time->tv_nsec = (expire_msec % 1000) * 1000000;
+   }
+
+   return found;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_timer_armed
+
+DESCRIPTION
+   Counts the timers currently armed.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Number of timers armed
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_timer_armed()
+{
+   int count = 0;
+   int i;
+
+   pthread_mutex_lock(&loc_eng_timer_data.lock);
+   for (i = 0; i < LOC_ENG_TIMER_MAX; i++)
+   {
+      if (loc_eng_timer_data.timers[i].in_use)
+      {
+         count++;
+      }
+   }
+   pthread_mutex_unlock(&loc_eng_timer_data.lock);
+
+   return count;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_timer_process
+
+DESCRIPTION
+   Advances the wheel to the current tick and runs the callbacks of all
+   timers that are due.
+
+DEPENDENCIES
+   Must be called from the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_timer_process()
+{
+   loc_eng_timer_cb fired_cb[LOC_ENG_TIMER_MAX];
+   void            *fired_data[LOC_ENG_TIMER_MAX];
+   int              num_fired = 0;
+   long long        now_tick, tick;
+   int              i;
+
+   now_tick = loc_eng_timer_now_msec() / LOC_ENG_TIMER_TICK_MSEC;
+
+   pthread_mutex_lock(&loc_eng_timer_data.lock);
+
+   tick = loc_eng_timer_data.last_tick + 1;
+   if (now_tick - tick >= LOC_ENG_TIMER_WHEEL_SLOTS)
+   {
+      // Slept for more than a turn, every slot has to be visited once
+      tick = now_tick - LOC_ENG_TIMER_WHEEL_SLOTS + 1;
+   }
+
+   for (; tick <= now_tick; tick++)
+   {
+      int index = loc_eng_timer_data.wheel[TIMER_SLOT(tick)];
+      while (index >= 0)
+      {
+         loc_eng_timer_s_type *timer = &loc_eng_timer_data.timers[index];
+         int next = timer->next;
+         if (timer->expire_tick <= now_tick)
+         {
+            fired_cb[num_fired] = timer->cb;
+            fired_data[num_fired] = timer->user_data;
+            num_fired++;
+            loc_eng_timer_unlink(index);
+         }
+         index = next;
+      }
+   }
+
+   if (now_tick > loc_eng_timer_data.last_tick)
+   {
+      loc_eng_timer_data.last_tick = now_tick;
+   }
+
+   pthread_mutex_unlock(&loc_eng_timer_data.lock);
+
+   // Callbacks may arm new timers
+   for (i = 0; i < num_fired; i++)
+   {
+      if (fired_cb[i] != NULL)
+      {
+         fired_cb[i](fired_data[i]);
+      }
+   }
+}
@@ -0,0 +1,76 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_TIMER_H
+#define LOC_ENG_TIMER_H
+
+#include <time.h>
+#include <pthread.h>
+
+#define LOC_ENG_TIMER_MAX                16      /* timers armed at the same time */
+#define LOC_ENG_TIMER_WHEEL_SLOTS        64      /* must be a power of 2 */
+#define LOC_ENG_TIMER_TICK_MSEC          100     /* wheel resolution */
+
+#define LOC_ENG_TIMER_INVALID            0       /* never returned by loc_eng_timer_start */
+
+// Timer callback, called on the deferred action thread
+typedef void (*loc_eng_timer_cb)(void *user_data);
+
+typedef struct
+{
+   boolean                        in_use;
+   int                            timer_id;      /* generation and index */
+   long long                      expire_tick;   /* monotonic, in LOC_ENG_TIMER_TICK_MSEC */
+   int                            next;          /* next timer in the same wheel slot, -1 at the end */
+   loc_eng_timer_cb               cb;
+   void                          *user_data;
+} loc_eng_timer_s_type;
+
+typedef struct
+{
+   pthread_mutex_t                lock;
+   long long                      last_tick;     /* last tick processed */
+   int                            generation;
+   int                            wheel[LOC_ENG_TIMER_WHEEL_SLOTS];
+   loc_eng_timer_s_type           timers[LOC_ENG_TIMER_MAX];
+} loc_eng_timer_data_s_type;
+
+extern void loc_eng_timer_init();
+extern int  loc_eng_timer_start(uint32 timeout_msec, loc_eng_timer_cb cb, void *user_data);
+extern void loc_eng_timer_stop(int timer_id);
+extern boolean loc_eng_timer_next_expire(struct timespec *expire_time);
+extern void loc_eng_timer_process();
+extern int  loc_eng_timer_armed();
+
+extern long long loc_eng_timer_now_msec();
+extern void loc_eng_cond_init_monotonic(pthread_cond_t *cond);
+extern int  loc_eng_cond_timedwait_monotonic(pthread_cond_t *cond, pthread_mutex_t *mutex,
+            const struct timespec *expire_time);
+
+#endif /* LOC_ENG_TIMER_H */
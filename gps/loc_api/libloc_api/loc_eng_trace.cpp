@@ -0,0 +1,397 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_NDDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <rpc/rpc.h>
+#include <loc_api_rpc_glue.h>
+
+#include <loc_eng.h>
+
+#define LOG_TAG "libloc"
+#include <utils/Log.h>
+
+/*=============================================================================
+ *
+ *                             DATA DECLARATION
+ *
+ *============================================================================*/
+
+/* Writers claim records with an atomic increment of the write index in the
+ * header and never block, so tracing is safe from the RPC callback thread.
+ * The mapping is set up once and kept for the life of the process. */
+static loc_eng_trace_header_s_type * volatile loc_eng_trace_header = NULL;
+
+/* Records written before loc_eng_trace_init land here and are dropped */
+static loc_eng_trace_rec_s_type loc_eng_trace_scratch;
+
+#define TRACE_RING(header)      ((loc_eng_trace_rec_s_type *) ((header) + 1))
+#define TRACE_MAP_SIZE          (sizeof(loc_eng_trace_header_s_type) + \
+                                 LOC_ENG_TRACE_RECORDS * sizeof(loc_eng_trace_rec_s_type))
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_init
+
+DESCRIPTION
+   Maps the trace ring. With a trace file the ring survives restarts of the
+   process and can be pulled from the device for loc_trace_decode; a file
+   written by another layout version is reset. Without one, or if it cannot
+   be mapped, the ring lives in anonymous memory.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_trace_init(const char *trace_file)
+{
+   loc_eng_trace_header_s_type *header;
+   void *map = MAP_FAILED;
+   int fd;
+
+   if (loc_eng_trace_header != NULL)
+   {
+      return; /* already mapped by an earlier loc_eng_init */
+   }
+
+   if (trace_file != NULL && trace_file[0] != '\0')
+   {
+      fd = open(trace_file, O_RDWR | O_CREAT, 0660);
+      if (fd < 0)
+      {
+         LOC_LOGW("loc_eng_trace_init: cannot open %s\n", trace_file);
+      }
+      else
+      {
+         if (ftruncate(fd, TRACE_MAP_SIZE) == 0)
+         {
+            map = mmap(NULL, TRACE_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+         }
+         if (map == MAP_FAILED)
+         {
+            LOC_LOGW("loc_eng_trace_init: cannot map %s\n", trace_file);
+         }
+         close(fd);
+      }
+   }
+
+   if (map == MAP_FAILED)
+   {
+      map = mmap(NULL, TRACE_MAP_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (map == MAP_FAILED)
+      {
+         LOC_LOGE("loc_eng_trace_init: out of memory, tracing disabled\n");
+         return;
+      }
+   }
+
+   header = (loc_eng_trace_header_s_type *) map;
+   if (header->magic != LOC_ENG_TRACE_MAGIC ||
+       header->version != LOC_ENG_TRACE_VERSION ||
+       header->record_size != sizeof(loc_eng_trace_rec_s_type) ||
+       header->record_count != LOC_ENG_TRACE_RECORDS)
+   {
+      memset(map, 0, TRACE_MAP_SIZE);
+      header->magic = LOC_ENG_TRACE_MAGIC;
+      header->version = LOC_ENG_TRACE_VERSION;
+      header->record_size = sizeof(loc_eng_trace_rec_s_type);
+      header->record_count = LOC_ENG_TRACE_RECORDS;
+   }
+
+   __sync_synchronize();
+   loc_eng_trace_header = header;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_begin
+
+DESCRIPTION
+   Claims the next record in the trace ring. The record is marked as being
+   written until loc_eng_trace_commit is called; the oldest record is
+   overwritten when the ring is full. A record is a 32 byte store with no
+   lock and no system call besides reading the monotonic clock.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Record to fill in, its payload is zeroed
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+loc_eng_trace_rec_s_type* loc_eng_trace_begin(uint16 type)
+{
+   loc_eng_trace_header_s_type *header = loc_eng_trace_header;
+   loc_eng_trace_rec_s_type *rec = &loc_eng_trace_scratch;
+   uint32 index = 0;
+
+   if (header != NULL)
+   {
+      index = __sync_fetch_and_add(&header->head, 1);
+      rec = &TRACE_RING(header)[index & (LOC_ENG_TRACE_RECORDS - 1)];
+   }
+
+   rec->seq = LOC_ENG_TRACE_SEQ_BUSY | ((index + 1) & ~LOC_ENG_TRACE_SEQ_BUSY);
+   __sync_synchronize();
+
+   rec->time_msec = (uint32) loc_eng_timer_now_msec();
+   rec->type = type;
+   rec->reserved = 0;
+   memset(&rec->u, 0, sizeof rec->u);
+
+   return rec;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_commit
+
+DESCRIPTION
+   Publishes a record claimed by loc_eng_trace_begin.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_trace_commit(loc_eng_trace_rec_s_type *rec)
+{
+   __sync_synchronize();
+   rec->seq &= ~LOC_ENG_TRACE_SEQ_BUSY;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_position
+
+DESCRIPTION
+   Records a parsed position report.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_trace_position(const struct rpc_loc_parsed_position_s_type *parsed_report)
+{
+   loc_eng_trace_rec_s_type *rec = loc_eng_trace_begin(LOC_ENG_TRACE_POSITION);
+   loc_eng_trace_position_s_type *position = &rec->u.position;
+
+   position->latitude         = (int32) (parsed_report->latitude * 1e7);
+   position->longitude        = (int32) (parsed_report->longitude * 1e7);
+   position->hor_unc_circular = parsed_report->hor_unc_circular;
+   position->valid_mask       = (uint32) parsed_report->valid_mask;
+   position->session_status   = (uint8) parsed_report->session_status;
+
+   loc_eng_trace_commit(rec);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_satellites
+
+DESCRIPTION
+   Records a GNSS SV constellation report: one summary record with the DOPs
+   followed by one record per SV in the list.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_trace_satellites(const struct rpc_loc_gnss_info_s_type *gnss)
+{
+   loc_eng_trace_rec_s_type *rec = loc_eng_trace_begin(LOC_ENG_TRACE_SV_SUMMARY);
+   loc_eng_trace_sv_summary_s_type *summary = &rec->u.sv_summary;
+   int i, sv_count = 0;
+
+   summary->valid_mask       = (uint32) gnss->valid_mask;
+   summary->position_dop     = gnss->position_dop;
+   summary->horizontal_dop   = gnss->horizontal_dop;
+   summary->vertical_dop     = gnss->vertical_dop;
+   summary->sv_count         = (uint8) gnss->sv_count;
+   summary->altitude_assumed = (uint8) gnss->altitude_assumed;
+   loc_eng_trace_commit(rec);
+
+   if (gnss->valid_mask & RPC_LOC_GNSS_INFO_VALID_SV_LIST)
+   {
+      sv_count = gnss->sv_list.sv_list_len;
+   }
+
+   for (i = 0; i < sv_count; i++)
+   {
+      const rpc_loc_sv_info_s_type *sv_info = &gnss->sv_list.sv_list_val[i];
+      loc_eng_trace_sv_s_type *sv;
+
+      rec = loc_eng_trace_begin(LOC_ENG_TRACE_SV);
+      sv = &rec->u.sv;
+      sv->system         = (uint8) sv_info->system;
+      sv->prn            = (uint8) sv_info->prn;
+      sv->health_status  = (uint8) sv_info->health_status;
+      sv->process_status = (uint8) sv_info->process_status;
+      sv->has_eph        = (uint8) sv_info->has_eph;
+      sv->has_alm        = (uint8) sv_info->has_alm;
+      sv->valid_mask     = (uint16) sv_info->valid_mask;
+      sv->elevation      = sv_info->elevation;
+      sv->azimuth        = sv_info->azimuth;
+      sv->snr            = sv_info->snr;
+      loc_eng_trace_commit(rec);
+   }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_status
+
+DESCRIPTION
+   Records a GPS status (GpsStatusValue) reported to the framework.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_trace_status(int status)
+{
+   loc_eng_trace_rec_s_type *rec = loc_eng_trace_begin(LOC_ENG_TRACE_STATUS);
+   rec->u.status.status = (uint16) status;
+   loc_eng_trace_commit(rec);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_agps
+
+DESCRIPTION
+   Records an AGPS data connection event (AGpsStatusValue): a request or
+   release from the modem, or the answer of the framework.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_trace_agps(int status, uint32 conn_handle)
+{
+   loc_eng_trace_rec_s_type *rec = loc_eng_trace_begin(LOC_ENG_TRACE_AGPS);
+   rec->u.agps.status = (uint16) status;
+   rec->u.agps.conn_handle = conn_handle;
+   loc_eng_trace_commit(rec);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_ioctl
+
+DESCRIPTION
+   Records the outcome of a synchronous or asynchronous IOCTL, with the
+   time from the call to its report.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_trace_ioctl(uint32 ioctl_type, int status, uint32 latency_msec, int async)
+{
+   loc_eng_trace_rec_s_type *rec = loc_eng_trace_begin(LOC_ENG_TRACE_IOCTL);
+   rec->u.ioctl.ioctl_type = ioctl_type;
+   rec->u.ioctl.status = (int32) status;
+   rec->u.ioctl.latency_msec = latency_msec;
+   rec->u.ioctl.async = (uint8) async;
+   loc_eng_trace_commit(rec);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_trace_queue
+
+DESCRIPTION
+   Records a command taken by the deferred action thread.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_trace_queue(int cmd_type, int pending, uint32 latency_msec,
+            int ioctls_in_flight, int timers_armed)
+{
+   loc_eng_trace_rec_s_type *rec = loc_eng_trace_begin(LOC_ENG_TRACE_QUEUE);
+   rec->u.queue.cmd_type = (uint16) cmd_type;
+   rec->u.queue.pending = (uint16) pending;
+   rec->u.queue.latency_msec = latency_msec;
+   rec->u.queue.ioctls_in_flight = (uint16) ioctls_in_flight;
+   rec->u.queue.timers_armed = (uint16) timers_armed;
+   loc_eng_trace_commit(rec);
+}
@@ -0,0 +1,169 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_TRACE_H
+#define LOC_ENG_TRACE_H
+
+/* This header is shared with the host decoder (loc_trace_decode.c), keep it
+ * free of Loc API and Android dependencies */
+#include <stdint.h>
+
+#define LOC_ENG_TRACE_MAGIC              0x54434F4C  /* "LOCT" */
+#define LOC_ENG_TRACE_VERSION            2
+#define LOC_ENG_TRACE_RECORDS            1024    /* must be a power of 2 */
+#define LOC_ENG_TRACE_SEQ_BUSY           0x80000000  /* set in seq while a record is written */
+
+// Trace record types
+enum loc_eng_trace_e_type {
+   LOC_ENG_TRACE_NONE                  = 0,
+   LOC_ENG_TRACE_POSITION              = 1,
+   LOC_ENG_TRACE_SV_SUMMARY            = 2,
+   LOC_ENG_TRACE_SV                    = 3,
+   LOC_ENG_TRACE_STATUS                = 4,
+   LOC_ENG_TRACE_AGPS                  = 5,
+   LOC_ENG_TRACE_IOCTL                 = 6,
+   LOC_ENG_TRACE_QUEUE                 = 7,
+};
+
+typedef struct
+{
+   int32_t                        latitude;      /* degrees * 1e7 */
+   int32_t                        longitude;     /* degrees * 1e7 */
+   float                          hor_unc_circular;
+   uint32_t                       valid_mask;    /* low 32 bits of the position valid mask */
+   uint8_t                        session_status;
+   uint8_t                        reserved[3];
+} loc_eng_trace_position_s_type;
+
+typedef struct
+{
+   uint32_t                       valid_mask;
+   float                          position_dop;
+   float                          horizontal_dop;
+   float                          vertical_dop;
+   uint8_t                        sv_count;
+   uint8_t                        altitude_assumed;
+   uint8_t                        reserved[2];
+} loc_eng_trace_sv_summary_s_type;
+
+typedef struct
+{
+   uint8_t                        system;
+   uint8_t                        prn;
+   uint8_t                        health_status;
+   uint8_t                        process_status;
+   uint8_t                        has_eph;
+   uint8_t                        has_alm;
+   uint16_t                       valid_mask;
+   float                          elevation;
+   float                          azimuth;
+   float                          snr;
+} loc_eng_trace_sv_s_type;
+
+// GPS status reported to the framework (GpsStatusValue)
+typedef struct
+{
+   uint16_t                       status;
+   uint16_t                       reserved;
+} loc_eng_trace_status_s_type;
+
+// AGPS data connection request from the modem or answer from the framework
+typedef struct
+{
+   uint16_t                       status;        /* AGpsStatusValue */
+   uint16_t                       reserved;
+   uint32_t                       conn_handle;
+} loc_eng_trace_agps_s_type;
+
+typedef struct
+{
+   uint32_t                       ioctl_type;    /* rpc_loc_ioctl_e_type */
+   int32_t                        status;        /* Loc API status */
+   uint32_t                       latency_msec;
+   uint8_t                        async;
+   uint8_t                        reserved[3];
+} loc_eng_trace_ioctl_s_type;
+
+// Command taken by the deferred action thread, and the work still pending
+typedef struct
+{
+   uint16_t                       cmd_type;      /* loc_eng_cmd_e_type */
+   uint16_t                       pending;       /* commands still queued */
+   uint32_t                       latency_msec;  /* from post to processing */
+   uint16_t                       ioctls_in_flight;
+   uint16_t                       timers_armed;
+} loc_eng_trace_queue_s_type;
+
+// One fixed-size (32 bytes) record in the trace ring
+typedef struct
+{
+   uint32_t                       seq;           /* write index + 1 (31 bits), 0 if never written */
+   uint32_t                       time_msec;     /* monotonic, truncated to 32 bits */
+   uint16_t                       type;          /* loc_eng_trace_e_type */
+   uint16_t                       reserved;
+   union
+   {
+      loc_eng_trace_position_s_type     position;
+      loc_eng_trace_sv_summary_s_type   sv_summary;
+      loc_eng_trace_sv_s_type           sv;
+      loc_eng_trace_status_s_type       status;
+      loc_eng_trace_agps_s_type         agps;
+      loc_eng_trace_ioctl_s_type        ioctl;
+      loc_eng_trace_queue_s_type        queue;
+   } u;
+} loc_eng_trace_rec_s_type;
+
+// Trace file layout: this header followed by record_count records
+typedef struct
+{
+   uint32_t                       magic;
+   uint32_t                       version;
+   uint32_t                       record_size;
+   uint32_t                       record_count;
+   volatile uint32_t              head;          /* next write index */
+   uint32_t                       reserved[3];
+} loc_eng_trace_header_s_type;
+
+struct rpc_loc_parsed_position_s_type;
+struct rpc_loc_gnss_info_s_type;
+
+extern void loc_eng_trace_init(const char *trace_file);
+
+extern loc_eng_trace_rec_s_type* loc_eng_trace_begin(uint16_t type);
+extern void loc_eng_trace_commit(loc_eng_trace_rec_s_type *rec);
+
+extern void loc_eng_trace_position(const struct rpc_loc_parsed_position_s_type *parsed_report);
+extern void loc_eng_trace_satellites(const struct rpc_loc_gnss_info_s_type *gnss);
+extern void loc_eng_trace_status(int status);
+extern void loc_eng_trace_agps(int status, uint32_t conn_handle);
+extern void loc_eng_trace_ioctl(uint32_t ioctl_type, int status, uint32_t latency_msec, int async);
+extern void loc_eng_trace_queue(int cmd_type, int pending, uint32_t latency_msec,
+            int ioctls_in_flight, int timers_armed);
+
+#endif /* LOC_ENG_TRACE_H */
@@ -53,7 +53,9 @@
 #define XTRA_BLOCK_SIZE                 (1024)
 
 static int qct_loc_eng_xtra_init (GpsXtraCallbacks* callbacks);
-static int qct_loc_eng_inject_xtra_data(char* data, int length);
+static void qct_loc_eng_inject_xtra_data(void);
+static void qct_loc_eng_inject_xtra_data_done(rpc_loc_ioctl_e_type ioctl_type, int status,
+            const rpc_loc_ioctl_callback_s_type *cb_data_ptr, void *user_data);
 static int qct_loc_eng_inject_xtra_data_proxy(char* data, int length);
 
 const GpsXtraInterface sLocEngXTRAInterface =
@@ -95,13 +97,14 @@ static int qct_loc_eng_xtra_init (GpsXtraCallbacks* callbacks)
 FUNCTION    qct_loc_eng_inject_xtra_data
 
 DESCRIPTION
-   Injects XTRA file into the engine.
+   Injects XTRA file into the engine. The last part is sent asynchronously,
+   its report is handled by qct_loc_eng_inject_xtra_data_done.
 
 DEPENDENCIES
    N/A
 
 RETURN VALUE
-   0: success
+   0: success, completion pending
    error code > 0
 
 SIDE EFFECTS
@@ -165,15 +168,17 @@ static int qct_loc_eng_inject_xtra_data_one(char* data, int length)
       }
       else // part == total_parts
       {
-         // Last part injection, will need to wait for callback
-         if (!loc_eng_ioctl(loc_eng_data.client_handle,
-                                  ioctl_type,
-                                  &ioctl_data,
-                                  LOC_XTRA_INJECT_DEFAULT_TIMEOUT,
-                                  NULL))
+         // Last part injection, the callback is delivered on the deferred action thread
+         rpc_ret_val = loc_eng_ioctl_async(loc_eng_data.client_handle,
+                                           ioctl_type,
+                                           &ioctl_data,
+                                           LOC_XTRA_INJECT_DEFAULT_TIMEOUT,
+                                           qct_loc_eng_inject_xtra_data_done,
+                                           NULL);
+         if (rpc_ret_val != RPC_LOC_API_SUCCESS)
          {
             ret_val = EIO;
-            LOC_LOGE("loc_eng_ioctl for xtra error\n");
+            LOC_LOGE("loc_eng_ioctl_async for xtra error: %s\n", loc_get_ioctl_status_name(rpc_ret_val));
          }
          break; // done with injection
       }
@@ -184,29 +189,92 @@ static int qct_loc_eng_inject_xtra_data_one(char* data, int length)
 
    return ret_val;
 }
-static int qct_loc_eng_inject_xtra_data(char* data, int length)
+
+/*===========================================================================
+FUNCTION    qct_loc_eng_inject_xtra_data
+
+DESCRIPTION
+   Starts the next try of injecting the XTRA data in flight. The buffer is
+   freed once all tries have failed, or by the completion handler.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void qct_loc_eng_inject_xtra_data(void)
 {
-   int rc = EIO;
-   int tries = 0;
-   while (tries++ < 3) {
-      rc = qct_loc_eng_inject_xtra_data_one(data, length);
-      if (!rc) break;
+   loc_eng_xtra_data_s_type *xtra_module_data_ptr = &loc_eng_data.xtra_module_data;
+
+   while (xtra_module_data_ptr->injection_tries++ < 3) {
+      if (!qct_loc_eng_inject_xtra_data_one(xtra_module_data_ptr->xtra_data_in_injection,
+                                            xtra_module_data_ptr->xtra_data_in_injection_len))
+      {
+         return; // wait for qct_loc_eng_inject_xtra_data_done
+      }
    }
-   return rc;
+
+   // FIXME gracefully handle injection error
+   LOC_LOGE("XTRA injection failed.");
+   free(xtra_module_data_ptr->xtra_data_in_injection);
+   xtra_module_data_ptr->xtra_data_in_injection = NULL;
+   xtra_module_data_ptr->xtra_data_in_injection_len = 0;
 }
 
 /*===========================================================================
-FUNCTION    loc_eng_inject_xtra_data_in_buffer
+FUNCTION    qct_loc_eng_inject_xtra_data_done
 
 DESCRIPTION
-   Injects buffered XTRA file into the engine and clears the buffer.
+   Completion handler of the last XTRA part. Retries the injection on error,
+   otherwise releases the XTRA data.
 
 DEPENDENCIES
+   Called on the deferred action thread
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
    N/A
 
+===========================================================================*/
+static void qct_loc_eng_inject_xtra_data_done(rpc_loc_ioctl_e_type ioctl_type, int status,
+            const rpc_loc_ioctl_callback_s_type *cb_data_ptr, void *user_data)
+{
+   loc_eng_xtra_data_s_type *xtra_module_data_ptr = &loc_eng_data.xtra_module_data;
+
+   if (status != RPC_LOC_API_SUCCESS)
+   {
+      LOC_LOGE("loc_eng_ioctl_async for xtra error: %s\n", loc_get_ioctl_status_name(status));
+      qct_loc_eng_inject_xtra_data();
+      return;
+   }
+
+   LOC_LOGD("qct_loc_eng_inject_xtra_data_done, xtra size = %d injected\n",
+         xtra_module_data_ptr->xtra_data_in_injection_len);
+   free(xtra_module_data_ptr->xtra_data_in_injection);
+   xtra_module_data_ptr->xtra_data_in_injection = NULL;
+   xtra_module_data_ptr->xtra_data_in_injection_len = 0;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_inject_xtra_data_in_buffer
+
+DESCRIPTION
+   Starts injecting the buffered XTRA file into the engine and clears the
+   buffer. If an injection is still in flight, the buffer is kept until it
+   has completed.
+
+DEPENDENCIES
+   Called on the deferred action thread
+
 RETURN VALUE
    0: success
-   >0: failure
 
 SIDE EFFECTS
    N/A
@@ -214,10 +282,15 @@ SIDE EFFECTS
 ===========================================================================*/
 int loc_eng_inject_xtra_data_in_buffer()
 {
-   int rc = 0;
    char *data;
    int length;
 
+   if (loc_eng_data.xtra_module_data.xtra_data_in_injection != NULL)
+   {
+      LOC_LOGD("loc_eng_inject_xtra_data_in_buffer: injection in flight, deferred\n");
+      return 0;
+   }
+
    pthread_mutex_lock(&loc_eng_data.xtra_module_data.lock);
 
    data = loc_eng_data.xtra_module_data.xtra_data_for_injection;
@@ -230,17 +303,13 @@ int loc_eng_inject_xtra_data_in_buffer()
 
    if (data)
    {
-      if (qct_loc_eng_inject_xtra_data(data, length))
-      {
-         // FIXME gracefully handle injection error
-         LOC_LOGE("XTRA injection failed.");
-         rc = -1;
-      }
-
-      free(data);
+      loc_eng_data.xtra_module_data.xtra_data_in_injection = data;
+      loc_eng_data.xtra_module_data.xtra_data_in_injection_len = length;
+      loc_eng_data.xtra_module_data.injection_tries = 0;
+      qct_loc_eng_inject_xtra_data();
    }
 
-   return rc;
+   return 0;
 }
 
 /*===========================================================================
@@ -270,15 +339,17 @@ static int qct_loc_eng_inject_xtra_data_proxy(char* data, int length)
    if (buf)
    {
       memcpy(buf, data, length);
+      // newer data replaces data not injected yet
+      free(loc_eng_data.xtra_module_data.xtra_data_for_injection);
       loc_eng_data.xtra_module_data.xtra_data_for_injection = buf;
       loc_eng_data.xtra_module_data.xtra_data_len = length;
    }
 
    pthread_mutex_unlock(&loc_eng_data.xtra_module_data.lock);
 
-   if (loc_eng_data.engine_status != GPS_STATUS_ENGINE_ON)
+   if (buf)
    {
-      pthread_cond_signal(&loc_eng_data.deferred_action_cond);
+      loc_eng_cmd_post(LOC_ENG_CMD_XTRA_INJECT);
    }
 
    return 0;
@@ -47,6 +47,11 @@ typedef struct
    // XTRA data buffer
    char                          *xtra_data_for_injection;  // NULL if no pending data
    int                            xtra_data_len;
+
+   // XTRA data being injected, owned by the deferred action thread
+   char                          *xtra_data_in_injection;   // NULL if no injection in flight
+   int                            xtra_data_in_injection_len;
+   int                            injection_tries;
 } loc_eng_xtra_data_s_type;
 
 #endif // LOC_ENG_XTRA_H
@@ -0,0 +1,201 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * loc_geofence_bench: host benchmark of the geofence extension. It checks
+ * the transitions of a few fences, then times adding, evaluating and
+ * removing a large number of small fences around one area.
+ *
+ *    loc_geofence_bench [fences] [fixes]
+ *
+ * Defaults are 10000 fences and 100000 fixes. Exits with 1 if a transition
+ * is not the expected one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <loc_eng.h>
+
+// What loc_eng_geofence.cpp uses of the rest of loc_eng
+loc_gps_cfg_s_type  gps_conf;
+loc_eng_data_s_type loc_eng_data;
+
+static long long bench_now_msec;
+
+long long loc_eng_timer_now_msec()
+{
+   return bench_now_msec;
+}
+
+static int bench_transitions[LOC_GEOFENCE_DWELL + 1];
+static int bench_last_id;
+static int bench_last_transition;
+
+static void bench_transition_cb(int32_t geofence_id, const GpsLocation *location,
+            int transition)
+{
+   bench_transitions[transition]++;
+   bench_last_id = geofence_id;
+   bench_last_transition = transition;
+}
+
+static long long bench_clock_usec()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void bench_fix(GpsLocation *location, double latitude, double longitude)
+{
+   location->latitude = latitude;
+   location->longitude = longitude;
+   loc_eng_geofence_evaluate(location);
+}
+
+/* Expects exactly one transition from the last fix, or none */
+static int bench_expect(const char *step, int id, int transition)
+{
+   int count = bench_transitions[LOC_GEOFENCE_ENTERED] + bench_transitions[LOC_GEOFENCE_EXITED] +
+               bench_transitions[LOC_GEOFENCE_DWELL];
+   int ok = (transition == 0) ? (count == 0) :
+            (count == 1 && bench_last_id == id && bench_last_transition == transition);
+
+   if (!ok)
+   {
+      fprintf(stderr, "%s: expected fence %d transition %d, got %d transitions, last %d/%d\n",
+            step, id, transition, count, bench_last_id, bench_last_transition);
+   }
+   memset(bench_transitions, 0, sizeof bench_transitions);
+   return ok;
+}
+
+static int bench_check(const LocGeofenceInterface *geofence, GpsLocation *location)
+{
+   int ok = 1;
+
+   geofence->add(1, 37.0, -122.0, 100, LOC_GEOFENCE_ENTERED | LOC_GEOFENCE_EXITED |
+                 LOC_GEOFENCE_DWELL, 5000);
+   ok &= geofence->add(1, 37.0, -122.0, 100, LOC_GEOFENCE_ENTERED, 0) == -1;
+
+   bench_now_msec = 0;
+   bench_fix(location, 37.0005, -122.0);
+   ok &= bench_expect("enter", 1, LOC_GEOFENCE_ENTERED);
+   bench_now_msec = 6000;
+   bench_fix(location, 37.0005, -122.0);
+   ok &= bench_expect("dwell", 1, LOC_GEOFENCE_DWELL);
+   bench_fix(location, 37.01, -122.0);
+   ok &= bench_expect("exit", 1, LOC_GEOFENCE_EXITED);
+
+   bench_fix(location, 37.0, -122.0);
+   ok &= bench_expect("enter again", 1, LOC_GEOFENCE_ENTERED);
+   geofence->pause(1);
+   bench_fix(location, 37.01, -122.0);
+   ok &= bench_expect("paused", 0, 0);
+   geofence->resume(1);
+   bench_fix(location, 37.0, -122.0);
+   ok &= bench_expect("resumed", 1, LOC_GEOFENCE_ENTERED);
+
+   ok &= geofence->remove(1) == 0 && geofence->remove(1) == -1;
+   return ok;
+}
+
+int main(int argc, char *argv[])
+{
+   const LocGeofenceInterface *geofence = &sLocEngGeofenceInterface;
+   LocGeofenceCallbacks callbacks = { sizeof callbacks, bench_transition_cb };
+   GpsLocation location;
+   int num_fences = (argc > 1) ? atoi(argv[1]) : 10000;
+   int num_fixes = (argc > 2) ? atoi(argv[2]) : 100000;
+   long long start_usec, add_usec, evaluate_usec, remove_usec;
+   int entered, exited, i;
+
+   if (num_fences <= 0 || num_fences > LOC_ENG_GEOFENCE_MAX || num_fixes <= 0)
+   {
+      fprintf(stderr, "usage: %s [fences (1..%d)] [fixes]\n", argv[0], LOC_ENG_GEOFENCE_MAX);
+      return 2;
+   }
+
+   geofence->init(&callbacks);
+   memset(&location, 0, sizeof location);
+   location.size = sizeof location;
+   location.flags = GPS_LOCATION_HAS_LAT_LONG | GPS_LOCATION_HAS_ACCURACY;
+   location.accuracy = 5;
+
+   if (!bench_check(geofence, &location))
+   {
+      return 1;
+   }
+
+   // Fences of 50 to 250 m within 0.2 degrees, fixes along the diagonal
+   srand(1);
+   start_usec = bench_clock_usec();
+   for (i = 0; i < num_fences; i++)
+   {
+      if (geofence->add(100 + i, 37.0 + (rand() % 20000) / 100000.0,
+                        -122.0 + (rand() % 20000) / 100000.0, 50 + rand() % 200,
+                        LOC_GEOFENCE_ENTERED | LOC_GEOFENCE_EXITED, 0) != 0)
+      {
+         fprintf(stderr, "cannot add fence %d\n", 100 + i);
+         return 1;
+      }
+   }
+   add_usec = bench_clock_usec() - start_usec;
+
+   start_usec = bench_clock_usec();
+   for (i = 0; i < num_fixes; i++)
+   {
+      bench_fix(&location, 37.0 + (i % 2000) * 0.0001, -122.0 + (i % 2000) * 0.0001);
+   }
+   evaluate_usec = bench_clock_usec() - start_usec;
+   entered = bench_transitions[LOC_GEOFENCE_ENTERED];
+   exited = bench_transitions[LOC_GEOFENCE_EXITED];
+
+   start_usec = bench_clock_usec();
+   for (i = 0; i < num_fences; i++)
+   {
+      if (geofence->remove(100 + i) != 0)
+      {
+         fprintf(stderr, "cannot remove fence %d\n", 100 + i);
+         return 1;
+      }
+   }
+   remove_usec = bench_clock_usec() - start_usec;
+
+   printf("%d fences: add %.2f us/fence, evaluate %.2f us/fix, remove %.2f us/fence\n",
+         num_fences, (double) add_usec / num_fences, (double) evaluate_usec / num_fixes,
+         (double) remove_usec / num_fences);
+   printf("%d fixes: %d entered, %d exited\n", num_fixes, entered, exited);
+
+   return 0;
+}
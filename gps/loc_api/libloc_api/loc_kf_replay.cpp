@@ -0,0 +1,299 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * loc_kf_replay: host tool that replays a track through the Kalman
+ * smoothing stage (see SMOOTHING in gps.conf) and times it.
+ *
+ *    loc_kf_replay [-a accel] [-s sigma] [-n repeat] [track.csv]
+ *
+ * The track is the CSV output of loc_trace_decode, whose position records
+ * are used. Without a track a synthetic drive is replayed, with noise and
+ * outliers added to a known path, and the errors of the raw and the
+ * smoothed fixes are reported as well. -a and -s set SMOOTH_ACCEL and
+ * OUTLIER_SIGMA, -n replays the track that many times for the timing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <loc_eng.h>
+
+#define REPLAY_SYNTHETIC_FIXES   3600    /* one hour at 1 Hz */
+#define REPLAY_SYNTHETIC_UNC     10.0    /* reported accuracy, m */
+#define REPLAY_OUTLIER_EVERY     97      /* one fix in this many jumps */
+#define REPLAY_OUTLIER_M         300.0
+
+// What loc_eng_kalman.cpp uses of the rest of loc_eng
+loc_gps_cfg_s_type gps_conf;
+
+static GpsLocation *replay_fixes;
+static double      *replay_truth;                /* latitude, longitude pairs, synthetic only */
+static int          replay_count;
+static int          replay_capacity;
+
+static GpsLocation* replay_append()
+{
+   if (replay_count == replay_capacity)
+   {
+      int capacity = replay_capacity ? replay_capacity * 2 : 1024;
+      GpsLocation *fixes = (GpsLocation *) realloc(replay_fixes, capacity * sizeof *fixes);
+      if (fixes == NULL)
+      {
+         return NULL;
+      }
+      replay_fixes = fixes;
+      replay_capacity = capacity;
+   }
+
+   memset(&replay_fixes[replay_count], 0, sizeof replay_fixes[replay_count]);
+   replay_fixes[replay_count].size = sizeof(GpsLocation);
+   return &replay_fixes[replay_count++];
+}
+
+static double replay_field(const char *line, const char *name)
+{
+   const char *field = strstr(line, name);
+   return field != NULL ? atof(field + strlen(name)) : NAN;
+}
+
+/* Reads the position records of a loc_trace_decode CSV file */
+static int replay_read(const char *path)
+{
+   char line[512];
+   FILE *fp = fopen(path, "r");
+
+   if (fp == NULL)
+   {
+      perror(path);
+      return 0;
+   }
+
+   while (fgets(line, sizeof line, fp) != NULL)
+   {
+      const char *type = strchr(line, ',');
+      GpsLocation *fix;
+      double latitude, longitude, unc;
+
+      type = (type != NULL) ? strchr(type + 1, ',') : NULL;
+      if (type == NULL || strncmp(type + 1, "position,", 9) != 0)
+      {
+         continue;
+      }
+
+      latitude = replay_field(line, ",latitude=");
+      longitude = replay_field(line, ",longitude=");
+      unc = replay_field(line, ",hor_unc_circular=");
+      if (isnan(latitude) || isnan(longitude) || isnan(unc) ||
+          (latitude == 0.0 && longitude == 0.0))
+      {
+         continue;
+      }
+
+      fix = replay_append();
+      if (fix == NULL)
+      {
+         break;
+      }
+      fix->flags = GPS_LOCATION_HAS_LAT_LONG | GPS_LOCATION_HAS_ACCURACY;
+      fix->timestamp = (GpsUtcTime) strtoul(strchr(line, ',') + 1, NULL, 10);
+      fix->latitude = latitude;
+      fix->longitude = longitude;
+      fix->accuracy = (float) unc;
+   }
+   fclose(fp);
+
+   return replay_count > 0;
+}
+
+static double replay_gauss()
+{
+   double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+   double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+   return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/* A drive at 15 m/s that turns every few minutes, fixes at 1 Hz */
+static int replay_synthesize()
+{
+   double latitude = 37.0, longitude = -122.0, heading = 0.0, m_per_deg_lon;
+   double sigma = REPLAY_SYNTHETIC_UNC / sqrt(2.0);
+   int i;
+
+   replay_truth = (double *) malloc(2 * REPLAY_SYNTHETIC_FIXES * sizeof(double));
+   if (replay_truth == NULL)
+   {
+      return 0;
+   }
+
+   srand(1);
+   for (i = 0; i < REPLAY_SYNTHETIC_FIXES; i++)
+   {
+      GpsLocation *fix = replay_append();
+      double north = replay_gauss() * sigma, east = replay_gauss() * sigma;
+
+      if (fix == NULL)
+      {
+         return 0;
+      }
+      if (i % 240 == 0)
+      {
+         heading += M_PI / 3;
+      }
+      m_per_deg_lon = 111320.0 * cos(latitude * M_PI / 180.0);
+      latitude += 15.0 * cos(heading) / 111320.0;
+      longitude += 15.0 * sin(heading) / m_per_deg_lon;
+      replay_truth[2 * i] = latitude;
+      replay_truth[2 * i + 1] = longitude;
+
+      if (i % REPLAY_OUTLIER_EVERY == REPLAY_OUTLIER_EVERY - 1)
+      {
+         north += REPLAY_OUTLIER_M;
+      }
+      fix->flags = GPS_LOCATION_HAS_LAT_LONG | GPS_LOCATION_HAS_ACCURACY;
+      fix->timestamp = 1000000000000ULL + (GpsUtcTime) i * 1000;
+      fix->latitude = latitude + north / 111320.0;
+      fix->longitude = longitude + east / m_per_deg_lon;
+      fix->accuracy = (float) REPLAY_SYNTHETIC_UNC;
+   }
+
+   return 1;
+}
+
+static double replay_error_m(const GpsLocation *fix, int i)
+{
+   double north = (fix->latitude - replay_truth[2 * i]) * 111320.0;
+   double east = (fix->longitude - replay_truth[2 * i + 1]) * 111320.0 *
+                 cos(replay_truth[2 * i] * M_PI / 180.0);
+   return north * north + east * east;
+}
+
+static long long replay_clock_nsec()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+   loc_eng_kf_s_type kf;
+   GpsLocation fix;
+   const char *path = NULL;
+   int repeat = 100, rejected = 0, used = 0, arg, r, i;
+   double raw_error = 0.0, smooth_error = 0.0;
+   long long start_nsec, elapsed_nsec;
+
+   gps_conf.SMOOTH_ACCEL = 3;
+   gps_conf.OUTLIER_SIGMA = 5;
+   for (arg = 1; arg < argc; arg++)
+   {
+      if (strcmp(argv[arg], "-a") == 0 && arg + 1 < argc)
+      {
+         gps_conf.SMOOTH_ACCEL = strtoul(argv[++arg], NULL, 10);
+      }
+      else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc)
+      {
+         gps_conf.OUTLIER_SIGMA = strtoul(argv[++arg], NULL, 10);
+      }
+      else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc)
+      {
+         repeat = atoi(argv[++arg]);
+      }
+      else if (argv[arg][0] != '-' && path == NULL)
+      {
+         path = argv[arg];
+      }
+      else
+      {
+         repeat = 0;
+         break;
+      }
+   }
+   if (repeat <= 0)
+   {
+      fprintf(stderr, "usage: %s [-a accel] [-s sigma] [-n repeat] [track.csv]\n", argv[0]);
+      return 2;
+   }
+
+   if (path != NULL ? !replay_read(path) : !replay_synthesize())
+   {
+      fprintf(stderr, "%s: no fixes to replay\n", path != NULL ? path : "synthetic track");
+      return 1;
+   }
+
+   // One pass for the statistics
+   loc_eng_kf_reset(&kf);
+   for (i = 0; i < replay_count; i++)
+   {
+      fix = replay_fixes[i];
+      if (!loc_eng_kf_update(&kf, &fix))
+      {
+         rejected++;
+         continue;
+      }
+      used++;
+      if (replay_truth != NULL)
+      {
+         raw_error += replay_error_m(&replay_fixes[i], i);
+         smooth_error += replay_error_m(&fix, i);
+      }
+   }
+
+   // Then the timing, the filter restarts with each pass
+   start_nsec = replay_clock_nsec();
+   for (r = 0; r < repeat; r++)
+   {
+      loc_eng_kf_reset(&kf);
+      for (i = 0; i < replay_count; i++)
+      {
+         fix = replay_fixes[i];
+         loc_eng_kf_update(&kf, &fix);
+      }
+   }
+   elapsed_nsec = replay_clock_nsec() - start_nsec;
+
+   printf("%d fixes, %d rejected, SMOOTH_ACCEL %lu, OUTLIER_SIGMA %lu\n", replay_count,
+         rejected, gps_conf.SMOOTH_ACCEL, gps_conf.OUTLIER_SIGMA);
+   if (replay_truth != NULL && used > 0)
+   {
+      printf("RMS error of the fixes kept: raw %.2f m, smoothed %.2f m\n",
+            sqrt(raw_error / used), sqrt(smooth_error / used));
+   }
+   printf("%.3f us/fix over %d replays\n",
+         (double) elapsed_nsec / 1000.0 / ((double) repeat * replay_count), repeat);
+
+   free(replay_fixes);
+   free(replay_truth);
+   return 0;
+}
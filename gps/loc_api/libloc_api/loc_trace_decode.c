@@ -0,0 +1,252 @@
+/* Copyright (c) 2009,2011 Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * loc_trace_decode: host tool that turns a loc_eng binary trace ring, as
+ * pulled from the device (see TRACE_FILE in gps.conf), into CSV or JSON.
+ *
+ *    loc_trace_decode [-j] <trace file>
+ *
+ * CSV lines are "seq,time_msec,type,field=value,..." in write order; with
+ * -j one JSON object per record is written inside a JSON array.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "loc_eng_trace.h"
+
+typedef struct
+{
+   int                            json;
+} decode_out_s_type;
+
+static const char* trace_type_name(uint16_t type)
+{
+   switch (type)
+   {
+   case LOC_ENG_TRACE_POSITION:   return "position";
+   case LOC_ENG_TRACE_SV_SUMMARY: return "sv_summary";
+   case LOC_ENG_TRACE_SV:         return "sv";
+   case LOC_ENG_TRACE_STATUS:     return "status";
+   case LOC_ENG_TRACE_AGPS:       return "agps";
+   case LOC_ENG_TRACE_IOCTL:      return "ioctl";
+   case LOC_ENG_TRACE_QUEUE:      return "queue";
+   default:                       return "unknown";
+   }
+}
+
+/* Sorts records by write index */
+static int compare_seq(const void *a, const void *b)
+{
+   uint32_t seq_a = ((const loc_eng_trace_rec_s_type *) a)->seq;
+   uint32_t seq_b = ((const loc_eng_trace_rec_s_type *) b)->seq;
+   return seq_a < seq_b ? -1 : (seq_a > seq_b ? 1 : 0);
+}
+
+static void put_field(decode_out_s_type *out, const char *name, const char *fmt, double value)
+{
+   char value_str[32];
+
+   snprintf(value_str, sizeof value_str, fmt, value);
+   if (out->json)
+   {
+      printf(", \"%s\": %s", name, value_str);
+   }
+   else
+   {
+      printf(",%s=%s", name, value_str);
+   }
+}
+
+#define PUT_INT(out, name, value)    put_field(out, name, "%.0f", (double) (value))
+#define PUT_FLOAT(out, name, value)  put_field(out, name, "%.3f", (double) (value))
+#define PUT_DEG(out, name, value)    put_field(out, name, "%.7f", (double) (value) / 1e7)
+
+static void decode_record(decode_out_s_type *out, const loc_eng_trace_rec_s_type *rec)
+{
+   switch (rec->type)
+   {
+   case LOC_ENG_TRACE_POSITION:
+      PUT_DEG(out,   "latitude",         rec->u.position.latitude);
+      PUT_DEG(out,   "longitude",        rec->u.position.longitude);
+      PUT_FLOAT(out, "hor_unc_circular", rec->u.position.hor_unc_circular);
+      PUT_INT(out,   "valid_mask",       rec->u.position.valid_mask);
+      PUT_INT(out,   "session_status",   rec->u.position.session_status);
+      break;
+   case LOC_ENG_TRACE_SV_SUMMARY:
+      PUT_INT(out,   "sv_count",         rec->u.sv_summary.sv_count);
+      PUT_FLOAT(out, "position_dop",     rec->u.sv_summary.position_dop);
+      PUT_FLOAT(out, "horizontal_dop",   rec->u.sv_summary.horizontal_dop);
+      PUT_FLOAT(out, "vertical_dop",     rec->u.sv_summary.vertical_dop);
+      PUT_INT(out,   "altitude_assumed", rec->u.sv_summary.altitude_assumed);
+      PUT_INT(out,   "valid_mask",       rec->u.sv_summary.valid_mask);
+      break;
+   case LOC_ENG_TRACE_SV:
+      PUT_INT(out,   "system",           rec->u.sv.system);
+      PUT_INT(out,   "prn",              rec->u.sv.prn);
+      PUT_INT(out,   "health_status",    rec->u.sv.health_status);
+      PUT_INT(out,   "process_status",   rec->u.sv.process_status);
+      PUT_INT(out,   "has_eph",          rec->u.sv.has_eph);
+      PUT_INT(out,   "has_alm",          rec->u.sv.has_alm);
+      PUT_FLOAT(out, "elevation",        rec->u.sv.elevation);
+      PUT_FLOAT(out, "azimuth",          rec->u.sv.azimuth);
+      PUT_FLOAT(out, "snr",              rec->u.sv.snr);
+      PUT_INT(out,   "valid_mask",       rec->u.sv.valid_mask);
+      break;
+   case LOC_ENG_TRACE_STATUS:
+      PUT_INT(out,   "status",           rec->u.status.status);
+      break;
+   case LOC_ENG_TRACE_AGPS:
+      PUT_INT(out,   "status",           rec->u.agps.status);
+      PUT_INT(out,   "conn_handle",      rec->u.agps.conn_handle);
+      break;
+   case LOC_ENG_TRACE_IOCTL:
+      PUT_INT(out,   "ioctl_type",       rec->u.ioctl.ioctl_type);
+      PUT_INT(out,   "status",           rec->u.ioctl.status);
+      PUT_INT(out,   "latency_msec",     rec->u.ioctl.latency_msec);
+      PUT_INT(out,   "async",            rec->u.ioctl.async);
+      break;
+   case LOC_ENG_TRACE_QUEUE:
+      PUT_INT(out,   "cmd_type",         rec->u.queue.cmd_type);
+      PUT_INT(out,   "pending",          rec->u.queue.pending);
+      PUT_INT(out,   "latency_msec",     rec->u.queue.latency_msec);
+      PUT_INT(out,   "ioctls_in_flight", rec->u.queue.ioctls_in_flight);
+      PUT_INT(out,   "timers_armed",     rec->u.queue.timers_armed);
+      break;
+   default:
+      break;
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   loc_eng_trace_header_s_type header;
+   loc_eng_trace_rec_s_type *records;
+   decode_out_s_type out;
+   const char *path = NULL;
+   FILE *fp;
+   uint32_t i, count = 0;
+   int arg;
+
+   memset(&out, 0, sizeof out);
+   for (arg = 1; arg < argc; arg++)
+   {
+      if (strcmp(argv[arg], "-j") == 0)
+      {
+         out.json = 1;
+      }
+      else
+      {
+         path = argv[arg];
+      }
+   }
+   if (path == NULL)
+   {
+      fprintf(stderr, "usage: %s [-j] <trace file>\n", argv[0]);
+      return 2;
+   }
+
+   fp = fopen(path, "rb");
+   if (fp == NULL)
+   {
+      perror(path);
+      return 1;
+   }
+
+   if (fread(&header, sizeof header, 1, fp) != 1 ||
+       header.magic != LOC_ENG_TRACE_MAGIC)
+   {
+      fprintf(stderr, "%s: not a loc_eng trace\n", path);
+      fclose(fp);
+      return 1;
+   }
+   if (header.version != LOC_ENG_TRACE_VERSION ||
+       header.record_size != sizeof(loc_eng_trace_rec_s_type))
+   {
+      fprintf(stderr, "%s: unsupported trace version %u, record size %u\n",
+            path, (unsigned) header.version, (unsigned) header.record_size);
+      fclose(fp);
+      return 1;
+   }
+
+   records = (loc_eng_trace_rec_s_type *) calloc(header.record_count, sizeof *records);
+   if (records == NULL)
+   {
+      fclose(fp);
+      return 1;
+   }
+
+   /* Keep complete records only, the ring may have been copied mid-write */
+   for (i = 0; i < header.record_count; i++)
+   {
+      if (fread(&records[count], sizeof *records, 1, fp) != 1)
+      {
+         break;
+      }
+      if (records[count].seq != 0 && !(records[count].seq & LOC_ENG_TRACE_SEQ_BUSY))
+      {
+         count++;
+      }
+   }
+   fclose(fp);
+
+   qsort(records, count, sizeof *records, compare_seq);
+
+   if (out.json)
+   {
+      printf("[\n");
+   }
+   for (i = 0; i < count; i++)
+   {
+      const loc_eng_trace_rec_s_type *rec = &records[i];
+      if (out.json)
+      {
+         printf("  {\"seq\": %u, \"time_msec\": %u, \"type\": \"%s\"",
+               (unsigned) rec->seq, (unsigned) rec->time_msec, trace_type_name(rec->type));
+         decode_record(&out, rec);
+         printf("}%s\n", i + 1 < count ? "," : "");
+      }
+      else
+      {
+         printf("%u,%u,%s", (unsigned) rec->seq, (unsigned) rec->time_msec,
+               trace_type_name(rec->type));
+         decode_record(&out, rec);
+         printf("\n");
+      }
+   }
+   if (out.json)
+   {
+      printf("]\n");
+   }
+
+   free(records);
+   return 0;
+}
@@ -1,18 +1,6 @@
 LOCAL_PATH:= $(call my-dir)
-include $(CLEAR_VARS)
-
-LOCAL_MODULE_TAGS := optional
-
-LOCAL_PRELINK_MODULE:=false
-
-LOCAL_C_INCLUDES += $(LOCAL_PATH)\
-	$(LOCAL_PATH)/libexif/\
-	$(LOCAL_PATH)/libexif/canon/\
-	$(LOCAL_PATH)/libexif/fuji/\
-	$(LOCAL_PATH)/libexif/olympus/\
-	$(LOCAL_PATH)/libexif/pentax/
 
-LOCAL_SRC_FILES:=\
+libexifa_src_files :=\
 	canon/exif-mnote-data-canon.c\
 	canon/mnote-canon-tag.c\
 	canon/mnote-canon-entry.c\
@@ -20,6 +8,7 @@ LOCAL_SRC_FILES:=\
 	pentax/mnote-pentax-entry.c\
 	pentax/exif-mnote-data-pentax.c\
 	exif-loader.c\
+	exif-batch.c\
 	exif-byte-order.c\
 	exif-content.c\
 	exif-log.c\
@@ -38,9 +27,117 @@ LOCAL_SRC_FILES:=\
 	fuji/exif-mnote-data-fuji.c\
 	exif-mnote-data.c
 
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_PRELINK_MODULE:=false
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)\
+	$(LOCAL_PATH)/libexif/\
+	$(LOCAL_PATH)/libexif/canon/\
+	$(LOCAL_PATH)/libexif/fuji/\
+	$(LOCAL_PATH)/libexif/olympus/\
+	$(LOCAL_PATH)/libexif/pentax/
+
+LOCAL_SRC_FILES:= $(libexifa_src_files)
+
 #LOCAL_CFLAGS:=-O2 -g
 #LOCAL_CFLAGS+=-DHAVE_CONFIG_H -D_U_="__attribute__((unused))" -Dlinux -D__GLIBC__ -D_GNU_SOURCE
 
 LOCAL_MODULE:= libexifa
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)\
+	$(LOCAL_PATH)/libexif/
+
+LOCAL_SRC_FILES:=\
+	exifbatch.c
+
+LOCAL_SHARED_LIBRARIES:= \
+	libexifa
+
+LOCAL_MODULE:= exifbatch
+
+include $(BUILD_EXECUTABLE)
+
+# Host build of the library, for the tools and benchmarks below
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)\
+	$(LOCAL_PATH)/libexif/\
+	$(LOCAL_PATH)/libexif/canon/\
+	$(LOCAL_PATH)/libexif/fuji/\
+	$(LOCAL_PATH)/libexif/olympus/\
+	$(LOCAL_PATH)/libexif/pentax/
+
+LOCAL_SRC_FILES:= $(libexifa_src_files)
+
+LOCAL_MODULE:= libexifa_host
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+# Host benchmark of the EXIF writer
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)\
+	$(LOCAL_PATH)/libexif/
+
+LOCAL_SRC_FILES:=\
+	exifsavebench.c
+
+LOCAL_STATIC_LIBRARIES:= \
+	libexifa_host
+
+LOCAL_LDLIBS += -lpthread -lm -lrt
+
+LOCAL_MODULE:= exifsavebench
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Host build of exifbatch, to run it over a photo library on a workstation
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)\
+	$(LOCAL_PATH)/libexif/
+
+LOCAL_SRC_FILES:=\
+	exifbatch.c
+
+LOCAL_STATIC_LIBRARIES:= \
+	libexifa_host
+
+LOCAL_LDLIBS += -lpthread -lm -lrt
+
+LOCAL_MODULE:= exifbatch
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Host benchmark of exif_batch_load_files over 1, 2, 4, ... threads
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)\
+	$(LOCAL_PATH)/libexif/
+
+LOCAL_SRC_FILES:=\
+	exifbatchbench.c
+
+LOCAL_STATIC_LIBRARIES:= \
+	libexifa_host
+
+LOCAL_LDLIBS += -lpthread -lm -lrt
+
+LOCAL_MODULE:= exifbatchbench
+
+include $(BUILD_HOST_EXECUTABLE)
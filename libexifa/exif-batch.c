@@ -0,0 +1,240 @@
+/* exif-batch.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <config.h>
+
+#include <libexif/exif-batch.h>
+#include <libexif/exif-mem.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The JPEG markers the headers are scanned for */
+#define EXIF_BATCH_MARKER_SOI  0xd8
+#define EXIF_BATCH_MARKER_EOI  0xd9
+#define EXIF_BATCH_MARKER_SOS  0xda
+#define EXIF_BATCH_MARKER_APP1 0xe1
+
+/* Read at once, enough for the SOI, APP0 and APP1 headers of most files */
+#define EXIF_BATCH_PREFIX 4096
+
+/* Give up on files with more segments in front of the EXIF data */
+#define EXIF_BATCH_MAX_SEGMENTS 64
+
+/* Largest file of raw EXIF data that is loaded */
+#define EXIF_BATCH_MAX_RAW (16 * 1024 * 1024)
+
+static const unsigned char ExifHeader[] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
+
+typedef struct _ExifBatch ExifBatch;
+struct _ExifBatch
+{
+	const char * const *paths;
+	unsigned int count;
+	ExifDataOption options;
+	ExifBatchFunc func;
+	void *user_data;
+
+	/* Updated atomically by the workers */
+	unsigned int next;
+	unsigned int found;
+};
+
+/*! Read len bytes at offset o, from the prefix b where it has them */
+static int
+exif_batch_read (int fd, const unsigned char *b, unsigned int bs,
+		 unsigned char *d, unsigned int len, off_t o)
+{
+	unsigned int c;
+	ssize_t n;
+
+	if (o < bs) {
+		c = (len < bs - o) ? len : bs - o;
+		memcpy (d, b + o, c);
+		d += c;
+		len -= c;
+		o += c;
+	}
+	while (len) {
+		n = pread (fd, d, len, o);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+			return 0;
+		d += n;
+		len -= n;
+		o += n;
+	}
+	return 1;
+}
+
+/*! Find the EXIF data of a file, reading only the segment headers in
+ *  front of it.
+ * \return the EXIF data allocated from mem, NULL if there is none
+ */
+static unsigned char *
+exif_batch_read_exif (int fd, ExifMem *mem, unsigned int *size)
+{
+	unsigned char b[EXIF_BATCH_PREFIX], h[4], *d;
+	unsigned int bs, i, len;
+	struct stat st;
+	ssize_t n;
+	off_t o;
+
+	do
+		n = pread (fd, b, sizeof (b), 0);
+	while ((n < 0) && (errno == EINTR));
+	if (n < (ssize_t) sizeof (ExifHeader))
+		return NULL;
+	bs = n;
+
+	/* Raw EXIF data */
+	if (!memcmp (b, ExifHeader, sizeof (ExifHeader))) {
+		if (fstat (fd, &st) || (st.st_size > EXIF_BATCH_MAX_RAW))
+			return NULL;
+		len = st.st_size;
+		d = exif_mem_alloc (mem, len);
+		if (!d || !exif_batch_read (fd, b, bs, d, len, 0))
+			return NULL;
+		*size = len;
+		return d;
+	}
+
+	if ((b[0] != 0xff) || (b[1] != EXIF_BATCH_MARKER_SOI))
+		return NULL;
+	for (o = 2, i = 0; i < EXIF_BATCH_MAX_SEGMENTS; i++) {
+		if (!exif_batch_read (fd, b, bs, h, sizeof (h), o))
+			return NULL;
+		if (h[0] != 0xff)
+			return NULL;
+
+		/* Fill bytes may precede a marker */
+		if (h[1] == 0xff) {
+			o++;
+			continue;
+		}
+		if ((h[1] == EXIF_BATCH_MARKER_SOS) ||
+		    (h[1] == EXIF_BATCH_MARKER_EOI))
+			return NULL;
+		len = (h[2] << 8) | h[3];
+		if (len < 2)
+			return NULL;
+
+		/* Other APP1 segments hold XMP data */
+		if ((h[1] == EXIF_BATCH_MARKER_APP1) &&
+		    (len - 2 >= sizeof (ExifHeader))) {
+			d = exif_mem_alloc (mem, len - 2);
+			if (!d || !exif_batch_read (fd, b, bs, d, len - 2, o + 4))
+				return NULL;
+			if (!memcmp (d, ExifHeader, sizeof (ExifHeader))) {
+				*size = len - 2;
+				return d;
+			}
+			exif_mem_free (mem, d);
+		}
+		o += 2 + len;
+	}
+	return NULL;
+}
+
+static void *
+exif_batch_worker (void *p)
+{
+	ExifBatch *b = p;
+	ExifMem *mem;
+	ExifData *data;
+	unsigned char *d;
+	unsigned int i, size, found = 0;
+	int fd;
+
+	/*
+	 * Everything for one file comes from the arena of the thread and
+	 * is released at once before the next file. The data can thus
+	 * borrow the buffer it is loaded from.
+	 */
+	mem = exif_mem_new_arena (0);
+	while ((i = __sync_fetch_and_add (&b->next, 1)) < b->count) {
+		data = NULL;
+		fd = mem ? open (b->paths[i], O_RDONLY) : -1;
+		if (fd >= 0) {
+			d = exif_batch_read_exif (fd, mem, &size);
+			close (fd);
+			if (d)
+				data = exif_data_new_mem (mem);
+			if (data) {
+				exif_data_set_option (data, b->options |
+					EXIF_DATA_OPTION_BORROW_DATA);
+				exif_data_load_data (data, d, size);
+				found++;
+			}
+		}
+		b->func (i, b->paths[i], data, b->user_data);
+		exif_data_unref (data);
+		exif_mem_arena_reset (mem);
+	}
+	exif_mem_unref (mem);
+	__sync_fetch_and_add (&b->found, found);
+	return NULL;
+}
+
+unsigned int
+exif_batch_load_files (const char * const *paths, unsigned int count,
+		       unsigned int threads, ExifDataOption options,
+		       ExifBatchFunc func, void *user_data)
+{
+	ExifBatch b;
+	pthread_t *t;
+	unsigned int i, n = 0;
+	long cpus;
+
+	if (!paths || !func)
+		return 0;
+
+	memset (&b, 0, sizeof (b));
+	b.paths = paths;
+	b.count = count;
+	b.options = options;
+	b.func = func;
+	b.user_data = user_data;
+
+	if (!threads) {
+		cpus = sysconf (_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? cpus : 1;
+	}
+	if (threads > count)
+		threads = count;
+
+	/* The calling thread is one of the workers */
+	t = (threads > 1) ? malloc (sizeof (pthread_t) * (threads - 1)) : NULL;
+	if (t)
+		for (n = 0; n < threads - 1; n++)
+			if (pthread_create (&t[n], NULL, exif_batch_worker, &b))
+				break;
+	exif_batch_worker (&b);
+	for (i = 0; i < n; i++)
+		pthread_join (t[i], NULL);
+	free (t);
+
+	return b.found;
+}
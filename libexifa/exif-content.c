@@ -31,14 +31,92 @@
  * static const unsigned char ExifHeader[] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
  */
 
+/* IFDs with up to this many entries are searched linearly */
+#define EXIF_CONTENT_INDEX_MIN   8
+#define EXIF_CONTENT_INDEX_EMPTY 0xffff
+
 struct _ExifContentPrivate
 {
 	unsigned int ref_count;
 
 	ExifMem *mem;
 	ExifLog *log;
+
+	/* Slots allocated at entries, valid as long as entries is unchanged */
+	ExifEntry **alloc_entries;
+	unsigned int alloc_size;
+
+	/*
+	 * Open addressing index of the entries by tag, holding positions in
+	 * entries. It describes indexed_count entries at indexed_entries and
+	 * is rebuilt on the next lookup when it does not match the public
+	 * fields any more or when it is marked dirty.
+	 */
+	unsigned short *index;
+	unsigned int index_bits;
+	ExifEntry **indexed_entries;
+	unsigned int indexed_count;
+	unsigned int dirty;
 };
 
+static unsigned int
+exif_content_index_hash (ExifTag tag, unsigned int bits)
+{
+	return ((unsigned int) tag * 2654435761U) >> (32 - bits);
+}
+
+static void
+exif_content_index_insert (ExifContent *c, unsigned int pos)
+{
+	ExifContentPrivate *p = c->priv;
+	unsigned int mask = (1 << p->index_bits) - 1;
+	unsigned int h = exif_content_index_hash (c->entries[pos]->tag,
+						  p->index_bits);
+
+	while (p->index[h] != EXIF_CONTENT_INDEX_EMPTY)
+		h = (h + 1) & mask;
+	p->index[h] = pos;
+}
+
+/*! Make the index match the entries.
+ * \return 1 if the index can be used, 0 if the entries must be scanned
+ */
+static int
+exif_content_index_update (ExifContent *c)
+{
+	ExifContentPrivate *p = c->priv;
+	unsigned int i, bits = 4;
+
+	if ((c->count <= EXIF_CONTENT_INDEX_MIN) ||
+	    (c->count >= EXIF_CONTENT_INDEX_EMPTY))
+		return 0;
+	if (p->index && !p->dirty && (p->indexed_entries == c->entries) &&
+	    (p->indexed_count == c->count))
+		return 1;
+
+	/* Keep the index at most half full */
+	while ((1U << bits) < 2 * c->count)
+		bits++;
+	if (bits != p->index_bits) {
+		exif_mem_free (p->mem, p->index);
+		p->index = exif_mem_alloc (p->mem,
+				sizeof (unsigned short) << bits);
+		if (!p->index) {
+			p->index_bits = 0;
+			return 0;
+		}
+		p->index_bits = bits;
+	}
+	memset (p->index, 0xff, sizeof (unsigned short) << bits);
+	for (i = 0; i < c->count; i++)
+		if (c->entries[i])
+			exif_content_index_insert (c, i);
+	p->indexed_entries = c->entries;
+	p->indexed_count = c->count;
+	p->dirty = 0;
+	return 1;
+}
+
 ExifContent *
 exif_content_new (void)
 {
@@ -103,6 +181,7 @@ exif_content_free (ExifContent *content)
 
 	if (content->priv) {
 		exif_log_unref (content->priv->log);
+		exif_mem_free (mem, content->priv->index);
 	}
 
 	exif_mem_free (mem, content->priv);
@@ -132,8 +211,13 @@ exif_content_dump (ExifContent *content, unsigned int indent)
 void
 exif_content_add_entry (ExifContent *c, ExifEntry *entry)
 {
+	ExifContentPrivate *p;
 	ExifEntry **entries;
+	unsigned int size;
+	int indexed;
+
 	if (!c || !c->priv || !entry || entry->parent) return;
+	p = c->priv;
 
 	/* One tag can only be added once to an IFD. */
 	if (exif_content_get_entry (c, entry->tag)) {
@@ -144,20 +228,44 @@ exif_content_add_entry (ExifContent *c, ExifEntry *entry)
 		return;
 	}
 
-	entries = exif_mem_realloc (c->priv->mem,
-		c->entries, sizeof (ExifEntry*) * (c->count + 1));
-	if (!entries) return;
+	/*
+	 * Grow geometrically. Only trust the capacity of an array allocated
+	 * here, the public fields may have been changed behind our back.
+	 */
+	indexed = exif_content_index_update (c);
+	size = (p->alloc_entries == c->entries) ? p->alloc_size : c->count;
+	if (c->count == size) {
+		size = size ? 2 * size : 4;
+		entries = exif_mem_realloc (p->mem, c->entries,
+					    sizeof (ExifEntry*) * size);
+		if (!entries) return;
+		if (indexed && (p->indexed_entries == c->entries))
+			p->indexed_entries = entries;
+		c->entries = entries;
+		p->alloc_entries = entries;
+		p->alloc_size = size;
+	}
 	entry->parent = c;
-	entries[c->count++] = entry;
-	c->entries = entries;
+	c->entries[c->count++] = entry;
 	exif_entry_ref (entry);
+
+	/*
+	 * Entries are sometimes added before their tag is set (see
+	 * exif_content_fix), index those again on the next lookup.
+	 */
+	if (!indexed || !entry->tag ||
+	    (2 * c->count > (1U << p->index_bits)))
+		p->dirty = 1;
+	else {
+		exif_content_index_insert (c, c->count - 1);
+		p->indexed_count = c->count;
+	}
 }
 
 void
 exif_content_remove_entry (ExifContent *c, ExifEntry *e)
 {
 	unsigned int i;
-	ExifEntry **t, *temp;
 
 	if (!c || !c->priv || !e || (e->parent != c)) return;
 
@@ -169,25 +277,19 @@ exif_content_remove_entry (ExifContent *c, ExifEntry *e)
 	if (i == c->count)
 			return;
 
-	/* Remove the entry */
-	temp = c->entries[c->count-1];
+	/* Remove the entry, keeping the order of the others */
 	if (c->count > 1) {
-		t = exif_mem_realloc (c->priv->mem, c->entries,
-					sizeof(ExifEntry*) * (c->count - 1));
-		if (!t) {
-			return;
-		}
-		c->entries = t;
+		memmove (&c->entries[i], &c->entries[i + 1],
+			 sizeof (ExifEntry*) * (c->count - i - 1));
 		c->count--;
-		if (i != c->count) { /* we deallocated the last slot already */ 
-			memmove (&t[i], &t[i + 1], sizeof (ExifEntry*) * (c->count - i - 1));
-			t[c->count-1] = temp;
-		} 
 	} else {
 		exif_mem_free (c->priv->mem, c->entries);
 		c->entries = NULL;
 		c->count = 0;
+		c->priv->alloc_entries = NULL;
+		c->priv->alloc_size = 0;
 	}
+	c->priv->dirty = 1;
 	e->parent = NULL;
 	exif_entry_unref (e);
 }
@@ -195,11 +297,24 @@ exif_content_remove_entry (ExifContent *c, ExifEntry *e)
 ExifEntry *
 exif_content_get_entry (ExifContent *content, ExifTag tag)
 {
-	unsigned int i;
+	unsigned int i, h, mask;
+	ExifEntry *e;
 
 	if (!content)
 		return (NULL);
 
+	if (content->priv && exif_content_index_update (content)) {
+		mask = (1 << content->priv->index_bits) - 1;
+		for (h = exif_content_index_hash (tag, content->priv->index_bits);
+		     content->priv->index[h] != EXIF_CONTENT_INDEX_EMPTY;
+		     h = (h + 1) & mask) {
+			e = content->entries[content->priv->index[h]];
+			if (e->tag == tag)
+				return (e);
+		}
+		return (NULL);
+	}
+
 	for (i = 0; i < content->count; i++)
 		if (content->entries[i]->tag == tag)
 			return (content->entries[i]);
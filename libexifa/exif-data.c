@@ -48,6 +48,10 @@
 
 static const unsigned char ExifHeader[] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
 
+/* These functions are hidden in exif-entry.c */
+void exif_entry_borrow_data (ExifEntry *, const unsigned char *, unsigned int);
+void exif_entry_free_data (ExifEntry *);
+
 struct _ExifDataPrivate
 {
 	ExifByteOrder order;
@@ -62,10 +66,23 @@ struct _ExifDataPrivate
 	/* Temporarily used while loading data */
 	unsigned int offset_mnote;
 
+	/* Thumbnail as borrowed from a loaded buffer, NULL if it was allocated */
+	const unsigned char *thumbnail_borrowed;
+
 	ExifDataOption options;
 	ExifDataType data_type;
 };
 
+static void
+exif_data_free_thumbnail (ExifData *data)
+{
+	if (data->data && (data->data != data->priv->thumbnail_borrowed))
+		exif_mem_free (data->priv->mem, data->data);
+	data->data = NULL;
+	data->size = 0;
+	data->priv->thumbnail_borrowed = NULL;
+}
+
 static void *
 exif_data_alloc (ExifData *data, unsigned int i)
 {
@@ -197,8 +214,9 @@ exif_data_load_data_entry (ExifData *data, ExifEntry *entry,
 		return 0;
 	}
 
-	entry->data = exif_data_alloc (data, s);
-	if (entry->data) {
+	if (data->priv->options & EXIF_DATA_OPTION_BORROW_DATA) {
+		exif_entry_borrow_data (entry, d + doff, s);
+	} else if ((entry->data = exif_data_alloc (data, s))) {
 		entry->size = s;
 		memcpy (entry->data, d + doff, s);
 	} else {
@@ -225,84 +243,6 @@ exif_data_load_data_entry (ExifData *data, ExifEntry *entry,
 	return 1;
 }
 
-static void
-exif_data_save_data_entry (ExifData *data, ExifEntry *e,
-			   unsigned char **d, unsigned int *ds,
-			   unsigned int offset)
-{
-	unsigned int doff, s;
-	unsigned int ts;
-
-	if (!data || !data->priv) 
-		return;
-
-	/*
-	 * Each entry is 12 bytes long. The memory for the entry has
-	 * already been allocated.
-	 */
-	exif_set_short (*d + 6 + offset + 0,
-			data->priv->order, (ExifShort) e->tag);
-	exif_set_short (*d + 6 + offset + 2,
-			data->priv->order, (ExifShort) e->format);
-
-	if (!(data->priv->options & EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE)) {
-		/* If this is the maker note tag, update it. */
-		if ((e->tag == EXIF_TAG_MAKER_NOTE) && data->priv->md) {
-			/* TODO: this is using the wrong ExifMem to free e->data */
-			exif_mem_free (data->priv->mem, e->data);
-			e->data = NULL;
-			e->size = 0;
-			exif_mnote_data_set_offset (data->priv->md, *ds - 6);
-			exif_mnote_data_save (data->priv->md, &e->data, &e->size);
-			e->components = e->size;
-		}
-	}
-
-	exif_set_long  (*d + 6 + offset + 4,
-			data->priv->order, e->components);
-
-	/*
-	 * Size? If bigger than 4 bytes, the actual data is not in
-	 * the entry but somewhere else.
-	 */
-	s = exif_format_get_size (e->format) * e->components;
-	if (s > 4) {
-		unsigned char *t;
-		doff = *ds - 6;
-		ts = *ds + s;
-
-		/*
-		 * According to the TIFF specification,
-		 * the offset must be an even number. If we need to introduce
-		 * a padding byte, we set it to 0.
-		 */
-		if (s & 1)
-			ts++;
-		t = exif_mem_realloc (data->priv->mem, *d, ts);
-		if (!t) {
-			EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData", ts);
-		  	return;
-		}
-		*d = t;
-		*ds = ts;
-		exif_set_long (*d + 6 + offset + 8, data->priv->order, doff);
-		if (s & 1) 
-			*(*d + *ds - 1) = '\0';
-
-	} else
-		doff = offset + 8;
-
-	/* Write the data. Fill unneeded bytes with 0. Do not crash with
-	 * e->data is NULL */
-	if (e->data) {
-		memcpy (*d + 6 + doff, e->data, s);
-	} else {
-		memset (*d + 6 + doff, 0, s);
-	}
-	if (s < 4) 
-		memset (*d + 6 + doff + s, 0, (4 - s));
-}
-
 static void
 exif_data_load_data_thumbnail (ExifData *data, const unsigned char *d,
 			       unsigned int ds, ExifLong o, ExifLong s)
@@ -315,11 +255,15 @@ exif_data_load_data_thumbnail (ExifData *data, const unsigned char *d,
 		return;
 	}
 
-	if (data->data) 
-		exif_mem_free (data->priv->mem, data->data);
+	exif_data_free_thumbnail (data);
+	if (data->priv->options & EXIF_DATA_OPTION_BORROW_DATA) {
+		data->data = (unsigned char *) d + o;
+		data->size = s;
+		data->priv->thumbnail_borrowed = d + o;
+		return;
+	}
 	if (!(data->data = exif_data_alloc (data, s))) {
 		EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData", s);
-		data->size = 0;
 		return;
 	}
 	data->size = s;
@@ -503,17 +447,112 @@ cmp_func_motorola (const void *elem1, const void *elem2)
 			 (const unsigned char *) elem2, EXIF_BYTE_ORDER_MOTOROLA);
 }
 
+/*
+ * EXIF data is saved in two passes over the same layout. The first pass only
+ * measures (w->d is NULL) and regenerates the MakerNote, the second one writes
+ * into a buffer of exactly the measured size, so no directory or value is
+ * ever moved. A measuring pass with keep_maker_note set only checks the size
+ * of a layout measured before. The layout is: header, IFD 0 and its values, the EXIF IFD and
+ * its values followed by the Interoperability IFD, the GPS IFD, then IFD 1,
+ * its values and the thumbnail.
+ */
+typedef struct _ExifDataWriter ExifDataWriter;
+struct _ExifDataWriter {
+	unsigned char *d;	/* NULL while measuring */
+	unsigned int ds;	/* bytes laid out so far, including the header */
+	int keep_maker_note;	/* do not regenerate it while measuring */
+};
+
+static void
+exif_data_save_data_entry (ExifData *data, ExifEntry *e,
+			   ExifDataWriter *w, unsigned int offset)
+{
+	unsigned int doff, s, n;
+
+	if (!data || !data->priv) 
+		return;
+
+	if (!w->d && !w->keep_maker_note &&
+	    !(data->priv->options & EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE)) {
+		/*
+		 * If this is the maker note tag, update it. Its size is only
+		 * known once it has been saved at its final offset.
+		 */
+		if ((e->tag == EXIF_TAG_MAKER_NOTE) && data->priv->md) {
+			exif_entry_free_data (e);
+			exif_mnote_data_set_offset (data->priv->md, w->ds - 6);
+			exif_mnote_data_save (data->priv->md, &e->data, &e->size);
+			e->components = e->size;
+		}
+	}
+
+	/*
+	 * Size? If bigger than 4 bytes, the actual data is not in
+	 * the entry but somewhere else.
+	 *
+	 * According to the TIFF specification,
+	 * the offset must be an even number. If we need to introduce
+	 * a padding byte, we set it to 0.
+	 */
+	s = exif_format_get_size (e->format) * e->components;
+	if (s > 4) {
+		doff = w->ds - 6;
+		w->ds += s + (s & 1);
+	} else
+		doff = offset + 8;
+
+	if (!w->d)
+		return;
+
+	/*
+	 * Each entry is 12 bytes long. The memory for the entry has
+	 * already been laid out.
+	 */
+	exif_set_short (w->d + 6 + offset + 0,
+			data->priv->order, (ExifShort) e->tag);
+	exif_set_short (w->d + 6 + offset + 2,
+			data->priv->order, (ExifShort) e->format);
+	exif_set_long  (w->d + 6 + offset + 4,
+			data->priv->order, e->components);
+	if (s > 4) {
+		exif_set_long (w->d + 6 + offset + 8, data->priv->order, doff);
+		if (s & 1)
+			*(w->d + 6 + doff + s) = '\0';
+	}
+
+	/* Write the data. Fill unneeded bytes with 0. Do not crash with
+	 * e->data is NULL or shorter than its components */
+	n = e->data ? MIN (s, e->size) : 0;
+	if (n)
+		memcpy (w->d + 6 + doff, e->data, n);
+	if (n < s)
+		memset (w->d + 6 + doff + n, 0, s - n);
+	if (s < 4) 
+		memset (w->d + 6 + doff + s, 0, (4 - s));
+}
+
+static void
+exif_data_save_data_pointer (ExifData *data, ExifDataWriter *w,
+			     unsigned int offset, ExifTag tag, ExifLong value)
+{
+	if (!w->d)
+		return;
+
+	exif_set_short (w->d + 6 + offset + 0, data->priv->order, tag);
+	exif_set_short (w->d + 6 + offset + 2, data->priv->order,
+			EXIF_FORMAT_LONG);
+	exif_set_long  (w->d + 6 + offset + 4, data->priv->order, 1);
+	exif_set_long  (w->d + 6 + offset + 8, data->priv->order, value);
+}
+
 static void
 exif_data_save_data_content (ExifData *data, ExifContent *ifd,
-			     unsigned char **d, unsigned int *ds,
-			     unsigned int offset)
+			     ExifDataWriter *w, unsigned int offset)
 {
 	unsigned int j, n_ptr = 0, n_thumb = 0;
 	ExifIfd i;
-	unsigned char *t;
-	unsigned int ts;
 
-	if (!data || !data->priv || !ifd || !d || !ds) 
+	if (!data || !data->priv || !ifd || !w) 
 		return;
 
 	for (i = 0; i < EXIF_IFD_COUNT; i++)
@@ -553,34 +592,30 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 	}
 
 	/*
-	 * Allocate enough memory for all entries
-	 * and the number of entries.
+	 * Lay out all entries and the number of entries.
 	 */
-	ts = *ds + (2 + (ifd->count + n_ptr + n_thumb) * 12 + 4);
-	t = exif_mem_realloc (data->priv->mem, *d, ts);
-	if (!t) {
-		EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData", ts);
-	  	return;
-	}
-	*d = t;
-	*ds = ts;
+	w->ds += 2 + (ifd->count + n_ptr + n_thumb) * 12 + 4;
 
 	/* Save the number of entries */
-	exif_set_short (*d + 6 + offset, data->priv->order,
-			(ExifShort) (ifd->count + n_ptr + n_thumb));
+	if (w->d)
+		exif_set_short (w->d + 6 + offset, data->priv->order,
+				(ExifShort) (ifd->count + n_ptr + n_thumb));
 	offset += 2;
 
 	/*
 	 * Save each entry. Make sure that no memcpys from NULL pointers are
 	 * performed
 	 */
-	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
-		  "Saving %i entries (IFD '%s', offset: %i)...",
-		  ifd->count, exif_ifd_get_name (i), offset);
+	if (w->d)
+		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+			  "Saving %i entries (IFD '%s', offset: %i)...",
+			  ifd->count, exif_ifd_get_name (i), offset);
 	for (j = 0; j < ifd->count; j++) {
 		if (ifd->entries[j]) {
-			exif_data_save_data_entry (data, ifd->entries[j], d, ds,
+			exif_data_save_data_entry (data, ifd->entries[j], w,
 				offset + 12 * j);
+		} else if (w->d) {
+			memset (w->d + 6 + offset + 12 * j, 0, 12);
 		}
 	}
 
@@ -598,31 +633,19 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 		 */
 		if (data->ifd[EXIF_IFD_EXIF]->count ||
 		    data->ifd[EXIF_IFD_INTEROPERABILITY]->count) {
-			exif_set_short (*d + 6 + offset + 0, data->priv->order,
-					EXIF_TAG_EXIF_IFD_POINTER);
-			exif_set_short (*d + 6 + offset + 2, data->priv->order,
-					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, data->priv->order,
-					1);
-			exif_set_long  (*d + 6 + offset + 8, data->priv->order,
-					*ds - 6);
+			exif_data_save_data_pointer (data, w, offset,
+					EXIF_TAG_EXIF_IFD_POINTER, w->ds - 6);
 			exif_data_save_data_content (data,
-						     data->ifd[EXIF_IFD_EXIF], d, ds, *ds - 6);
+						     data->ifd[EXIF_IFD_EXIF], w, w->ds - 6);
 			offset += 12;
 		}
 
 		/* The pointer to IFD_GPS is in IFD_0, too. */
 		if (data->ifd[EXIF_IFD_GPS]->count) {
-			exif_set_short (*d + 6 + offset + 0, data->priv->order,
-					EXIF_TAG_GPS_INFO_IFD_POINTER);
-			exif_set_short (*d + 6 + offset + 2, data->priv->order,
-					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, data->priv->order,
-					1);
-			exif_set_long  (*d + 6 + offset + 8, data->priv->order,
-					*ds - 6);
+			exif_data_save_data_pointer (data, w, offset,
+					EXIF_TAG_GPS_INFO_IFD_POINTER, w->ds - 6);
 			exif_data_save_data_content (data,
-						     data->ifd[EXIF_IFD_GPS], d, ds, *ds - 6);
+						     data->ifd[EXIF_IFD_GPS], w, w->ds - 6);
 			offset += 12;
 		}
 
@@ -634,17 +657,11 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 		 * See note above.
 		 */
 		if (data->ifd[EXIF_IFD_INTEROPERABILITY]->count) {
-			exif_set_short (*d + 6 + offset + 0, data->priv->order,
-					EXIF_TAG_INTEROPERABILITY_IFD_POINTER);
-			exif_set_short (*d + 6 + offset + 2, data->priv->order,
-					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, data->priv->order,
-					1);
-			exif_set_long  (*d + 6 + offset + 8, data->priv->order,
-					*ds - 6);
+			exif_data_save_data_pointer (data, w, offset,
+					EXIF_TAG_INTEROPERABILITY_IFD_POINTER, w->ds - 6);
 			exif_data_save_data_content (data,
-						     data->ifd[EXIF_IFD_INTEROPERABILITY], d, ds,
-						     *ds - 6);
+						     data->ifd[EXIF_IFD_INTEROPERABILITY], w,
+						     w->ds - 6);
 			offset += 12;
 		}
 
@@ -658,35 +675,16 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 		if (data->size) {
 
 			/* EXIF_TAG_JPEG_INTERCHANGE_FORMAT */
-			exif_set_short (*d + 6 + offset + 0, data->priv->order,
-					EXIF_TAG_JPEG_INTERCHANGE_FORMAT);
-			exif_set_short (*d + 6 + offset + 2, data->priv->order,
-					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, data->priv->order,
-					1);
-			exif_set_long  (*d + 6 + offset + 8, data->priv->order,
-					*ds - 6);
-			ts = *ds + data->size;
-			t = exif_mem_realloc (data->priv->mem, *d, ts);
-			if (!t) {
-				EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData",
-						    ts);
-			  	return;
-			}
-			*d = t;
-			*ds = ts;
-			memcpy (*d + *ds - data->size, data->data, data->size);
+			exif_data_save_data_pointer (data, w, offset,
+					EXIF_TAG_JPEG_INTERCHANGE_FORMAT, w->ds - 6);
+			if (w->d)
+				memcpy (w->d + w->ds, data->data, data->size);
+			w->ds += data->size;
 			offset += 12;
 
 			/* EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH */
-			exif_set_short (*d + 6 + offset + 0, data->priv->order,
-					EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH);
-			exif_set_short (*d + 6 + offset + 2, data->priv->order,
-					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, data->priv->order,
-					1);
-			exif_set_long  (*d + 6 + offset + 8, data->priv->order,
-					data->size);
+			exif_data_save_data_pointer (data, w, offset,
+					EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH, data->size);
 			offset += 12;
 		}
 
@@ -696,9 +694,10 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 	}
 
 	/* Sort the directory according to TIFF specification */
-	qsort (*d + 6 + offset - (ifd->count + n_ptr + n_thumb) * 12,
-	       (ifd->count + n_ptr + n_thumb), 12,
-	       (data->priv->order == EXIF_BYTE_ORDER_INTEL) ? cmp_func_intel : cmp_func_motorola);
+	if (w->d)
+		qsort (w->d + 6 + offset - (ifd->count + n_ptr + n_thumb) * 12,
+		       (ifd->count + n_ptr + n_thumb), 12,
+		       (data->priv->order == EXIF_BYTE_ORDER_INTEL) ? cmp_func_intel : cmp_func_motorola);
 
 	/* Correctly terminate the directory */
 	if (i == EXIF_IFD_0 && (data->ifd[EXIF_IFD_1]->count ||
@@ -708,11 +707,12 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 		 * We are saving IFD 0. Tell where IFD 1 starts and save
 		 * IFD 1.
 		 */
-		exif_set_long (*d + 6 + offset, data->priv->order, *ds - 6);
-		exif_data_save_data_content (data, data->ifd[EXIF_IFD_1], d, ds,
-					     *ds - 6);
-	} else
-		exif_set_long (*d + 6 + offset, data->priv->order, 0);
+		if (w->d)
+			exif_set_long (w->d + 6 + offset, data->priv->order, w->ds - 6);
+		exif_data_save_data_content (data, data->ifd[EXIF_IFD_1], w,
+					     w->ds - 6);
+	} else if (w->d)
+		exif_set_long (w->d + 6 + offset, data->priv->order, 0);
 }
 
 typedef enum {
@@ -942,49 +942,126 @@ exif_data_load_data (ExifData *data, const unsigned char *d_orig,
 		exif_data_fix (data);
 }
 
+/*! Lay out the whole EXIF block, see #ExifDataWriter.
+ *
+ * \param[in] data EXIF data
+ * \param[out] d buffer of the size returned by the measuring pass, or NULL
+ *   to measure
+ * \param[in] keep_maker_note measure without regenerating the MakerNote
+ * \return number of bytes of EXIF data
+ */
+static unsigned int
+exif_data_save_data_layout (ExifData *data, unsigned char *d,
+			    int keep_maker_note)
+{
+	ExifDataWriter w;
+
+	w.d = d;
+	w.ds = 14;	/* Header */
+	w.keep_maker_note = keep_maker_note;
+
+	if (d) {
+		memcpy (d, ExifHeader, 6);
+
+		/* Order (offset 6) */
+		if (data->priv->order == EXIF_BYTE_ORDER_INTEL) {
+			memcpy (d + 6, "II", 2);
+		} else {
+			memcpy (d + 6, "MM", 2);
+		}
+
+		/* Fixed value (2 bytes, offset 8) */
+		exif_set_short (d + 8, data->priv->order, 0x002a);
+
+		/*
+		 * IFD 0 offset (4 bytes, offset 10).
+		 * We will start 8 bytes after the
+		 * EXIF header (2 bytes for order, another 2 for the test, and
+		 * 4 bytes for the IFD 0 offset make 8 bytes together).
+		 */
+		exif_set_long (d + 10, data->priv->order, 8);
+	}
+
+	/* Now save IFD 0. IFD 1 will be saved automatically. */
+	exif_data_save_data_content (data, data->ifd[EXIF_IFD_0], &w,
+				     w.ds - 6);
+	return w.ds;
+}
+
 void
 exif_data_save_data (ExifData *data, unsigned char **d, unsigned int *ds)
 {
+	unsigned int size;
+
 	if (ds)
 		*ds = 0;	/* This means something went wrong */
 
-	if (!data || !d || !ds)
+	if (!data || !data->priv || !d || !ds)
 		return;
 
-	/* Header */
-	*ds = 14;
-	*d = exif_data_alloc (data, *ds);
-	if (!*d)  {
-		*ds = 0;
+	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+		  "Saving IFDs...");
+	size = exif_data_save_data_layout (data, NULL, 0);
+	*d = exif_data_alloc (data, size);
+	if (!*d)
 		return;
-	}
-	memcpy (*d, ExifHeader, 6);
+	exif_data_save_data_layout (data, *d, 0);
+	*ds = size;
+	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+		  "Saved %i byte(s) EXIF data.", *ds);
+}
 
-	/* Order (offset 6) */
-	if (data->priv->order == EXIF_BYTE_ORDER_INTEL) {
-		memcpy (*d + 6, "II", 2);
-	} else {
-		memcpy (*d + 6, "MM", 2);
-	}
+unsigned int
+exif_data_save_data_size (ExifData *data)
+{
+	if (!data || !data->priv)
+		return 0;
 
-	/* Fixed value (2 bytes, offset 8) */
-	exif_set_short (*d + 8, data->priv->order, 0x002a);
+	return exif_data_save_data_layout (data, NULL, 0);
+}
 
-	/*
-	 * IFD 0 offset (4 bytes, offset 10).
-	 * We will start 8 bytes after the
-	 * EXIF header (2 bytes for order, another 2 for the test, and
-	 * 4 bytes for the IFD 0 offset make 8 bytes together).
-	 */
-	exif_set_long (*d + 10, data->priv->order, 8);
+unsigned int
+exif_data_save_data_buf (ExifData *data, unsigned char *d, unsigned int size)
+{
+	unsigned int ds;
 
-	/* Now save IFD 0. IFD 1 will be saved automatically. */
+	if (!data || !data->priv || !d)
+		return 0;
+
+	ds = exif_data_save_data_layout (data, NULL, 0);
+	if (ds > size) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+			  "Buffer too small for EXIF data (%u > %u).", ds, size);
+		return 0;
+	}
+	exif_data_save_data_layout (data, d, 0);
 	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
-		  "Saving IFDs...");
-	exif_data_save_data_content (data, data->ifd[EXIF_IFD_0], d, ds,
-				     *ds - 6);
+		  "Saved %i byte(s) EXIF data.", ds);
+	return ds;
+}
+
+unsigned int
+exif_data_save_data_measured (ExifData *data, unsigned char *d,
+			      unsigned int size)
+{
+	unsigned int ds;
+
+	if (!data || !data->priv)
+		return 0;
+
+	/* Only the offsets are computed again, the MakerNote is kept */
+	ds = exif_data_save_data_layout (data, NULL, 1);
+	if (!d)
+		return ds;
+	if (ds > size) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+			  "Buffer too small for EXIF data (%u > %u).", ds, size);
+		return 0;
+	}
+	exif_data_save_data_layout (data, d, 1);
 	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
-		  "Saved %i byte(s) EXIF data.", *ds);
+		  "Saved %i byte(s) EXIF data.", ds);
+	return ds;
 }
 
 ExifData *
@@ -1037,12 +1114,8 @@ exif_data_free (ExifData *data)
 		}
 	}
 
-	if (data->data) {
-		exif_mem_free (mem, data->data);
-		data->data = NULL;
-	}
-
 	if (data->priv) {
+		exif_data_free_thumbnail (data);
 		if (data->priv->log) {
 			exif_log_unref (data->priv->log);
 			data->priv->log = NULL;
@@ -1117,7 +1190,7 @@ entry_set_byte_order (ExifEntry *e, void *data)
 {
 	ByteOrderChangeData *d = data;
 
-	if (!e)
+	if (!e || !exif_entry_own_data (e))
 		return;
 
 	exif_array_set_byte_order (e->format, e->data, e->components, d->old, d->new);
@@ -1183,6 +1256,9 @@ static const struct {
 	{EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE, N_("Do not change maker note"),
 	 N_("When loading and resaving Exif data, save the maker note unmodified."
 	    " Be aware that the maker note can get corrupted.")},
+	{EXIF_DATA_OPTION_BORROW_DATA, N_("Borrow loaded data"),
+	 N_("Let entries and the thumbnail point into the loaded buffer instead "
+	    "of copying their data.")},
 	{0, NULL, NULL}
 };
 
@@ -1298,11 +1374,6 @@ exif_data_remove_thumbnail (ExifData *data)
     	data->ifd[EXIF_IFD_1]->parent = data;
 	}
 	
-	if (data->data) {
-		exif_mem_free (mem, data->data);
-		data->data = NULL;
-	}
-
-	data->size = 0;
+	exif_data_free_thumbnail (data);
 }
 
@@ -41,6 +41,9 @@ struct _ExifEntryPrivate
 	unsigned int ref_count;
 
 	ExifMem *mem;
+
+	/* data as borrowed from a loaded buffer, NULL if it was allocated */
+	const unsigned char *borrowed;
 };
 
 /* This function is hidden in exif-data.c */
@@ -105,6 +108,48 @@ exif_entry_realloc (ExifEntry *e, void *d_orig, unsigned int i)
 	return NULL;
 }
 
+/* Used internally within libexif */
+void exif_entry_free_data (ExifEntry *);
+void
+exif_entry_free_data (ExifEntry *e)
+{
+	if (!e || !e->priv) return;
+
+	if (e->data && (e->data != e->priv->borrowed))
+		exif_mem_free (e->priv->mem, e->data);
+	e->data = NULL;
+	e->size = 0;
+	e->priv->borrowed = NULL;
+}
+
+void exif_entry_borrow_data (ExifEntry *, const unsigned char *, unsigned int);
+void
+exif_entry_borrow_data (ExifEntry *e, const unsigned char *d, unsigned int size)
+{
+	if (!e || !e->priv) return;
+
+	exif_entry_free_data (e);
+	e->data = (unsigned char *) d;
+	e->size = size;
+	e->priv->borrowed = d;
+}
+
+int
+exif_entry_own_data (ExifEntry *e)
+{
+	unsigned char *d;
+
+	if (!e || !e->priv) return 0;
+	if (!e->data || (e->data != e->priv->borrowed)) return 1;
+
+	d = exif_entry_alloc (e, e->size);
+	if (!d) return 0;
+	memcpy (d, e->data, e->size);
+	e->data = d;
+	e->priv->borrowed = NULL;
+	return 1;
+}
+
 ExifEntry *
 exif_entry_new (void)
 {
@@ -129,6 +174,7 @@ exif_entry_new_mem (ExifMem *mem)
 
 	e->priv->mem = mem;
 	exif_mem_ref (mem);
+	e->priv->borrowed = NULL;
 
 	return e;
 }
@@ -158,8 +204,7 @@ exif_entry_free (ExifEntry *e)
 
 	if (e->priv) {
 		ExifMem *mem = e->priv->mem;
-		if (e->data)
-			exif_mem_free (mem, e->data);
+		exif_entry_free_data (e);
 		exif_mem_free (mem, e->priv);
 		exif_mem_free (mem, e);
 		exif_mem_unref (mem);
@@ -258,7 +303,7 @@ exif_entry_fix (ExifEntry *e)
 					  exif_format_get_size (e->format),
 					  e->format, o));
 
-			exif_mem_free (e->priv->mem, e->data);
+			exif_entry_free_data (e);
 			e->data = newdata;
 			e->size = newsize;
 			e->format = EXIF_FORMAT_SHORT;
@@ -287,6 +332,7 @@ exif_entry_fix (ExifEntry *e)
 		switch (e->format) {
 		case EXIF_FORMAT_SRATIONAL:
 			if (!e->parent || !e->parent->parent) break;
+			if (!exif_entry_own_data (e)) break;
 			o = exif_data_get_byte_order (e->parent->parent);
 			for (i = 0; i < e->components; i++) {
 				sr = exif_get_srational (e->data + i * 
@@ -320,6 +366,7 @@ exif_entry_fix (ExifEntry *e)
 		switch (e->format) {
 		case EXIF_FORMAT_RATIONAL:
 			if (!e->parent || !e->parent->parent) break;
+			if (!exif_entry_own_data (e)) break;
 			o = exif_data_get_byte_order (e->parent->parent);
 			for (i = 0; i < e->components; i++) {
 				r = exif_get_rational (e->data + i * 
@@ -359,12 +406,15 @@ exif_entry_fix (ExifEntry *e)
 
 		/* Some packages like Canon ZoomBrowser EX 4.5 store
 		   only one zero byte followed by 7 bytes of rubbish */
-		if ((e->size >= 8) && (e->data[0] == 0)) {
+		if ((e->size >= 8) && (e->data[0] == 0) &&
+		    memcmp (e->data, "\0\0\0\0\0\0\0\0", 8)) {
+			if (!exif_entry_own_data (e)) break;
 			memcpy(e->data, "\0\0\0\0\0\0\0\0", 8);
 		}
 
 		/* There need to be at least 8 bytes. */
 		if (e->size < 8) {
+			if (!exif_entry_own_data (e)) break;
 			e->data = exif_entry_realloc (e, e->data, 8 + e->size);
 			if (!e->data) {
 				e->size = 0;
@@ -396,6 +446,7 @@ exif_entry_fix (ExifEntry *e)
 				_("Tag 'UserComment' is not empty but does not "
 				"start with a format identifier. "
 				"This has been fixed."));
+			if (!exif_entry_own_data (e)) break;
 			memcpy (e->data, "ASCII\0\0\0", 8);
 			break;
 		}
@@ -408,6 +459,7 @@ exif_entry_fix (ExifEntry *e)
 		    memcmp (e->data, "UNICODE\0"       , 8) &&
 		    memcmp (e->data, "JIS\0\0\0\0\0"   , 8) &&
 		    memcmp (e->data, "\0\0\0\0\0\0\0\0", 8)) {
+			if (!exif_entry_own_data (e)) break;
 			e->data = exif_entry_realloc (e, e->data, 8 + e->size);
 			if (!e->data) {
 				e->size = 0;
@@ -1,14 +1,40 @@
 #include <libexif/exif-mem.h>
 
 #include <stdlib.h>
+#include <string.h>
+
+/*! Chunk size used by #exif_mem_new_arena if none is given. */
+#define EXIF_MEM_ARENA_CHUNK_SIZE 16384
+
+/*! Arena allocations are aligned to, and preceded by a header of, this size */
+#define EXIF_MEM_ARENA_ALIGN 8
+#define EXIF_MEM_ARENA_ROUND(s) (((s) + EXIF_MEM_ARENA_ALIGN - 1) & \
+				 ~(EXIF_MEM_ARENA_ALIGN - 1))
+
+typedef struct _ExifMemChunk ExifMemChunk;
+struct _ExifMemChunk {
+	ExifMemChunk *next;
+	ExifLong size;		/* bytes available for allocations */
+	ExifLong used;
+	/* allocations follow, each one after a header holding its size */
+};
 
 struct _ExifMem {
 	unsigned int ref_count;
 	ExifMemAllocFunc alloc_func;
 	ExifMemReallocFunc realloc_func;
 	ExifMemFreeFunc free_func;
+
+	/* Arena state, see exif_mem_new_arena. The current chunk is first. */
+	ExifLong chunk_size;	/* 0 unless this is an arena */
+	ExifMemChunk *chunks;
+	unsigned char *last;	/* most recent allocation in the current chunk */
 };
 
+#define EXIF_MEM_CHUNK_DATA(c) ((unsigned char *) (c) + \
+		EXIF_MEM_ARENA_ROUND (sizeof (ExifMemChunk)))
+#define EXIF_MEM_BLOCK_SIZE(p) (*(ExifLong *) ((p) - EXIF_MEM_ARENA_ALIGN))
+
 /*! Default memory allocation function. */
 static void *
 exif_mem_alloc_func (ExifLong ds)
@@ -30,6 +56,96 @@ exif_mem_free_func (void *d)
 	free (d);
 }
 
+/*! Hand out ds bytes from the arena, zeroed like calloc() does. */
+static void *
+exif_mem_arena_alloc (ExifMem *mem, ExifLong ds)
+{
+	ExifMemChunk *c = mem->chunks;
+	ExifLong need = EXIF_MEM_ARENA_ALIGN + EXIF_MEM_ARENA_ROUND (ds);
+	unsigned char *p;
+
+	if (need < ds)
+		return NULL;
+
+	if (!c || (c->size - c->used < need)) {
+		ExifLong size = (need > mem->chunk_size) ? need : mem->chunk_size;
+
+		c = malloc (EXIF_MEM_ARENA_ROUND (sizeof (ExifMemChunk)) + size);
+		if (!c)
+			return NULL;
+		c->size = size;
+		c->used = 0;
+
+		/*
+		 * Allocations larger than a quarter chunk get a chunk of their
+		 * own, behind the current one, which stays in use.
+		 */
+		if (mem->chunks && (need > mem->chunk_size / 4)) {
+			c->next = mem->chunks->next;
+			mem->chunks->next = c;
+		} else {
+			c->next = mem->chunks;
+			mem->chunks = c;
+			mem->last = NULL;
+		}
+	}
+
+	p = EXIF_MEM_CHUNK_DATA (c) + c->used + EXIF_MEM_ARENA_ALIGN;
+	c->used += need;
+	EXIF_MEM_BLOCK_SIZE (p) = ds;
+	memset (p, 0, ds);
+	if (c == mem->chunks)
+		mem->last = p;
+	return p;
+}
+
+/*! Only the most recent allocation of the current chunk is given back. */
+static void
+exif_mem_arena_free (ExifMem *mem, void *d)
+{
+	ExifMemChunk *c = mem->chunks;
+
+	if (!d || (d != mem->last))
+		return;
+	c->used -= EXIF_MEM_ARENA_ALIGN +
+		   EXIF_MEM_ARENA_ROUND (EXIF_MEM_BLOCK_SIZE (mem->last));
+	mem->last = NULL;
+}
+
+/*! The most recent allocation grows in place while its chunk has room. */
+static void *
+exif_mem_arena_realloc (ExifMem *mem, void *d, ExifLong ds)
+{
+	ExifMemChunk *c = mem->chunks;
+	unsigned char *p = d;
+	ExifLong old, grow;
+
+	if (!p)
+		return exif_mem_arena_alloc (mem, ds);
+
+	old = EXIF_MEM_BLOCK_SIZE (p);
+	if (ds <= old) {
+		if (p == mem->last) {
+			c->used -= EXIF_MEM_ARENA_ROUND (old) - EXIF_MEM_ARENA_ROUND (ds);
+			EXIF_MEM_BLOCK_SIZE (p) = ds;
+		}
+		return p;
+	}
+
+	grow = EXIF_MEM_ARENA_ROUND (ds) - EXIF_MEM_ARENA_ROUND (old);
+	if ((p == mem->last) && (ds > old) && (c->size - c->used >= grow)) {
+		c->used += grow;
+		EXIF_MEM_BLOCK_SIZE (p) = ds;
+		return p;
+	}
+
+	d = exif_mem_arena_alloc (mem, ds);
+	if (!d)
+		return NULL;
+	memcpy (d, p, old);
+	return d;
+}
+
 ExifMem *
 exif_mem_new (ExifMemAllocFunc alloc_func, ExifMemReallocFunc realloc_func,
 	      ExifMemFreeFunc free_func)
@@ -60,15 +176,32 @@ exif_mem_ref (ExifMem *mem)
 void
 exif_mem_unref (ExifMem *mem)
 {
+	ExifMemChunk *c;
+
 	if (!mem) return;
-	if (!--mem->ref_count)
+	if (--mem->ref_count)
+		return;
+	if (!mem->chunk_size) {
 		exif_mem_free (mem, mem);
+		return;
+	}
+
+	/* Release the whole arena at once */
+	while ((c = mem->chunks)) {
+		mem->chunks = c->next;
+		free (c);
+	}
+	free (mem);
 }
 
 void
 exif_mem_free (ExifMem *mem, void *d)
 {
 	if (!mem) return;
+	if (mem->chunk_size) {
+		exif_mem_arena_free (mem, d);
+		return;
+	}
 	if (mem->free_func) {
 		mem->free_func (d);
 		return;
@@ -79,6 +212,8 @@ void *
 exif_mem_alloc (ExifMem *mem, ExifLong ds)
 {
 	if (!mem) return NULL;
+	if (mem->chunk_size)
+		return exif_mem_arena_alloc (mem, ds);
 	if (mem->alloc_func || mem->realloc_func)
 		return mem->alloc_func ? mem->alloc_func (ds) :
 					 mem->realloc_func (NULL, ds);
@@ -88,6 +223,8 @@ exif_mem_alloc (ExifMem *mem, ExifLong ds)
 void *
 exif_mem_realloc (ExifMem *mem, void *d, ExifLong ds)
 {
+	if (mem && mem->chunk_size)
+		return exif_mem_arena_realloc (mem, d, ds);
 	return (mem && mem->realloc_func) ? mem->realloc_func (d, ds) : NULL;
 }
 
@@ -97,3 +234,39 @@ exif_mem_new_default (void)
 	return exif_mem_new (exif_mem_alloc_func, exif_mem_realloc_func,
 			     exif_mem_free_func);
 }
+
+void
+exif_mem_arena_reset (ExifMem *mem)
+{
+	ExifMemChunk *c, *keep = NULL;
+
+	if (!mem || !mem->chunk_size) return;
+
+	/* Keep one regular chunk for the next round */
+	while ((c = mem->chunks)) {
+		mem->chunks = c->next;
+		if (!keep && (c->size == mem->chunk_size))
+			keep = c;
+		else
+			free (c);
+	}
+	if (keep) {
+		keep->next = NULL;
+		keep->used = 0;
+	}
+	mem->chunks = keep;
+	mem->last = NULL;
+}
+
+ExifMem *
+exif_mem_new_arena (ExifLong chunk_size)
+{
+	ExifMem *mem;
+
+	mem = calloc (1, sizeof (ExifMem));
+	if (!mem) return NULL;
+	mem->ref_count = 1;
+	mem->chunk_size = chunk_size ? chunk_size : EXIF_MEM_ARENA_CHUNK_SIZE;
+
+	return mem;
+}
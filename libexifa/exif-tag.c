@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #define ESL_NNNN { EXIF_SUPPORT_LEVEL_NOT_RECORDED, EXIF_SUPPORT_LEVEL_NOT_RECORDED, EXIF_SUPPORT_LEVEL_NOT_RECORDED, EXIF_SUPPORT_LEVEL_NOT_RECORDED }
 #define ESL_OOOO { EXIF_SUPPORT_LEVEL_OPTIONAL, EXIF_SUPPORT_LEVEL_OPTIONAL, EXIF_SUPPORT_LEVEL_OPTIONAL, EXIF_SUPPORT_LEVEL_OPTIONAL }
@@ -1002,47 +1003,143 @@ exif_tag_table_first(ExifTag tag)
  (ExifTagTable[i].esl[ifd][EXIF_DATA_TYPE_UNCOMPRESSED_YCC] != EXIF_SUPPORT_LEVEL_NOT_RECORDED) || \
  (ExifTagTable[i].esl[ifd][EXIF_DATA_TYPE_COMPRESSED] != EXIF_SUPPORT_LEVEL_NOT_RECORDED))
 
+static ExifSupportLevel get_support_level_in_ifd (ExifTag, ExifIfd, ExifDataType);
+static ExifSupportLevel get_support_level_any_type (ExifTag, ExifIfd);
+
+/*
+ * Index of ExifTagTable by tag number and IFD, and by name, so that the
+ * lookups done for every loaded entry take constant time. Both are open
+ * addressing hash tables built from ExifTagTable on first use; what they
+ * cache is defined by the table scans (see exif_tag_table_first).
+ */
+#define EXIF_TAG_INDEX_BITS       10	/* at least twice the (tag, IFD) pairs */
+#define EXIF_TAG_INDEX_SIZE       (1 << EXIF_TAG_INDEX_BITS)
+#define EXIF_TAG_NAME_INDEX_SIZE  512	/* at least twice the names */
+#define EXIF_TAG_INDEX_NONE       0xffff
+
+typedef struct {
+	ExifTag tag;
+	unsigned short ifd;
+	/*! First entry of ExifTagTable recorded in the IFD */
+	unsigned short index;
+	/*! Support level per data type, and for any data type */
+	unsigned char esl[EXIF_DATA_TYPE_COUNT];
+	unsigned char esl_any;
+} ExifTagIndexEntry;
+
+static ExifTagIndexEntry exif_tag_index[EXIF_TAG_INDEX_SIZE];
+static unsigned short exif_tag_name_index[EXIF_TAG_NAME_INDEX_SIZE];
+static pthread_once_t exif_tag_index_once = PTHREAD_ONCE_INIT;
+
+static unsigned int
+exif_tag_index_hash (ExifTag tag, ExifIfd ifd)
+{
+	/* Fibonacci hashing of the (tag, IFD) pair */
+	return (((unsigned int) tag * EXIF_IFD_COUNT + ifd) * 2654435761U) >>
+		(32 - EXIF_TAG_INDEX_BITS);
+}
+
+static unsigned int
+exif_tag_name_hash (const char *name)
+{
+	/* FNV-1a */
+	unsigned int h = 2166136261U;
+
+	while (*name)
+		h = (h ^ (unsigned char) *name++) * 16777619U;
+	return h & (EXIF_TAG_NAME_INDEX_SIZE - 1);
+}
+
+static void
+exif_tag_index_build (void)
+{
+	unsigned int i, h;
+	ExifIfd ifd;
+	ExifDataType t;
+	ExifTagIndexEntry *e;
+
+	memset (exif_tag_index, 0xff, sizeof (exif_tag_index));
+	memset (exif_tag_name_index, 0xff, sizeof (exif_tag_name_index));
+
+	for (i = 0; ExifTagTable[i].name; i++) {
+		for (ifd = 0; ifd < EXIF_IFD_COUNT; ifd++) {
+			if (!RECORDED)
+				continue;
+
+			/* The first entry recorded in the IFD wins */
+			for (h = exif_tag_index_hash (ExifTagTable[i].tag, ifd);
+			     exif_tag_index[h].index != EXIF_TAG_INDEX_NONE;
+			     h = (h + 1) & (EXIF_TAG_INDEX_SIZE - 1))
+				if ((exif_tag_index[h].tag == ExifTagTable[i].tag) &&
+				    (exif_tag_index[h].ifd == ifd))
+					break;
+			e = &exif_tag_index[h];
+			if (e->index != EXIF_TAG_INDEX_NONE)
+				continue;
+
+			e->tag = ExifTagTable[i].tag;
+			e->ifd = ifd;
+			e->index = i;
+			for (t = 0; t < EXIF_DATA_TYPE_COUNT; t++)
+				e->esl[t] = get_support_level_in_ifd (e->tag, ifd, t);
+			e->esl_any = get_support_level_any_type (e->tag, ifd);
+		}
+
+		/* So does the first entry with a name */
+		for (h = exif_tag_name_hash (ExifTagTable[i].name);
+		     exif_tag_name_index[h] != EXIF_TAG_INDEX_NONE;
+		     h = (h + 1) & (EXIF_TAG_NAME_INDEX_SIZE - 1))
+			if (!strcmp (ExifTagTable[exif_tag_name_index[h]].name,
+				     ExifTagTable[i].name))
+				break;
+		if (exif_tag_name_index[h] == EXIF_TAG_INDEX_NONE)
+			exif_tag_name_index[h] = i;
+	}
+}
+
+/*!
+ * Finds the index entry of a tag recorded in an IFD.
+ * \param[in] tag to find
+ * \param[in] ifd a valid IFD (not EXIF_IFD_COUNT)
+ * \return index entry, or NULL if the tag is not recorded in the IFD
+ */
+static const ExifTagIndexEntry *
+exif_tag_index_find (ExifTag tag, ExifIfd ifd)
+{
+	unsigned int h;
+
+	pthread_once (&exif_tag_index_once, exif_tag_index_build);
+	for (h = exif_tag_index_hash (tag, ifd);
+	     exif_tag_index[h].index != EXIF_TAG_INDEX_NONE;
+	     h = (h + 1) & (EXIF_TAG_INDEX_SIZE - 1))
+		if ((exif_tag_index[h].tag == tag) && (exif_tag_index[h].ifd == ifd))
+			return &exif_tag_index[h];
+	return NULL;
+}
+
 const char *
 exif_tag_get_name_in_ifd (ExifTag tag, ExifIfd ifd)
 {
-	unsigned int i;
-	int first;
+	const ExifTagIndexEntry *e;
 
 	if (ifd >= EXIF_IFD_COUNT)
 		return NULL;
-	first = exif_tag_table_first(tag);
-	if (first < 0)
-		return NULL;
-
-	for (i = first; ExifTagTable[i].name; i++) {
-		if (ExifTagTable[i].tag == tag) {
-		   if (RECORDED)
-			   break;
-		} else
-			return NULL; /* Recorded tag not found in the table */
-	}
-	return ExifTagTable[i].name;
+	e = exif_tag_index_find (tag, ifd);
+	if (!e)
+		return NULL; /* Recorded tag not found in the table */
+	return ExifTagTable[e->index].name;
 }
 
 const char *
 exif_tag_get_title_in_ifd (ExifTag tag, ExifIfd ifd)
 {
-	unsigned int i;
-	int first;
+	const ExifTagIndexEntry *e;
 
 	if (ifd >= EXIF_IFD_COUNT)
 		return NULL;
-	first = exif_tag_table_first(tag);
-	if (first < 0)
-		return NULL;
-
-	for (i = first; ExifTagTable[i].name; i++) {
-		if (ExifTagTable[i].tag == tag) {
-		   if (RECORDED)
-			   break;
-		} else
-			return NULL; /* Recorded tag not found in the table */
-	}
+	e = exif_tag_index_find (tag, ifd);
+	if (!e)
+		return NULL; /* Recorded tag not found in the table */
 	/* FIXME: This belongs to somewhere else. */
 	/* libexif should use the default system locale.
 	 * If an application specifically requires UTF-8, then we
@@ -1051,31 +1148,23 @@ exif_tag_get_title_in_ifd (ExifTag tag, ExifIfd ifd)
 	 * bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 	 */
 	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
-	return _(ExifTagTable[i].title);
+	return _(ExifTagTable[e->index].title);
 }
 
 const char *
 exif_tag_get_description_in_ifd (ExifTag tag, ExifIfd ifd)
 {
-	unsigned int i;
-	int first;
+	const ExifTagIndexEntry *e;
 
 	if (ifd >= EXIF_IFD_COUNT)
 		return NULL;
-	first = exif_tag_table_first(tag);
-	if (first < 0)
-		return NULL;
-
-	for (i = first; ExifTagTable[i].name; i++) {
-		if (ExifTagTable[i].tag == tag) {
-			if (RECORDED)
-				break;
-		} else
-			return NULL; /* Recorded tag not found in the table */
-	}
+	e = exif_tag_index_find (tag, ifd);
+	if (!e)
+		return NULL; /* Recorded tag not found in the table */
 
 	/* GNU gettext acts strangely when given an empty string */
-	if (!ExifTagTable[i].description || !*ExifTagTable[i].description)
+	if (!ExifTagTable[e->index].description ||
+	    !*ExifTagTable[e->index].description)
 		return "";
 
 	/* libexif should use the default system locale.
@@ -1085,7 +1174,7 @@ exif_tag_get_description_in_ifd (ExifTag tag, ExifIfd ifd)
 	 * bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 	 */
 	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
-	return _(ExifTagTable[i].description);
+	return _(ExifTagTable[e->index].description);
 }
 
 
@@ -1141,29 +1230,29 @@ exif_tag_get_description (ExifTag tag)
 ExifTag 
 exif_tag_from_name (const char *name)
 {
-	unsigned int i;
-	unsigned int result=0;
+	unsigned int h;
 
 	if (!name) return 0;
 
-	for (i = 0; ExifTagTable[i].name; i++)
-		if (!strcmp (ExifTagTable[i].name, name))  {
-		  	result = ExifTagTable[i].tag;
-		  	break;
-		}
-	return result;
+	pthread_once (&exif_tag_index_once, exif_tag_index_build);
+	for (h = exif_tag_name_hash (name);
+	     exif_tag_name_index[h] != EXIF_TAG_INDEX_NONE;
+	     h = (h + 1) & (EXIF_TAG_NAME_INDEX_SIZE - 1))
+		if (!strcmp (ExifTagTable[exif_tag_name_index[h]].name, name))
+			return ExifTagTable[exif_tag_name_index[h]].tag;
+	return 0;
 }
 
 /*! Return the support level of a tag in the given IFD with the given data
- * type. If the tag is not specified in the EXIF standard, this function
- * returns EXIF_SUPPORT_LEVEL_NOT_RECORDED.
+ * type, scanning the table. If the tag is not specified in the EXIF
+ * standard, this function returns EXIF_SUPPORT_LEVEL_NOT_RECORDED.
  *
  * \param[in] tag EXIF tag
  * \param[in] ifd a valid IFD (not EXIF_IFD_COUNT)
  * \param[in] t a valid data type (not EXIF_DATA_TYPE_UNKNOWN)
  * \return the level of support for this tag
  */
-static inline ExifSupportLevel
+static ExifSupportLevel
 get_support_level_in_ifd (ExifTag tag, ExifIfd ifd, ExifDataType t)
 {
 	unsigned int i;
@@ -1185,7 +1274,7 @@ get_support_level_in_ifd (ExifTag tag, ExifIfd ifd, ExifDataType t)
 }
 
 /*! Return the support level of a tag in the given IFD, regardless of the
- * data type. If the support level varies depending on the data type, this
+ * data type, scanning the table. If the support level varies depending on the data type, this
  * function returns EXIF_SUPPORT_LEVEL_UNKNOWN. If the tag is not specified
  * in the EXIF standard, this function returns EXIF_SUPPORT_LEVEL_UNKNOWN.
  *
@@ -1193,7 +1282,7 @@ get_support_level_in_ifd (ExifTag tag, ExifIfd ifd, ExifDataType t)
  * \param[in] ifd a valid IFD (not EXIF_IFD_COUNT)
  * \return the level of support for this tag
  */
-static inline ExifSupportLevel
+static ExifSupportLevel
 get_support_level_any_type (ExifTag tag, ExifIfd ifd)
 {
 	unsigned int i;
@@ -1230,11 +1319,14 @@ get_support_level_any_type (ExifTag tag, ExifIfd ifd)
 ExifSupportLevel
 exif_tag_get_support_level_in_ifd (ExifTag tag, ExifIfd ifd, ExifDataType t)
 {
+	const ExifTagIndexEntry *e;
+
 	if (ifd >= EXIF_IFD_COUNT)
 		return EXIF_SUPPORT_LEVEL_UNKNOWN;
 
+	e = exif_tag_index_find (tag, ifd);
 	if (t >= EXIF_DATA_TYPE_COUNT)
-		return get_support_level_any_type (tag, ifd);
+		return e ? e->esl_any : EXIF_SUPPORT_LEVEL_UNKNOWN;
 
-	return get_support_level_in_ifd (tag, ifd, t);
+	return e ? e->esl[t] : EXIF_SUPPORT_LEVEL_NOT_RECORDED;
 }
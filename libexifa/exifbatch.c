@@ -0,0 +1,280 @@
+/* exifbatch.c
+ *
+ * Print selected EXIF tags of many files as CSV or JSON, loading them
+ * in parallel with exif_batch_load_files.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-batch.h>
+#include <libexif/exif-tag.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define EXIFBATCH_DEFAULT_TAGS \
+	"Make,Model,DateTimeOriginal,PixelXDimension,PixelYDimension"
+
+typedef enum {
+	EXIFBATCH_CSV,
+	EXIFBATCH_JSON
+} ExifBatchFormat;
+
+typedef struct {
+	ExifBatchFormat format;
+	const char **names;
+	ExifTag *tags;
+	unsigned int count;
+
+	pthread_mutex_t lock;
+	unsigned int written;
+} ExifBatchOutput;
+
+/* Growing string, one per record */
+typedef struct {
+	char *s;
+	size_t len, size;
+} ExifBatchString;
+
+static void
+str_append (ExifBatchString *str, const char *s, size_t len)
+{
+	char *t;
+
+	if (str->len + len + 1 > str->size) {
+		t = realloc (str->s, 2 * (str->len + len + 1));
+		if (!t)
+			return;
+		str->s = t;
+		str->size = 2 * (str->len + len + 1);
+	}
+	memcpy (str->s + str->len, s, len);
+	str->len += len;
+	str->s[str->len] = '\0';
+}
+
+static void
+str_append_csv (ExifBatchString *str, const char *s)
+{
+	const char *q;
+
+	if (!strpbrk (s, ",\"\r\n")) {
+		str_append (str, s, strlen (s));
+		return;
+	}
+	str_append (str, "\"", 1);
+	while ((q = strchr (s, '"'))) {
+		str_append (str, s, q - s + 1);
+		str_append (str, "\"", 1);
+		s = q + 1;
+	}
+	str_append (str, s, strlen (s));
+	str_append (str, "\"", 1);
+}
+
+static void
+str_append_json (ExifBatchString *str, const char *s)
+{
+	char e[8];
+
+	str_append (str, "\"", 1);
+	for (; *s; s++) {
+		if ((*s == '"') || (*s == '\\')) {
+			e[0] = '\\';
+			e[1] = *s;
+			str_append (str, e, 2);
+		} else if ((unsigned char) *s < 0x20) {
+			snprintf (e, sizeof (e), "\\u%04x", (unsigned char) *s);
+			str_append (str, e, 6);
+		} else
+			str_append (str, s, 1);
+	}
+	str_append (str, "\"", 1);
+}
+
+static void
+print_record (unsigned int index, const char *path, ExifData *data,
+	      void *user_data)
+{
+	ExifBatchOutput *out = user_data;
+	ExifBatchString str = { NULL, 0, 0 };
+	ExifEntry *e;
+	char v[1024];
+	unsigned int i;
+
+	(void) index;
+
+	if (out->format == EXIFBATCH_CSV)
+		str_append_csv (&str, path);
+	else {
+		str_append (&str, "{\"file\":", 8);
+		str_append_json (&str, path);
+	}
+	for (i = 0; i < out->count; i++) {
+		e = data ? exif_data_get_entry (data, out->tags[i]) : NULL;
+		if (e)
+			exif_entry_get_value (e, v, sizeof (v));
+		if (out->format == EXIFBATCH_CSV) {
+			str_append (&str, ",", 1);
+			if (e)
+				str_append_csv (&str, v);
+			continue;
+		}
+		str_append (&str, ",", 1);
+		str_append_json (&str, out->names[i]);
+		str_append (&str, ":", 1);
+		if (e)
+			str_append_json (&str, v);
+		else
+			str_append (&str, "null", 4);
+	}
+	str_append (&str, out->format == EXIFBATCH_CSV ? "\n" : "}", 1);
+	if (!str.s)
+		return;
+
+	pthread_mutex_lock (&out->lock);
+	if (out->format == EXIFBATCH_JSON)
+		fputs (out->written ? ",\n" : "[\n", stdout);
+	fwrite (str.s, 1, str.len, stdout);
+	out->written++;
+	pthread_mutex_unlock (&out->lock);
+	free (str.s);
+}
+
+/*! Read one path per line from f */
+static char **
+read_paths (FILE *f, unsigned int *count)
+{
+	char line[4096], **paths = NULL, **t;
+	unsigned int size = 0;
+	size_t len;
+
+	*count = 0;
+	while (fgets (line, sizeof (line), f)) {
+		len = strcspn (line, "\r\n");
+		if (!len)
+			continue;
+		line[len] = '\0';
+		if (*count == size) {
+			size = size ? 2 * size : 1024;
+			t = realloc (paths, sizeof (char *) * size);
+			if (!t)
+				break;
+			paths = t;
+		}
+		paths[*count] = strdup (line);
+		if (paths[*count])
+			(*count)++;
+	}
+	return paths;
+}
+
+static void
+usage (const char *name)
+{
+	fprintf (stderr,
+		 "Usage: %s [-j threads] [-f csv|json] [-t tag,...] [file...]\n"
+		 "Print EXIF tags of the files, or of the files listed on the\n"
+		 "standard input, one per line. The default tags are\n"
+		 EXIFBATCH_DEFAULT_TAGS ".\n", name);
+}
+
+int
+main (int argc, char **argv)
+{
+	ExifBatchOutput out;
+	const char *tags = EXIFBATCH_DEFAULT_TAGS;
+	char *list, *name, *save;
+	char **paths;
+	unsigned int i, count, threads = 0;
+	int c, from_stdin;
+
+	memset (&out, 0, sizeof (out));
+	out.format = EXIFBATCH_CSV;
+	while ((c = getopt (argc, argv, "j:f:t:h")) != -1) {
+		switch (c) {
+		case 'j':
+			threads = atoi (optarg);
+			break;
+		case 'f':
+			if (!strcmp (optarg, "json"))
+				out.format = EXIFBATCH_JSON;
+			else if (strcmp (optarg, "csv")) {
+				usage (argv[0]);
+				return 1;
+			}
+			break;
+		case 't':
+			tags = optarg;
+			break;
+		default:
+			usage (argv[0]);
+			return 1;
+		}
+	}
+
+	/* Look the tags up once, not for every file */
+	list = strdup (tags);
+	if (!list)
+		return 1;
+	out.names = malloc (sizeof (char *) * (strlen (list) + 1));
+	out.tags = malloc (sizeof (ExifTag) * (strlen (list) + 1));
+	if (!out.names || !out.tags)
+		return 1;
+	for (name = strtok_r (list, ",", &save); name;
+	     name = strtok_r (NULL, ",", &save)) {
+		out.tags[out.count] = exif_tag_from_name (name);
+		if (!out.tags[out.count] && strcmp (name, "GPSVersionID")) {
+			fprintf (stderr, "Unknown tag '%s'.\n", name);
+			return 1;
+		}
+		out.names[out.count++] = name;
+	}
+
+	from_stdin = (optind == argc);
+	if (from_stdin)
+		paths = read_paths (stdin, &count);
+	else {
+		paths = argv + optind;
+		count = argc - optind;
+	}
+
+	if (out.format == EXIFBATCH_CSV) {
+		fputs ("file", stdout);
+		for (i = 0; i < out.count; i++)
+			printf (",%s", out.names[i]);
+		fputs ("\n", stdout);
+	}
+	pthread_mutex_init (&out.lock, NULL);
+	exif_batch_load_files ((const char * const *) paths, count, threads,
+			       0, print_record, &out);
+	pthread_mutex_destroy (&out.lock);
+	if (out.format == EXIFBATCH_JSON)
+		fputs (out.written ? "\n]\n" : "[]\n", stdout);
+
+	if (from_stdin) {
+		for (i = 0; i < count; i++)
+			free (paths[i]);
+		free (paths);
+	}
+	free (out.names);
+	free (out.tags);
+	free (list);
+	return 0;
+}
@@ -0,0 +1,166 @@
+/* exifbatchbench.c
+ *
+ * Time exif_batch_load_files over a list of files with 1, 2, 4, ...
+ * threads, to see how loading the EXIF data of many files scales.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-batch.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EXIFBATCHBENCH_MAX_THREADS 8
+#define EXIFBATCHBENCH_RUNS 3
+
+/* Files seen and entries found, updated from the worker threads */
+typedef struct {
+	pthread_mutex_t lock;
+	unsigned int files;
+	unsigned long entries;
+} ExifBatchBenchCount;
+
+static void
+count_entries (ExifContent *content, void *user_data)
+{
+	*(unsigned long *) user_data += content->count;
+}
+
+static void
+count_file (unsigned int index, const char *path, ExifData *data,
+	    void *user_data)
+{
+	ExifBatchBenchCount *count = user_data;
+	unsigned long entries = 0;
+
+	(void) index;
+	(void) path;
+
+	if (data)
+		exif_data_foreach_content (data, count_entries, &entries);
+	pthread_mutex_lock (&count->lock);
+	count->files++;
+	count->entries += entries;
+	pthread_mutex_unlock (&count->lock);
+}
+
+/*! Read one path per line from f */
+static char **
+read_paths (FILE *f, unsigned int *count)
+{
+	char line[4096], **paths = NULL, **t;
+	unsigned int size = 0;
+	size_t len;
+
+	*count = 0;
+	while (fgets (line, sizeof (line), f)) {
+		len = strcspn (line, "\r\n");
+		if (!len)
+			continue;
+		line[len] = '\0';
+		if (*count == size) {
+			size = size ? 2 * size : 1024;
+			t = realloc (paths, sizeof (char *) * size);
+			if (!t)
+				break;
+			paths = t;
+		}
+		paths[*count] = strdup (line);
+		if (paths[*count])
+			(*count)++;
+	}
+	return paths;
+}
+
+static double
+now_msec (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/*! Best of EXIFBATCHBENCH_RUNS runs, in milliseconds */
+static double
+time_load (const char * const *paths, unsigned int count,
+	   unsigned int threads, ExifBatchBenchCount *c)
+{
+	double start, msec, best = 0;
+	unsigned int run;
+
+	for (run = 0; run < EXIFBATCHBENCH_RUNS; run++) {
+		c->files = 0;
+		c->entries = 0;
+		start = now_msec ();
+		exif_batch_load_files (paths, count, threads, 0, count_file, c);
+		msec = now_msec () - start;
+		if (!run || (msec < best))
+			best = msec;
+	}
+	return best;
+}
+
+int
+main (int argc, char **argv)
+{
+	ExifBatchBenchCount c;
+	unsigned int i, count, threads, max = EXIFBATCHBENCH_MAX_THREADS;
+	char **paths;
+	double msec, base = 0;
+	long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+	if ((argc > 2) || ((argc == 2) && !(max = atoi (argv[1])))) {
+		fprintf (stderr, "Usage: %s [max threads] < file list\n"
+			 "Load the EXIF data of the files listed on the "
+			 "standard input,\none per line, with 1, 2, 4, ... "
+			 "up to max threads (default %d).\n",
+			 argv[0], EXIFBATCHBENCH_MAX_THREADS);
+		return 2;
+	}
+	paths = read_paths (stdin, &count);
+	if (!count) {
+		fprintf (stderr, "No files.\n");
+		return 1;
+	}
+
+	/* The first pass brings the headers into the page cache */
+	pthread_mutex_init (&c.lock, NULL);
+	exif_batch_load_files ((const char * const *) paths, count, 1, 0,
+			       count_file, &c);
+
+	printf ("%u files, %lu entries, %ld online CPUs\n", count,
+		c.entries, cpus);
+	for (threads = 1; threads <= max; threads *= 2) {
+		msec = time_load ((const char * const *) paths, count,
+				  threads, &c);
+		if (threads == 1)
+			base = msec;
+		printf ("%2u threads: %8.1f ms, %7.0f files/s, %.2fx\n",
+			threads, msec, count * 1e3 / msec, base / msec);
+	}
+	pthread_mutex_destroy (&c.lock);
+
+	for (i = 0; i < count; i++)
+		free (paths[i]);
+	free (paths);
+	return 0;
+}
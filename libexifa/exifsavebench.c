@@ -0,0 +1,220 @@
+/* exifsavebench.c
+ *
+ * Time exif_data_save_data and exif_data_save_data_buf on a camera-style
+ * EXIF block, and count the allocator calls each save makes.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-mem.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EXIFSAVEBENCH_THUMBNAIL_SIZE 6143	/* a 160x120 JPEG */
+
+/* Allocator calls, counted by the ExifMem of the data */
+static unsigned long alloc_calls, realloc_calls;
+
+static void *
+count_alloc (ExifLong s)
+{
+	alloc_calls++;
+	return calloc (s, 1);
+}
+
+static void *
+count_realloc (void *p, ExifLong s)
+{
+	realloc_calls++;
+	return realloc (p, s);
+}
+
+static void
+count_free (void *p)
+{
+	free (p);
+}
+
+static void
+add_entry (ExifData *data, ExifMem *mem, ExifIfd ifd, ExifTag tag)
+{
+	ExifEntry *e = exif_entry_new_mem (mem);
+
+	if (!e)
+		return;
+	exif_content_add_entry (data->ifd[ifd], e);
+	exif_entry_initialize (e, tag);
+	exif_entry_unref (e);
+}
+
+static void
+add_value (ExifData *data, ExifMem *mem, ExifIfd ifd, ExifTag tag,
+	   ExifFormat format, const void *value, unsigned int size)
+{
+	ExifEntry *e = exif_entry_new_mem (mem);
+
+	if (!e)
+		return;
+	e->tag = tag;
+	e->format = format;
+	e->components = size / exif_format_get_size (format);
+	e->size = size;
+	e->data = exif_mem_alloc (mem, size);
+	if (e->data)
+		memcpy (e->data, value, size);
+	exif_content_add_entry (data->ifd[ifd], e);
+	exif_entry_unref (e);
+}
+
+#define add_string(data, mem, ifd, tag, s) \
+	add_value (data, mem, ifd, tag, EXIF_FORMAT_ASCII, s, sizeof (s))
+
+/*! About 45 tags in five IFDs and a thumbnail, as a phone camera writes */
+static ExifData *
+camera_data (ExifMem *mem)
+{
+	static const ExifTag exif_tags[] = {
+		EXIF_TAG_EXPOSURE_TIME, EXIF_TAG_FNUMBER,
+		EXIF_TAG_EXPOSURE_PROGRAM, EXIF_TAG_ISO_SPEED_RATINGS,
+		EXIF_TAG_EXIF_VERSION, EXIF_TAG_COMPONENTS_CONFIGURATION,
+		EXIF_TAG_SHUTTER_SPEED_VALUE, EXIF_TAG_APERTURE_VALUE,
+		EXIF_TAG_BRIGHTNESS_VALUE, EXIF_TAG_EXPOSURE_BIAS_VALUE,
+		EXIF_TAG_MAX_APERTURE_VALUE, EXIF_TAG_METERING_MODE,
+		EXIF_TAG_LIGHT_SOURCE, EXIF_TAG_FLASH, EXIF_TAG_FOCAL_LENGTH,
+		EXIF_TAG_FLASH_PIX_VERSION, EXIF_TAG_COLOR_SPACE,
+		EXIF_TAG_PIXEL_X_DIMENSION, EXIF_TAG_PIXEL_Y_DIMENSION,
+		EXIF_TAG_EXPOSURE_MODE, EXIF_TAG_WHITE_BALANCE,
+		EXIF_TAG_DIGITAL_ZOOM_RATIO, EXIF_TAG_SCENE_CAPTURE_TYPE,
+		EXIF_TAG_CONTRAST, EXIF_TAG_SATURATION, EXIF_TAG_SHARPNESS,
+		EXIF_TAG_USER_COMMENT
+	};
+	static const unsigned char gps_position[24] = { 0 };
+	ExifData *data = exif_data_new_mem (mem);
+	unsigned int i;
+
+	if (!data)
+		return NULL;
+	exif_data_set_byte_order (data, EXIF_BYTE_ORDER_INTEL);
+
+	add_string (data, mem, EXIF_IFD_0, EXIF_TAG_MAKE, "SAMSUNG");
+	add_string (data, mem, EXIF_IFD_0, EXIF_TAG_MODEL, "SCH-I510");
+	add_string (data, mem, EXIF_IFD_0, EXIF_TAG_DATE_TIME, "2011:06:30 12:00:00");
+	add_string (data, mem, EXIF_IFD_0, EXIF_TAG_SOFTWARE, "I510.GB");
+	add_entry (data, mem, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	add_entry (data, mem, EXIF_IFD_0, EXIF_TAG_Y_RESOLUTION);
+	add_entry (data, mem, EXIF_IFD_0, EXIF_TAG_RESOLUTION_UNIT);
+	add_entry (data, mem, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	add_entry (data, mem, EXIF_IFD_0, EXIF_TAG_YCBCR_POSITIONING);
+
+	for (i = 0; i < sizeof (exif_tags) / sizeof (exif_tags[0]); i++)
+		add_entry (data, mem, EXIF_IFD_EXIF, exif_tags[i]);
+	add_string (data, mem, EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_ORIGINAL, "2011:06:30 12:00:00");
+	add_string (data, mem, EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_DIGITIZED, "2011:06:30 12:00:00");
+
+	add_entry (data, mem, EXIF_IFD_INTEROPERABILITY, EXIF_TAG_INTEROPERABILITY_INDEX);
+	add_entry (data, mem, EXIF_IFD_INTEROPERABILITY, EXIF_TAG_INTEROPERABILITY_VERSION);
+
+	add_value (data, mem, EXIF_IFD_GPS, EXIF_TAG_GPS_LATITUDE, EXIF_FORMAT_RATIONAL,
+		   gps_position, sizeof (gps_position));
+	add_value (data, mem, EXIF_IFD_GPS, EXIF_TAG_GPS_LONGITUDE, EXIF_FORMAT_RATIONAL,
+		   gps_position, sizeof (gps_position));
+	add_string (data, mem, EXIF_IFD_GPS, EXIF_TAG_GPS_LATITUDE_REF, "N");
+	add_string (data, mem, EXIF_IFD_GPS, EXIF_TAG_GPS_LONGITUDE_REF, "W");
+	add_string (data, mem, EXIF_IFD_GPS, EXIF_TAG_GPS_PROCESSING_METHOD, "ASCII\0\0\0GPS");
+
+	add_entry (data, mem, EXIF_IFD_1, EXIF_TAG_COMPRESSION);
+	add_entry (data, mem, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+	add_entry (data, mem, EXIF_IFD_1, EXIF_TAG_Y_RESOLUTION);
+	add_entry (data, mem, EXIF_IFD_1, EXIF_TAG_RESOLUTION_UNIT);
+
+	data->data = exif_mem_alloc (mem, EXIFSAVEBENCH_THUMBNAIL_SIZE);
+	if (data->data) {
+		data->size = EXIFSAVEBENCH_THUMBNAIL_SIZE;
+		for (i = 0; i < data->size; i++)
+			data->data[i] = (unsigned char) (i * 7);
+	}
+	return data;
+}
+
+static double
+now_usec (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int
+main (int argc, char **argv)
+{
+	ExifMem *mem = exif_mem_new (count_alloc, count_realloc, count_free);
+	ExifData *data = camera_data (mem);
+	unsigned char *d = NULL, *buf;
+	unsigned int ds = 0, size, i, n = (argc > 1) ? atoi (argv[1]) : 100000;
+	double start, save_usec, buf_usec;
+	unsigned long save_allocs, save_reallocs;
+
+	if (!data || !n) {
+		fprintf (stderr, "Usage: %s [saves]\n", argv[0]);
+		return 2;
+	}
+
+	/* Both writers must produce the same bytes */
+	exif_data_save_data (data, &d, &ds);
+	size = exif_data_save_data_size (data);
+	buf = malloc (size);
+	if (!d || !buf || (size != ds) ||
+	    exif_data_save_data_buf (data, buf, size - 1) ||
+	    (exif_data_save_data_buf (data, buf, size) != size) ||
+	    memcmp (d, buf, size)) {
+		fprintf (stderr, "exif_data_save_data_buf differs from "
+			 "exif_data_save_data.\n");
+		return 1;
+	}
+	exif_mem_free (mem, d);
+
+	alloc_calls = realloc_calls = 0;
+	start = now_usec ();
+	for (i = 0; i < n; i++) {
+		exif_data_save_data (data, &d, &ds);
+		exif_mem_free (mem, d);
+	}
+	save_usec = (now_usec () - start) / n;
+	save_allocs = alloc_calls;
+	save_reallocs = realloc_calls;
+
+	alloc_calls = realloc_calls = 0;
+	start = now_usec ();
+	for (i = 0; i < n; i++)
+		exif_data_save_data_buf (data, buf, size);
+	buf_usec = (now_usec () - start) / n;
+
+	printf ("%u bytes of EXIF, %u byte thumbnail\n", size, data->size);
+	printf ("exif_data_save_data:     %.2f us/save, %.1f allocs, %.1f reallocs\n",
+		save_usec, (double) save_allocs / n, (double) save_reallocs / n);
+	printf ("exif_data_save_data_buf: %.2f us/save, %.1f allocs, %.1f reallocs\n",
+		buf_usec, (double) alloc_calls / n, (double) realloc_calls / n);
+
+	free (buf);
+	exif_data_unref (data);
+	exif_mem_unref (mem);
+	return 0;
+}
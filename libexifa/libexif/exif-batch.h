@@ -0,0 +1,65 @@
+/*! \file exif-batch.h
+ * \brief Load EXIF data from many files in parallel
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __EXIF_BATCH_H__
+#define __EXIF_BATCH_H__
+
+#include <libexif/exif-data.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*! Called by #exif_batch_load_files for each file, from the worker
+ * threads and in no particular order, so it has to do its own locking.
+ * The data and everything allocated from it are released when the
+ * callback returns and must not be kept.
+ *
+ * \param[in] index position of the file in the list
+ * \param[in] path the file
+ * \param[in] data its EXIF data, NULL if it has none or cannot be read
+ * \param[in] user_data the pointer given to #exif_batch_load_files
+ */
+typedef void (* ExifBatchFunc) (unsigned int index, const char *path,
+				ExifData *data, void *user_data);
+
+/*! Load the EXIF data of JPEG files and of files holding raw EXIF data.
+ * Only the headers up to the APP1 segment are read, then the data is
+ * parsed on a pool of threads, each allocating from its own arena.
+ *
+ * \param[in] paths the files
+ * \param[in] count number of files
+ * \param[in] threads number of threads, 0 for one per online CPU
+ * \param[in] options #ExifDataOption flags to set in addition to the
+ *   defaults of #exif_data_new
+ * \param[in] func called for every file
+ * \param[in] user_data passed to func
+ * \return number of files with EXIF data
+ */
+unsigned int exif_batch_load_files (const char * const *paths,
+				    unsigned int count, unsigned int threads,
+				    ExifDataOption options,
+				    ExifBatchFunc func, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __EXIF_BATCH_H__ */
@@ -119,6 +119,39 @@ void      exif_data_load_data (ExifData *data, const unsigned char *d,
 void      exif_data_save_data (ExifData *data, unsigned char **d,
 			       unsigned int *ds);
 
+/*! Return the number of bytes #exif_data_save_data would store for the
+ * #ExifData structure. The MakerNote, if any, is regenerated for its final
+ * offset.
+ *
+ * \param[in] data EXIF data
+ * \return number of bytes of raw EXIF data, or 0 on error
+ */
+unsigned int exif_data_save_data_size (ExifData *data);
+
+/*! Store raw EXIF data representing the #ExifData structure into a memory
+ * buffer provided by the caller. Nothing is written if the buffer is too
+ * small; #exif_data_save_data_size tells the size needed.
+ *
+ * \param[in] data EXIF data
+ * \param[out] d buffer to hold the raw EXIF data
+ * \param[in] size number of bytes available at d
+ * \return number of bytes of data stored at d, or 0 on error
+ */
+unsigned int exif_data_save_data_buf (ExifData *data, unsigned char *d,
+				      unsigned int size);
+
+/*! Like #exif_data_save_data_buf, but keep the MakerNote regenerated by
+ * the preceding #exif_data_save_data_size instead of building it again.
+ * The data must not change in between.
+ *
+ * \param[in] data EXIF data
+ * \param[out] d buffer to hold the raw EXIF data, NULL to only measure
+ * \param[in] size number of bytes available at d
+ * \return number of bytes of data stored at d, or 0 on error
+ */
+unsigned int exif_data_save_data_measured (ExifData *data, unsigned char *d,
+					   unsigned int size);
+
 void      exif_data_ref   (ExifData *data);
 void      exif_data_unref (ExifData *data);
 void      exif_data_free  (ExifData *data);
@@ -183,7 +216,13 @@ typedef enum {
 	EXIF_DATA_OPTION_FOLLOW_SPECIFICATION = 1 << 1,
 
 	/*! Leave the MakerNote alone, which could cause it to be corrupted */
-	EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE = 1 << 2
+	EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE = 1 << 2,
+
+	/*! Let entries and the thumbnail point into the buffer given to
+	 * #exif_data_load_data instead of copying their data. That buffer
+	 * must stay valid and unchanged for the life of the #ExifData, see
+	 * #exif_entry_own_data before modifying entry data in place */
+	EXIF_DATA_OPTION_BORROW_DATA = 1 << 3
 } ExifDataOption;
 
 /*! Return a short textual description of the given #ExifDataOption.
@@ -83,6 +83,28 @@ void  exif_mem_free    (ExifMem *m, void *p);
  */
 ExifMem *exif_mem_new_default (void);
 
+/*! Create a new ExifMem that hands out memory from large chunks, for
+ * structures that live and die together such as an #ExifData and all of
+ * its entries. Freeing only gives back the most recent allocation and
+ * reallocating it grows it in place; everything else is released at once
+ * when the last reference to the ExifMem is dropped. Memory returned by
+ * functions like exif_data_save_data belongs to the arena as well and
+ * must not be passed to free().
+ *
+ * \param[in] chunk_size size of the chunks, or 0 for a default suited to
+ *   camera EXIF data
+ * \return return a new arena ExifMem
+ */
+ExifMem *exif_mem_new_arena (ExifLong chunk_size);
+
+/*! Release everything allocated from an arena at once, keeping one chunk
+ * for the allocations that follow. Nothing allocated from the arena
+ * before may be used afterwards. Does nothing for other ExifMems.
+ *
+ * \param[in] mem an ExifMem from #exif_mem_new_arena
+ */
+void     exif_mem_arena_reset (ExifMem *mem);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -27,3 +27,27 @@ LOCAL_SRC_FILES:=\
 LOCAL_MODULE:= libjpega
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Host benchmark of the arena ExifMem
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)\
+	$(LOCAL_PATH)/libjpeg/\
+	$(LOCAL_PATH)/libexif/
+
+LOCAL_SRC_FILES:=\
+	jpegarenabench.c\
+	jpeg-data.c\
+	jpeg-marker.c\
+	exif-i18n.c
+
+LOCAL_STATIC_LIBRARIES:= \
+	libexifa_host
+
+LOCAL_LDLIBS += -lpthread -lm -lrt
+
+LOCAL_MODULE:= jpegarenabench
+
+include $(BUILD_HOST_EXECUTABLE)
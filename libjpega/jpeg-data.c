@@ -24,26 +24,74 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <sys/xattr.h>
+#define JPEG_DATA_SELINUX_XATTR "security.selinux"
+#endif
 
 /* This refers to the exif-i18n.h file from the "exif" package and is
  * NOT to be confused with the libexif/i18n.h file.
  */
 #include "exif-i18n.h"
 
-/* realloc that cleans up on memory failure and returns to caller */
-#define CLEANUP_REALLOC(p,s) { \
-	unsigned char *cleanup_ptr = realloc((p),(s)); \
-	if (!cleanup_ptr) { free(p); (p) = NULL; return; } \
-	(p) = cleanup_ptr; \
-}
-
 struct _JPEGDataPrivate
 {
 	unsigned int ref_count;
 
 	ExifLog *log;
+
+	/* Allocator for the EXIF data, NULL for the default one */
+	ExifMem *mem;
+
+	/*
+	 * Private mapping of the file given to jpeg_data_load_file_mapped. The
+	 * sections other than APP1 and the scan data point into it instead
+	 * of being copied.
+	 */
+	unsigned char *map;
+	size_t map_size;
+	dev_t map_dev;
+	ino_t map_ino;
+
+	/* Caller buffer given to jpeg_data_load_data_borrow */
+	const unsigned char *borrowed;
+	unsigned int borrowed_size;
 };
 
+/* Memory inside the mapping is released with it, not with free */
+static void
+jpeg_data_free_buf (JPEGData *data, unsigned char *p)
+{
+	if (data->priv && data->priv->map && (p >= data->priv->map) &&
+	    (p < data->priv->map + data->priv->map_size))
+		return;
+	if (data->priv && data->priv->borrowed &&
+	    (p >= data->priv->borrowed) &&
+	    (p < data->priv->borrowed + data->priv->borrowed_size))
+		return;
+	free (p);
+}
+
+JPEGData *
+jpeg_data_new_mem (ExifMem *mem)
+{
+	JPEGData *data;
+
+	data = jpeg_data_new ();
+	if (!data)
+		return (NULL);
+	data->priv->mem = mem;
+	exif_mem_ref (mem);
+
+	return (data);
+}
+
 JPEGData *
 jpeg_data_new (void)
 {
@@ -114,73 +162,251 @@ jpeg_data_save_file (JPEGData *data, const char *path)
 	return 0;
 }
 
-void
-jpeg_data_save_data (JPEGData *data, unsigned char **d, unsigned int *ds)
+/*
+ * Output of jpeg_data_save_sections. The generated bytes (markers,
+ * lengths and EXIF data) go to d. Section and scan data are copied
+ * there as well, or with iov set only referenced by the iovecs.
+ * With d == NULL, only the sizes are computed.
+ */
+typedef struct _JPEGDataWriter JPEGDataWriter;
+struct _JPEGDataWriter
 {
-	unsigned int i, eds = 0;
-	JPEGSection s;
-	unsigned char *ed = NULL;
+	unsigned char *d;
+	unsigned int ds;
+	unsigned int o;
 
-	if (!data)
+	int scatter;
+	struct iovec *iov;
+	unsigned int iovcnt;
+	unsigned int n;
+
+	/* Start of the bytes in d not covered by an iovec yet */
+	unsigned int run;
+
+	/* Size of the whole output */
+	unsigned int size;
+	int error;
+};
+
+static void
+jpeg_data_writer_iov (JPEGDataWriter *w, const unsigned char *p,
+		      unsigned int len)
+{
+	if (w->iov) {
+		if (w->n >= w->iovcnt) {
+			w->error = 1;
+			return;
+		}
+		w->iov[w->n].iov_base = (void *) p;
+		w->iov[w->n].iov_len = len;
+	}
+	w->n++;
+}
+
+/*! Reserve len bytes of d.
+ * \return where to write them, NULL when measuring or on error
+ */
+static unsigned char *
+jpeg_data_writer_space (JPEGDataWriter *w, unsigned int len)
+{
+	unsigned char *p;
+
+	if (w->error || (len > 0xffffffff - w->size)) {
+		w->error = 1;
+		return NULL;
+	}
+	if (w->d && (len > w->ds - w->o)) {
+		w->error = 1;
+		return NULL;
+	}
+	p = w->d ? w->d + w->o : NULL;
+	w->o += len;
+	w->size += len;
+	return p;
+}
+
+static void
+jpeg_data_writer_data (JPEGDataWriter *w, const unsigned char *p,
+		       unsigned int len)
+{
+	unsigned char *t;
+
+	if (!len)
 		return;
-	if (!d)
+	if (!w->scatter) {
+		t = jpeg_data_writer_space (w, len);
+		if (t)
+			memcpy (t, p, len);
 		return;
-	if (!ds)
+	}
+	if (w->error || (len > 0xffffffff - w->size)) {
+		w->error = 1;
 		return;
+	}
+	if (w->o > w->run) {
+		jpeg_data_writer_iov (w, w->d + w->run, w->o - w->run);
+		w->run = w->o;
+	}
+	jpeg_data_writer_iov (w, p, len);
+	w->size += len;
+}
 
-	for (*ds = i = 0; i < data->count; i++) {
-		s = data->sections[i];
-
-		/* Write the marker */
-		CLEANUP_REALLOC (*d, sizeof (char) * (*ds + 2));
-		(*d)[*ds + 0] = 0xff;
-		(*d)[*ds + 1] = s.marker;
-		*ds += 2;
+/*! Serialize the sections, appending pad zero bytes to the APP1
+ *  segment. EXIF readers ignore them as all offsets are relative to the
+ *  TIFF header. With header set, stop at the start of the scan data.
+ *  With measured set, the EXIF data has been measured by a previous pass
+ *  and its MakerNote is not regenerated.
+ * \return the size of the output, 0 if it cannot be written
+ */
+static unsigned int
+jpeg_data_save_sections (JPEGData *data, JPEGDataWriter *w,
+			 unsigned int pad, int header, int measured)
+{
+	unsigned int i, eds = 0, len;
+	unsigned char *t;
+	JPEGSection *s;
 
-		switch (s.marker) {
+	for (i = 0; i < data->count; i++) {
+		s = &data->sections[i];
+		switch (s->marker) {
 		case JPEG_MARKER_SOI:
 		case JPEG_MARKER_EOI:
+			len = 0;
 			break;
 		case JPEG_MARKER_APP1:
-			exif_data_save_data (s.content.app1, &ed, &eds);
-			if (!ed) break;
-			CLEANUP_REALLOC (*d, sizeof (char) * (*ds + 2));
-			(*d)[*ds + 0] = (eds + 2) >> 8;
-			(*d)[*ds + 1] = (eds + 2) >> 0;
-			*ds += 2;
-			CLEANUP_REALLOC (*d, sizeof (char) * (*ds + eds));
-			memcpy (*d + *ds, ed, eds);
-			*ds += eds;
-			free (ed);
+			eds = measured ?
+				exif_data_save_data_measured (s->content.app1,
+							      NULL, 0) :
+				exif_data_save_data_size (s->content.app1);
+			if (!eds) continue;
+			len = eds + pad;
 			break;
 		default:
-			CLEANUP_REALLOC (*d, sizeof (char) *
-					(*ds + s.content.generic.size + 2));
-			(*d)[*ds + 0] = (s.content.generic.size + 2) >> 8;
-			(*d)[*ds + 1] = (s.content.generic.size + 2) >> 0;
-			*ds += 2;
-			memcpy (*d + *ds, s.content.generic.data,
-				s.content.generic.size);
-			*ds += s.content.generic.size;
-
-			/* In case of SOS, we need to write the data. */
-			if (s.marker == JPEG_MARKER_SOS) {
-				CLEANUP_REALLOC (*d, *ds + data->size);
-				memcpy (*d + *ds, data->data, data->size);
-				*ds += data->size;
-			}
+			len = s->content.generic.size;
 			break;
 		}
+		if (len + 2 > 0xffff)
+			return 0;
+		t = jpeg_data_writer_space (w, len ? 4 : 2);
+		if (t) {
+			t[0] = 0xff;
+			t[1] = s->marker;
+			if (len) {
+				t[2] = (len + 2) >> 8;
+				t[3] = (len + 2) >> 0;
+			}
+		}
+		if (s->marker == JPEG_MARKER_APP1) {
+			t = jpeg_data_writer_space (w, len);
+			if (t) {
+				exif_data_save_data_measured (s->content.app1,
+							      t, eds);
+				memset (t + eds, 0, pad);
+			}
+			pad = 0;
+		} else if (len)
+			jpeg_data_writer_data (w, s->content.generic.data, len);
+		if (s->marker != JPEG_MARKER_SOS)
+			continue;
+		if (header)
+			break;
+
+		/* In case of SOS, we need to write the data. */
+		jpeg_data_writer_data (w, data->data, data->size);
+	}
+	if ((header && (i == data->count)) || pad)
+		return 0;
+
+	/* Close the last run of generated bytes */
+	if (w->scatter && (w->o > w->run)) {
+		jpeg_data_writer_iov (w, w->d + w->run, w->o - w->run);
+		w->run = w->o;
 	}
+	return w->error ? 0 : w->size;
 }
 
-/* Following function added to implement the zero copy save routine.
-   2011.06.30 - Samsung Electronics */
-void jpeg_data_save_data_no_copy(JPEGData *data, unsigned char *d, unsigned int *ds)
+/*! Measure the output, building the MakerNote once, then write it if it
+ *  fits into w. Nothing is written when it does not.
+ * \return the size of the output, 0 if it cannot be written
+ */
+static unsigned int
+jpeg_data_save_checked (JPEGData *data, JPEGDataWriter *w)
 {
-	unsigned int i, eds = 0;
-	JPEGSection s;
-	unsigned char *ed = NULL;
+	JPEGDataWriter m;
+
+	memset (&m, 0, sizeof (m));
+	m.scatter = w->scatter;
+	if (!jpeg_data_save_sections (data, &m, 0, 0, 0) || (m.o > w->ds) ||
+	    (w->iov && (m.n > w->iovcnt)))
+		return 0;
+	return jpeg_data_save_sections (data, w, 0, 0, 1);
+}
+
+unsigned int
+jpeg_data_save_data_size (JPEGData *data)
+{
+	JPEGDataWriter w;
+
+	if (!data)
+		return 0;
+	memset (&w, 0, sizeof (w));
+	return jpeg_data_save_sections (data, &w, 0, 0, 0);
+}
+
+unsigned int
+jpeg_data_save_data_buf (JPEGData *data, unsigned char *d, unsigned int size)
+{
+	JPEGDataWriter w;
+
+	if (!data || !d)
+		return 0;
+	memset (&w, 0, sizeof (w));
+	w.d = d;
+	w.ds = size;
+	return jpeg_data_save_checked (data, &w);
+}
+
+unsigned int
+jpeg_data_save_iov_size (JPEGData *data, unsigned int *count)
+{
+	JPEGDataWriter w;
+
+	if (!data || !count)
+		return 0;
+	memset (&w, 0, sizeof (w));
+	w.scatter = 1;
+	*count = 0;
+	if (!jpeg_data_save_sections (data, &w, 0, 0, 0))
+		return 0;
+	*count = w.n;
+	return w.o;
+}
+
+unsigned int
+jpeg_data_save_iov (JPEGData *data, unsigned char *d, unsigned int size,
+		    struct iovec *iov, unsigned int count)
+{
+	JPEGDataWriter w;
+
+	if (!data || !d || !iov)
+		return 0;
+	memset (&w, 0, sizeof (w));
+	w.d = d;
+	w.ds = size;
+	w.scatter = 1;
+	w.iov = iov;
+	w.iovcnt = count;
+	if (!jpeg_data_save_checked (data, &w))
+		return 0;
+	return w.n;
+}
+
+void
+jpeg_data_save_data (JPEGData *data, unsigned char **d, unsigned int *ds)
+{
+	JPEGDataWriter w;
+	unsigned char *t;
+	unsigned int size;
 
 	if (!data)
 		return;
@@ -189,50 +415,348 @@ void jpeg_data_save_data_no_copy(JPEGData *data, unsigned char *d, unsigned int
 	if (!ds)
 		return;
 
-	for (*ds = i = 0; i < data->count; i++) {
-		s = data->sections[i];
+	*ds = 0;
+	size = jpeg_data_save_data_size (data);
+	if (!size)
+		return;
+	t = realloc (*d, size);
+	if (!t) {
+		EXIF_LOG_NO_MEMORY (data->priv->log, "jpeg-data", size);
+		free (*d);
+		*d = NULL;
+		return;
+	}
+	*d = t;
+
+	/* Write what was just measured, the MakerNote is only built once */
+	memset (&w, 0, sizeof (w));
+	w.d = *d;
+	w.ds = size;
+	*ds = jpeg_data_save_sections (data, &w, 0, 0, 1);
+}
 
-		/* Write the marker */
-		//CLEANUP_REALLOC (*d, sizeof (char) * (*ds + 2));
-		d[*ds + 0] = 0xff;
-		d[*ds + 1] = s.marker;
-		*ds += 2;
+/* Following function added to implement the zero copy save routine.
+   2011.06.30 - Samsung Electronics */
+void jpeg_data_save_data_no_copy(JPEGData *data, unsigned char *d, unsigned int *ds)
+{
+	JPEGDataWriter w;
 
-		switch (s.marker) {
-		case JPEG_MARKER_SOI:
-		case JPEG_MARKER_EOI:
-			break;
-		case JPEG_MARKER_APP1:
-			exif_data_save_data (s.content.app1, &ed, &eds);
-			if (!ed) break;
-			//CLEANUP_REALLOC (*d, sizeof (char) * (*ds + 2));
-			d[*ds + 0] = (eds + 2) >> 8;
-			d[*ds + 1] = (eds + 2) >> 0;
-			*ds += 2;
-			//CLEANUP_REALLOC (*d, sizeof (char) * (*ds + eds));
-			memcpy (d + *ds, ed, eds);
-			*ds += eds;
-			free (ed);
+	if (!ds)
+		return;
+
+	/* The size of d is not known here, see jpeg_data_save_data_buf */
+	*ds = 0;
+	if (!d)
+		return;
+	memset (&w, 0, sizeof (w));
+	w.d = d;
+	w.ds = jpeg_data_save_data_size (data);
+	if (w.ds)
+		*ds = jpeg_data_save_sections (data, &w, 0, 0, 1);
+}
+
+static int
+jpeg_data_write_all (int fd, const unsigned char *d, size_t size, off_t o)
+{
+	ssize_t n;
+
+	while (size) {
+		n = (o < 0) ? write (fd, d, size) : pwrite (fd, d, size, o);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+			return 0;
+		d += n;
+		size -= n;
+		if (o >= 0)
+			o += n;
+	}
+	return 1;
+}
+
+/* Bytes moved per pwrite when the scan data is shifted in place */
+#define JPEG_DATA_SHIFT_CHUNK 65536
+
+/*! Give the new file at out the owner and the SELinux label of the old
+ *  file at fd, which st describes. Returns 0 if either cannot be kept.
+ */
+static int
+jpeg_data_copy_attrs (int fd, int out, const struct stat *st)
+{
+#ifdef JPEG_DATA_SELINUX_XATTR
+	char label[256];
+	ssize_t n;
+#endif
+
+	if (fchown (out, st->st_uid, st->st_gid))
+		return 0;
+	if (fchmod (out, st->st_mode & 07777))
+		return 0;
+#ifdef JPEG_DATA_SELINUX_XATTR
+	n = fgetxattr (fd, JPEG_DATA_SELINUX_XATTR, label, sizeof (label));
+	if (n < 0)
+		return (errno == ENODATA) || (errno == ENOTSUP);
+	if (fsetxattr (out, JPEG_DATA_SELINUX_XATTR, label, n, 0))
+		return 0;
+#endif
+	return 1;
+}
+
+/*! Make a rename in the directory of path durable */
+static int
+jpeg_data_sync_dir (const char *path)
+{
+	const char *slash = strrchr (path, '/');
+	char *dir;
+	int fd, r;
+
+	if (!slash)
+		dir = strdup (".");
+	else if (slash == path)
+		dir = strdup ("/");
+	else
+		dir = strndup (path, slash - path);
+	if (!dir)
+		return 0;
+	fd = open (dir, O_RDONLY | O_DIRECTORY);
+	free (dir);
+	if (fd < 0)
+		return 0;
+	r = !fsync (fd);
+	close (fd);
+	return r;
+}
+
+/*! Write the headers d followed by the unchanged rest of the mapped
+ *  file to a new file, then rename it over path. The new file is synced
+ *  before the rename and the directory after it, so that a crash leaves
+ *  either the old or the new file. Returns 1 on success, 0 on failure
+ *  and -1, with path untouched, if the new file cannot get the owner or
+ *  SELinux label of the old one.
+ */
+static int
+jpeg_data_splice_file (JPEGData *data, int fd, const char *path,
+		       const unsigned char *d, unsigned int ds,
+		       unsigned int hs, const struct stat *st)
+{
+	char *tmp;
+	int out, r;
+	size_t len = data->priv->map_size - hs;
+#ifdef __NR_copy_file_range
+	long long in_o = hs;
+	ssize_t n;
+#endif
+
+	tmp = malloc (strlen (path) + 8);
+	if (!tmp)
+		return 0;
+	sprintf (tmp, "%s.XXXXXX", path);
+	out = mkstemp (tmp);
+	if (out < 0) {
+		free (tmp);
+		return 0;
+	}
+	if (!jpeg_data_copy_attrs (fd, out, st)) {
+		close (out);
+		unlink (tmp);
+		free (tmp);
+		return -1;
+	}
+	r = jpeg_data_write_all (out, d, ds, -1);
+
+	/* Let the kernel copy the scan data where it can */
+#ifdef __NR_copy_file_range
+	while (r && len) {
+		n = syscall (__NR_copy_file_range, fd, &in_o, out, NULL, len, 0);
+		if (n <= 0)
 			break;
-		default:
-			/*CLEANUP_REALLOC (*d, sizeof (char) *
-					(*ds + s.content.generic.size + 2));*/
-			d[*ds + 0] = (s.content.generic.size + 2) >> 8;
-			d[*ds + 1] = (s.content.generic.size + 2) >> 0;
-			*ds += 2;
-			memcpy (d + *ds, s.content.generic.data,
-				s.content.generic.size);
-			*ds += s.content.generic.size;
-
-			/* In case of SOS, we need to write the data. */
-			if (s.marker == JPEG_MARKER_SOS) {
-				//CLEANUP_REALLOC (*d, *ds + data->size);
-				memcpy (d + *ds, data->data, data->size);
-				*ds += data->size;
-			}
+		len -= n;
+	}
+#endif
+	if (r && len)
+		r = jpeg_data_write_all (out,
+			data->priv->map + data->priv->map_size - len, len, -1);
+	if (r && fsync (out))
+		r = 0;
+	if (close (out))
+		r = 0;
+	if (r && rename (tmp, path))
+		r = 0;
+	if (!r)
+		unlink (tmp);
+	else
+		jpeg_data_sync_dir (path);
+	free (tmp);
+	return r;
+}
+
+/*! Copy the sections in front of the scan data that point into the
+ *  mapping, before the file under them is overwritten. The mapping is
+ *  private but still shows the file where it was not written to.
+ */
+static int
+jpeg_data_copy_headers (JPEGData *data)
+{
+	JPEGDataPrivate *p = data->priv;
+	JPEGSection *s;
+	unsigned char *c;
+	unsigned int i;
+
+	for (i = 0; i < data->count; i++) {
+		s = &data->sections[i];
+		if ((s->marker == JPEG_MARKER_SOI) ||
+		    (s->marker == JPEG_MARKER_EOI) ||
+		    (s->marker == JPEG_MARKER_APP1) ||
+		    (s->content.generic.data < p->map) ||
+		    (s->content.generic.data >= data->data))
+			continue;
+		c = malloc (s->content.generic.size);
+		if (!c)
+			return 0;
+		memcpy (c, s->content.generic.data, s->content.generic.size);
+		s->content.generic.data = c;
+	}
+	return 1;
+}
+
+/*! Write the headers d over the hs bytes of headers in the file itself,
+ *  moving the rest of the file to follow them. This keeps the owner and
+ *  label of the file but is not atomic, it is only used if a new file
+ *  cannot get them. The mapping is replaced by one of the new file.
+ */
+static int
+jpeg_data_shift_file (JPEGData *data, int fd, const unsigned char *d,
+		      unsigned int ds, unsigned int hs)
+{
+	JPEGDataPrivate *p = data->priv;
+	size_t len = p->map_size - hs, size = p->map_size - hs + ds, o, n;
+	unsigned char *map, *buf;
+	const unsigned char *src;
+	unsigned int i;
+	JPEGSection *s;
+
+	/* Map the new file first, a failure leaves everything as it was */
+	buf = malloc (JPEG_DATA_SHIFT_CHUNK);
+	if (!buf)
+		return 0;
+	if ((size > p->map_size) && ftruncate (fd, size)) {
+		free (buf);
+		return 0;
+	}
+	map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if ((map == MAP_FAILED) || !jpeg_data_copy_headers (data)) {
+		if (map != MAP_FAILED)
+			munmap (map, size);
+		if (size > p->map_size)
+			ftruncate (fd, p->map_size);
+		free (buf);
+		return 0;
+	}
+
+	/*
+	 * Move the rest of the file like memmove: from its end if it moves
+	 * up, from its start if it moves down, so that every part of the
+	 * old mapping is read before the file under it is overwritten. The
+	 * mapping shows the file pages themselves, each chunk is copied out
+	 * before it is written back shifted over itself.
+	 */
+	for (o = 0; o < len; o += n) {
+		n = (len - o > JPEG_DATA_SHIFT_CHUNK) ?
+			JPEG_DATA_SHIFT_CHUNK : len - o;
+		src = (ds > hs) ? p->map + p->map_size - o - n : p->map + hs + o;
+		memcpy (buf, src, n);
+		if (!jpeg_data_write_all (fd, buf, n, (ds > hs) ?
+					  size - o - n : ds + o))
 			break;
-		}
 	}
+	free (buf);
+	if ((o < len) || !jpeg_data_write_all (fd, d, ds, 0) ||
+	    ((size < p->map_size) && ftruncate (fd, size))) {
+		munmap (map, size);
+		return 0;
+	}
+
+	/* The scan data and what follows it moved with the rest */
+	for (i = 0; i < data->count; i++) {
+		s = &data->sections[i];
+		if ((s->marker != JPEG_MARKER_SOI) &&
+		    (s->marker != JPEG_MARKER_EOI) &&
+		    (s->marker != JPEG_MARKER_APP1) &&
+		    (s->content.generic.data >= data->data) &&
+		    (s->content.generic.data < p->map + p->map_size))
+			s->content.generic.data = map + ds +
+				(s->content.generic.data - data->data);
+	}
+	data->data = map + ds;
+	munmap (p->map, p->map_size);
+	p->map = map;
+	p->map_size = size;
+	return 1;
+}
+
+/*! jpeg_data_update_file returns 1 on success, 0 on failure */
+int
+jpeg_data_update_file (JPEGData *data, const char *path)
+{
+	JPEGDataPrivate *p;
+	JPEGDataWriter w;
+	unsigned char *d;
+	unsigned int hs, ds, pad = 0;
+	struct stat st;
+	int fd, r;
+
+	if (!data || !data->priv || !path)
+		return 0;
+	p = data->priv;
+
+	/* Only a file that is still the one we mapped can be updated */
+	if (!p->map || !data->data || (data->data < p->map) ||
+	    (data->data > p->map + p->map_size))
+		return jpeg_data_save_file (data, path);
+	fd = open (path, O_RDWR);
+	if (fd < 0)
+		return 0;
+	if (fstat (fd, &st) || (st.st_dev != p->map_dev) ||
+	    (st.st_ino != p->map_ino) || (st.st_size != (off_t) p->map_size)) {
+		close (fd);
+		return jpeg_data_save_file (data, path);
+	}
+
+	/*
+	 * Pad smaller headers up to the old size to keep the scan in place.
+	 * Only the first pass builds the MakerNote, the others reuse it.
+	 */
+	hs = data->data - p->map;
+	memset (&w, 0, sizeof (w));
+	ds = jpeg_data_save_sections (data, &w, 0, 1, 0);
+	memset (&w, 0, sizeof (w));
+	if (ds && (ds < hs) && jpeg_data_save_sections (data, &w, hs - ds, 1, 1)) {
+		pad = hs - ds;
+		ds = hs;
+	}
+	d = ds ? malloc (ds) : NULL;
+	memset (&w, 0, sizeof (w));
+	w.d = d;
+	w.ds = ds;
+	if (!d || (jpeg_data_save_sections (data, &w, pad, 1, 1) != ds)) {
+		free (d);
+		close (fd);
+		return 0;
+	}
+
+	if (ds != hs) {
+		r = jpeg_data_splice_file (data, fd, path, d, ds, hs, &st);
+		if (r < 0)
+			r = jpeg_data_shift_file (data, fd, d, ds, hs);
+	} else {
+		r = jpeg_data_copy_headers (data);
+		if (r)
+			r = jpeg_data_write_all (fd, d, ds, 0);
+	}
+	free (d);
+	if (close (fd))
+		r = 0;
+	return r;
 }
 
 JPEGData *
@@ -246,9 +770,12 @@ jpeg_data_new_from_data (const unsigned char *d,
 	return (data);
 }
 
-void
-jpeg_data_load_data (JPEGData *data, const unsigned char *d,
-		     unsigned int size)
+/*! Parse the sections in d. With copy == 0, d must stay valid as long
+ *  as data does, the section and scan data point into it.
+ */
+static void
+jpeg_data_load_sections (JPEGData *data, unsigned char *d,
+			 unsigned int size, int copy)
 {
 	unsigned int i, o, len;
 	JPEGSection *s;
@@ -299,19 +826,25 @@ jpeg_data_load_data (JPEGData *data, const unsigned char *d,
                2012.04.05 - Samsung Electronics */
 				/*s->content.app1 = exif_data_new_from_data (
 							d + o - 4, len + 4); */
-				s->content.app1 = exif_data_new();
+				s->content.app1 = data->priv->mem ?
+					exif_data_new_mem (data->priv->mem) :
+					exif_data_new ();
                 exif_data_log(s->content.app1, data->priv->log);
             	exif_data_load_data (s->content.app1, d + o - 4, len + 4);
 				break;
 			default:
-				s->content.generic.data =
+				if (!copy)
+					s->content.generic.data = &d[o];
+				else {
+					s->content.generic.data =
 						malloc (sizeof (char) * len);
-				if (!s->content.generic.data) {
-					EXIF_LOG_NO_MEMORY (data->priv->log, "jpeg-data", sizeof (char) * len);
-					return;
+					if (!s->content.generic.data) {
+						EXIF_LOG_NO_MEMORY (data->priv->log, "jpeg-data", sizeof (char) * len);
+						return;
+					}
+					memcpy (s->content.generic.data, &d[o], len);
 				}
 				s->content.generic.size = len;
-				memcpy (s->content.generic.data, &d[o], len);
 
 				/* In case of SOS, image data will follow. */
 				if (s->marker == JPEG_MARKER_SOS) {
@@ -328,15 +861,19 @@ jpeg_data_load_data (JPEGData *data, const unsigned char *d,
 							data->size += 2;
 						}
 					}
-					data->data = malloc (
-						sizeof (char) * data->size);
-					if (!data->data) {
-						EXIF_LOG_NO_MEMORY (data->priv->log, "jpeg-data", sizeof (char) * data->size);
-						data->size = 0;
-						return;
+					if (!copy)
+						data->data = d + o + len;
+					else {
+						data->data = malloc (
+							sizeof (char) * data->size);
+						if (!data->data) {
+							EXIF_LOG_NO_MEMORY (data->priv->log, "jpeg-data", sizeof (char) * data->size);
+							data->size = 0;
+							return;
+						}
+						memcpy (data->data, d + o + len,
+							data->size);
 					}
-					memcpy (data->data, d + o + len,
-						data->size);
 					o += data->size;
 				}
 				break;
@@ -347,6 +884,34 @@ jpeg_data_load_data (JPEGData *data, const unsigned char *d,
 	}
 }
 
+void
+jpeg_data_load_data (JPEGData *data, const unsigned char *d,
+		     unsigned int size)
+{
+	if (!data) return;
+	if (!d) return;
+
+	/* The caller keeps d, copy what we keep */
+	jpeg_data_load_sections (data, (unsigned char *) d, size, 1);
+}
+
+void
+jpeg_data_load_data_borrow (JPEGData *data, const unsigned char *d,
+			    unsigned int size)
+{
+	if (!data) return;
+	if (!d) return;
+
+	/* Only one buffer can be tracked, copy from any further ones */
+	if (data->priv->borrowed) {
+		jpeg_data_load_sections (data, (unsigned char *) d, size, 1);
+		return;
+	}
+	data->priv->borrowed = d;
+	data->priv->borrowed_size = size;
+	jpeg_data_load_sections (data, (unsigned char *) d, size, 0);
+}
+
 JPEGData *
 jpeg_data_new_from_file (const char *path)
 {
@@ -404,6 +969,50 @@ jpeg_data_load_file (JPEGData *data, const char *path)
 	free (d);
 }
 
+void
+jpeg_data_load_file_mapped (JPEGData *data, const char *path)
+{
+	unsigned char *d;
+	int fd;
+	struct stat st;
+
+	if (!data) return;
+	if (!path) return;
+
+	/*
+	 * Map the file instead of reading it. Only the pages of the headers
+	 * are touched while parsing, the scan data is kept as a range of
+	 * the mapping and only read when saving. The mapping is private so
+	 * that writes through the section data do not reach the file.
+	 */
+	if (!data->priv->map) {
+		fd = open (path, O_RDONLY);
+		if (fd < 0) {
+			exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA, "jpeg-data",
+					_("Path '%s' invalid."), path);
+			return;
+		}
+		if (!fstat (fd, &st) && S_ISREG (st.st_mode) &&
+		    (st.st_size > 0) && (st.st_size <= 0x7fffffff)) {
+			d = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE,
+				  MAP_PRIVATE, fd, 0);
+			if (d != MAP_FAILED) {
+				close (fd);
+				data->priv->map = d;
+				data->priv->map_size = st.st_size;
+				data->priv->map_dev = st.st_dev;
+				data->priv->map_ino = st.st_ino;
+				jpeg_data_load_sections (data, d, st.st_size, 0);
+				return;
+			}
+		}
+		close (fd);
+	}
+
+	/* Files that cannot be mapped are read into memory */
+	jpeg_data_load_file (data, path);
+}
+
 void
 jpeg_data_ref (JPEGData *data)
 {
@@ -446,7 +1055,7 @@ jpeg_data_free (JPEGData *data)
 				exif_data_unref (s.content.app1);
 				break;
 			default:
-				free (s.content.generic.data);
+				jpeg_data_free_buf (data, s.content.generic.data);
 				break;
 			}
 		}
@@ -454,13 +1063,19 @@ jpeg_data_free (JPEGData *data)
 	}
 
 	if (data->data)
-		free (data->data);
+		jpeg_data_free_buf (data, data->data);
 
 	if (data->priv) {
 		if (data->priv->log) {
 			exif_log_unref (data->priv->log);
 			data->priv->log = NULL;
 		}
+		if (data->priv->mem) {
+			exif_mem_unref (data->priv->mem);
+			data->priv->mem = NULL;
+		}
+		if (data->priv->map)
+			munmap (data->priv->map, data->priv->map_size);
 		free (data->priv);
 	}
 
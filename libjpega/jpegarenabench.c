@@ -0,0 +1,230 @@
+/* jpegarenabench.c
+ *
+ * Time load plus save round trips of a JPEG with the default ExifMem and
+ * with an arena from exif_mem_new_arena, and count the malloc calls each
+ * round trip makes.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include "jpeg-data.h"
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-mem.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define JPEGARENABENCH_SCAN_SIZE 500000
+#define JPEGARENABENCH_THUMBNAIL_SIZE 6143	/* a 160x120 JPEG */
+
+/*
+ * The arena takes its chunks from malloc directly, so the calls are
+ * counted at malloc rather than at the ExifMem. This needs glibc, which
+ * exports the allocator under its own names as well.
+ */
+static unsigned long malloc_calls;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc (size_t);
+extern void *__libc_calloc (size_t, size_t);
+extern void *__libc_realloc (void *, size_t);
+
+void *
+malloc (size_t s)
+{
+	malloc_calls++;
+	return __libc_malloc (s);
+}
+
+void *
+calloc (size_t n, size_t s)
+{
+	malloc_calls++;
+	return __libc_calloc (n, s);
+}
+
+void *
+realloc (void *p, size_t s)
+{
+	malloc_calls++;
+	return __libc_realloc (p, s);
+}
+#endif
+
+static unsigned int
+put_marker (unsigned char *d, unsigned char marker, unsigned int length)
+{
+	d[0] = 0xff;
+	d[1] = marker;
+	d[2] = (unsigned char) ((length + 2) >> 8);
+	d[3] = (unsigned char) (length + 2);
+	return 4;
+}
+
+/*! A camera-sized JPEG: the mandatory EXIF tags and a thumbnail, a
+ *  quantization table and JPEGARENABENCH_SCAN_SIZE bytes of scan data */
+static unsigned char *
+synthetic_jpeg (unsigned int *size)
+{
+	ExifData *data = exif_data_new ();
+	unsigned char *exif = NULL, *d;
+	unsigned int es = 0, i, o = 0;
+
+	if (!data)
+		return NULL;
+	data->data = malloc (JPEGARENABENCH_THUMBNAIL_SIZE);
+	if (data->data) {
+		data->size = JPEGARENABENCH_THUMBNAIL_SIZE;
+		for (i = 0; i < data->size; i++)
+			data->data[i] = (unsigned char) (i * 7);
+	}
+	exif_data_save_data (data, &exif, &es);
+	exif_data_unref (data);
+	if (!exif)
+		return NULL;
+
+	d = malloc (es + JPEGARENABENCH_SCAN_SIZE + 128);
+	if (d) {
+		d[o++] = 0xff;
+		d[o++] = JPEG_MARKER_SOI;
+		o += put_marker (d + o, JPEG_MARKER_APP1, es);
+		memcpy (d + o, exif, es);
+		o += es;
+		o += put_marker (d + o, JPEG_MARKER_DQT, 65);
+		memset (d + o, 1, 65);
+		o += 65;
+		o += put_marker (d + o, JPEG_MARKER_SOS, 10);
+		memset (d + o, 2, 10);
+		o += 10;
+		memset (d + o, 0x55, JPEGARENABENCH_SCAN_SIZE);
+		o += JPEGARENABENCH_SCAN_SIZE;
+		d[o++] = 0xff;
+		d[o++] = JPEG_MARKER_EOI;
+		*size = o;
+	}
+	free (exif);
+	return d;
+}
+
+static unsigned char *
+read_file (const char *path, unsigned int *size)
+{
+	FILE *f = fopen (path, "rb");
+	unsigned char *d = NULL;
+	long s;
+
+	if (!f)
+		return NULL;
+	if (!fseek (f, 0, SEEK_END) && ((s = ftell (f)) > 0) &&
+	    !fseek (f, 0, SEEK_SET) && (d = malloc (s)) &&
+	    (fread (d, 1, s, f) != (size_t) s)) {
+		free (d);
+		d = NULL;
+	}
+	fclose (f);
+	*size = d ? (unsigned int) s : 0;
+	return d;
+}
+
+static double
+now_usec (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*! Load d, save it again and free everything, using an arena if asked */
+static unsigned char *
+round_trip (const unsigned char *d, unsigned int size, int arena,
+	    unsigned int *out_size)
+{
+	JPEGData *data;
+	unsigned char *out = NULL;
+
+	if (arena) {
+		ExifMem *mem = exif_mem_new_arena (0);
+
+		data = jpeg_data_new_mem (mem);
+		exif_mem_unref (mem);
+	} else
+		data = jpeg_data_new ();
+	if (!data)
+		return NULL;
+	*out_size = 0;
+	jpeg_data_load_data (data, d, size);
+	jpeg_data_save_data (data, &out, out_size);
+	jpeg_data_unref (data);
+	return out;
+}
+
+int
+main (int argc, char **argv)
+{
+	static const char *names[] = { "default", "arena" };
+	unsigned int size, n = (argc > 1) ? atoi (argv[1]) : 2000, i;
+	unsigned char *d = (argc > 2) ? read_file (argv[2], &size) :
+					synthetic_jpeg (&size);
+	unsigned char *out[2];
+	unsigned int out_size[2];
+	int arena;
+
+	if (!d || !n) {
+		fprintf (stderr, "Usage: %s [round trips] [file.jpg]\n", argv[0]);
+		return 2;
+	}
+
+	/* Both allocators must produce the same bytes */
+	for (arena = 0; arena < 2; arena++)
+		out[arena] = round_trip (d, size, arena, &out_size[arena]);
+	if (!out[0] || !out[1] || (out_size[0] != out_size[1]) ||
+	    memcmp (out[0], out[1], out_size[0])) {
+		fprintf (stderr, "The arena round trip differs from the "
+			 "default one.\n");
+		return 1;
+	}
+
+	printf ("%u bytes in, %u bytes out\n", size, out_size[0]);
+	for (arena = 0; arena < 2; arena++) {
+		unsigned long calls;
+		double start, usec;
+
+		malloc_calls = 0;
+		start = now_usec ();
+		for (i = 0; i < n; i++)
+			free (round_trip (d, size, arena, &out_size[arena]));
+		usec = (now_usec () - start) / n;
+		calls = malloc_calls;
+#ifdef __GLIBC__
+		printf ("%-7s: %.1f us/round trip, %.0f MB/s, %.1f mallocs\n",
+			names[arena], usec, size / usec,
+			(double) calls / n);
+#else
+		printf ("%-7s: %.1f us/round trip, %.0f MB/s\n",
+			names[arena], usec, size / usec);
+		(void) calls;
+#endif
+	}
+
+	free (out[0]);
+	free (out[1]);
+	free (d);
+	return 0;
+}
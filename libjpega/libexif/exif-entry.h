@@ -116,6 +116,16 @@ void        exif_entry_unref   (ExifEntry *entry);
  */
 void        exif_entry_free  (ExifEntry *entry);
 
+/*! Make sure the \c data of the #ExifEntry belongs to it. Entries loaded
+ * with #EXIF_DATA_OPTION_BORROW_DATA point into the buffer they were loaded
+ * from; their data is copied here so that it can be modified in place or
+ * outlive that buffer. Does nothing for any other entry.
+ *
+ * \param[in,out] entry EXIF entry
+ * \return 1 on success, 0 if the data could not be copied
+ */
+int         exif_entry_own_data (ExifEntry *entry);
+
 /*! Initialize an empty #ExifEntry with default data in the correct format
  * for the given tag. If the entry is already initialized, this function
  * does nothing.
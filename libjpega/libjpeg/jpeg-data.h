@@ -26,6 +26,8 @@
 #include <libexif/exif-data.h>
 #include <libexif/exif-log.h>
 
+#include <sys/uio.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -68,6 +70,9 @@ struct _JPEGData
 };
 
 JPEGData *jpeg_data_new           (void);
+/* The EXIF data loaded into the JPEGData is allocated from mem, which may
+   be an arena from exif_mem_new_arena */
+JPEGData *jpeg_data_new_mem       (ExifMem *mem);
 JPEGData *jpeg_data_new_from_file (const char *path);
 JPEGData *jpeg_data_new_from_data (const unsigned char *data,
 				   unsigned int size);
@@ -78,15 +83,52 @@ void      jpeg_data_free  (JPEGData *data);
 
 void      jpeg_data_load_data     (JPEGData *data, const unsigned char *d,
 				   unsigned int size);
+/* Like jpeg_data_load_data, but the section and scan data are not copied
+   and d must stay valid and unchanged as long as data is alive */
+void      jpeg_data_load_data_borrow (JPEGData *data,
+				   const unsigned char *d, unsigned int size);
 void      jpeg_data_save_data     (JPEGData *data, unsigned char **d,
 				   unsigned int *size);
+/* Serialize data into a caller buffer without any allocation. The EXIF
+   data is written straight into place. jpeg_data_save_data_size returns
+   the exact size needed, jpeg_data_save_data_buf the size written or 0,
+   without writing anything, if d is smaller than that. */
+unsigned int jpeg_data_save_data_size (JPEGData *data);
+unsigned int jpeg_data_save_data_buf  (JPEGData *data, unsigned char *d,
+				       unsigned int size);
+/* Describe the serialized data as iovecs for writev without joining it.
+   The markers, segment lengths and EXIF data are written to d, the other
+   section data and the scan data are referenced where they are, so the
+   iovecs are only valid as long as data and d are unchanged.
+   jpeg_data_save_iov_size returns the size needed in d and the number of
+   iovecs in count, jpeg_data_save_iov the number of iovecs filled or 0,
+   without writing anything, if d or iov are too small. */
+unsigned int jpeg_data_save_iov_size  (JPEGData *data, unsigned int *count);
+unsigned int jpeg_data_save_iov       (JPEGData *data, unsigned char *d,
+				       unsigned int size, struct iovec *iov,
+				       unsigned int count);
 /* Following function added to implement the zero copy save routine.
    2011.06.30 - Samsung Electronics */
+/* Deprecated, d must hold jpeg_data_save_data_size bytes. Use
+   jpeg_data_save_data_buf, which checks the size of d. */
 void      jpeg_data_save_data_no_copy     (JPEGData *data, unsigned char *d,
 				   unsigned int *size);
 
 void      jpeg_data_load_file     (JPEGData *data, const char *path);
+/* Like jpeg_data_load_file, but the file is mapped and the scan data is
+   not copied. The file must not be truncated or rewritten in place by
+   anyone else while data is alive. Falls back to jpeg_data_load_file if
+   the file cannot be mapped. */
+void      jpeg_data_load_file_mapped (JPEGData *data, const char *path);
 int       jpeg_data_save_file     (JPEGData *data, const char *path);
+/* Write the sections before the scan data back to the file data was
+   loaded from. Headers that fit are overwritten in place, the APP1
+   segment padding them to the old size, otherwise the new headers and
+   the old scan data are written to a new file replacing path. If that
+   file cannot get the owner and SELinux label of path, path is rewritten
+   in place instead, which is not atomic. Files that were not mapped by
+   jpeg_data_load_file_mapped are saved completely. */
+int       jpeg_data_update_file   (JPEGData *data, const char *path);
 
 void      jpeg_data_set_exif_data (JPEGData *data, ExifData *exif_data);
 ExifData *jpeg_data_get_exif_data (JPEGData *data);